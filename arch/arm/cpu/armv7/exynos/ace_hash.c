@@ -0,0 +1,70 @@
+/*
+ * Advanced Crypto Engine - hash registry driver
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include <common.h>
+#include <hash.h>
+#include <asm/arch/ace_sfr.h>
+#include <asm/arch/ace_sha1.h>
+
+/*
+ * HRDMA fetches whole words; leave unaligned buffers to the software
+ * code rather than hashing bytes that are not part of the message.
+ */
+static int ace_hash_ws(unsigned int engsel, const unsigned char *input,
+			unsigned int ilen, unsigned char *output)
+{
+	if ((unsigned long)input & 3)
+		return -1;
+
+	return ace_hash_digest(engsel, output, (unsigned char *)input, ilen);
+}
+
+static int ace_sha1_ws(const unsigned char *input, unsigned int ilen,
+			unsigned char *output, unsigned int chunk_sz)
+{
+	return ace_hash_ws(ACE_HASH_ENGSEL_SHA1HASH, input, ilen, output);
+}
+
+static int ace_md5_ws(const unsigned char *input, unsigned int ilen,
+			unsigned char *output, unsigned int chunk_sz)
+{
+	return ace_hash_ws(ACE_HASH_ENGSEL_MD5HASH, input, ilen, output);
+}
+
+static int ace_sha256_ws(const unsigned char *input, unsigned int ilen,
+			unsigned char *output, unsigned int chunk_sz)
+{
+	return ace_hash_ws(ACE_HASH_ENGSEL_SHA256HASH, input, ilen, output);
+}
+
+/* The engine works on the whole buffer, so there is no chunk size */
+static struct hash_algo ace_hash_algos[] = {
+	{ "md5", 16, 0, ace_md5_ws, },
+	{ "sha1", 20, 0, ace_sha1_ws, },
+	{ "sha256", 32, 0, ace_sha256_ws, },
+};
+
+int ace_hash_init(void)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(ace_hash_algos); i++)
+		hash_register(&ace_hash_algos[i]);
+	return 0;
+}
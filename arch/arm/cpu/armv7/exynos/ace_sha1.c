@@ -20,6 +20,7 @@
  */
 
 #include <common.h>
+#include <watchdog.h>
 #include <asm/arch/ace_sfr.h>
 
 
@@ -41,42 +42,75 @@ const unsigned char sha1_digest_emptymsg[20] = {
 	0xAF, 0xD8, 0x07, 0x09};
 
 
+/* MD5 and SHA256 values for the message of zero length */
+static const unsigned char md5_digest_emptymsg[16] = {
+	0xD4, 0x1D, 0x8C, 0xD9, 0x8F, 0x00, 0xB2, 0x04,
+	0xE9, 0x80, 0x09, 0x98, 0xEC, 0xF8, 0x42, 0x7E};
+
+static const unsigned char sha256_digest_emptymsg[32] = {
+	0xE3, 0xB0, 0xC4, 0x42, 0x98, 0xFC, 0x1C, 0x14,
+	0x9A, 0xFB, 0xF4, 0xC8, 0x99, 0x6F, 0xB9, 0x24,
+	0x27, 0xAE, 0x41, 0xE4, 0x64, 0x9B, 0x93, 0x4C,
+	0xA4, 0x95, 0x99, 0x1B, 0x78, 0x52, 0xB8, 0x55};
+
+
 /*****************************************************************
 	Functions
 *****************************************************************/
 /**
- * @brief	This function computes hash value of input (pBuf[0]..pBuf[buflen-1]).
+ * @brief	This function computes hash value of input (pBuf[0]..pBuf[buflen-1])
+ *		with the engine selected by engSel.
  *
- * @param	pOut	A pointer to the output buffer. When operation is completed
- * 			20 bytes are copied to pOut[0]...pOut[19]. Thus, a user
- * 			should allocate at least 20 bytes at pOut in advance.
+ * @param	engSel	ACE_HASH_ENGSEL_SHA1HASH, ACE_HASH_ENGSEL_MD5HASH or
+ *			ACE_HASH_ENGSEL_SHA256HASH
+ * @param	pOut	A pointer to the output buffer. It does not need to be
+ *			word aligned. 20, 16 or 32 bytes are copied to it.
  * @param	pBuf	A pointer to the input buffer
  * @param	bufLen	Byte length of input buffer
  *
  * @return	0	Success
- *
- * @remark	This function assumes that pBuf is a physical address of input buffer.
- *
- * @version V1.00
- * @b Revision History
- *	- V01.00	2009.11.13/djpark	Initial Version
- *	- V01.10	2010.10.19/djpark	Modification to support C210/V310
+ *		-1	Unknown engine
  */
-int ace_hash_sha1_digest (
+int ace_hash_digest (
+	unsigned int	engSel,
 	unsigned char*	pOut,
 	unsigned char*	pBuf,
 	unsigned int	bufLen
 )
 {
 	unsigned int reg;
-	unsigned int* pDigest;
+	unsigned int digest[8];
+	const unsigned char *emptymsg;
+	int len;
+
+	switch (engSel) {
+	case ACE_HASH_ENGSEL_SHA1HASH:
+		emptymsg = sha1_digest_emptymsg;
+		len = 20;
+		break;
+	case ACE_HASH_ENGSEL_MD5HASH:
+		emptymsg = md5_digest_emptymsg;
+		len = 16;
+		break;
+	case ACE_HASH_ENGSEL_SHA256HASH:
+		emptymsg = sha256_digest_emptymsg;
+		len = 32;
+		break;
+	default:
+		return -1;
+	}
 
 	if (bufLen == 0) {
 		/* ACE H/W cannot compute hash value for empty string */
-		memcpy(pOut, sha1_digest_emptymsg, 20);
+		memcpy(pOut, emptymsg, len);
 		return 0;
 	}
 
+#ifndef CONFIG_SYS_NO_DCACHE
+	/* HRDMA reads memory directly */
+	flush_dcache_range((unsigned long)pBuf, (unsigned long)pBuf + bufLen);
+#endif
+
 	/* Flush HRDMA */
 	ACE_write_sfr(ACE_FC_HRDMAC, ACE_FC_HRDMACFLUSH_ON);
 	ACE_write_sfr(ACE_FC_HRDMAC, ACE_FC_HRDMACFLUSH_OFF);
@@ -90,8 +124,8 @@ int ace_hash_sha1_digest (
 	reg = (reg & ~ACE_FC_SELHASH_MASK) | ACE_FC_SELHASH_EXOUT;
 	ACE_write_sfr(ACE_FC_FIFOCTRL, reg);
 
-	/* Set Hash as SHA1 and start Hash engine */
-	reg = ACE_HASH_ENGSEL_SHA1HASH | ACE_HASH_STARTBIT_ON;
+	/* Select Hash engine and start it */
+	reg = engSel | ACE_HASH_STARTBIT_ON;
 	ACE_write_sfr(ACE_HASH_CONTROL, reg);
 
 	/* Enable FIFO mode */
@@ -102,22 +136,31 @@ int ace_hash_sha1_digest (
 	ACE_write_sfr(ACE_HASH_MSGSIZE_HIGH, 0);
 
 	/* Set HRDMA */
-        ACE_write_sfr(ACE_FC_HRDMAS, (unsigned int)virt_to_phys(pBuf));
+	ACE_write_sfr(ACE_FC_HRDMAS, (unsigned int)virt_to_phys(pBuf));
 	ACE_write_sfr(ACE_FC_HRDMAL, bufLen);
 
 	while ((ACE_read_sfr(ACE_HASH_STATUS) & ACE_HASH_MSGDONE_MASK)
-			== ACE_HASH_MSGDONE_OFF);
+			== ACE_HASH_MSGDONE_OFF)
+		WATCHDOG_RESET();
 
 	/* Clear MSG_DONE bit */
 	ACE_write_sfr(ACE_HASH_STATUS, ACE_HASH_MSGDONE_ON);
 
 	/* Read hash result */
-	pDigest = (unsigned int*)pOut;
-	pDigest[0] = ACE_read_sfr(ACE_HASH_RESULT1);
-	pDigest[1] = ACE_read_sfr(ACE_HASH_RESULT2);
-	pDigest[2] = ACE_read_sfr(ACE_HASH_RESULT3);
-	pDigest[3] = ACE_read_sfr(ACE_HASH_RESULT4);
-	pDigest[4] = ACE_read_sfr(ACE_HASH_RESULT5);
+	digest[0] = ACE_read_sfr(ACE_HASH_RESULT1);
+	digest[1] = ACE_read_sfr(ACE_HASH_RESULT2);
+	digest[2] = ACE_read_sfr(ACE_HASH_RESULT3);
+	digest[3] = ACE_read_sfr(ACE_HASH_RESULT4);
+	digest[4] = ACE_read_sfr(ACE_HASH_RESULT5);
+#if defined(CONFIG_ARCH_S5PV310) || defined(CONFIG_ARCH_EXYNOS)
+	digest[5] = ACE_read_sfr(ACE_HASH_RESULT6);
+	digest[6] = ACE_read_sfr(ACE_HASH_RESULT7);
+	digest[7] = ACE_read_sfr(ACE_HASH_RESULT8);
+#else
+	if (len > 20)
+		return -1;
+#endif
+	memcpy(pOut, digest, len);
 
 	/* Clear HRDMA pending bit */
 	ACE_write_sfr(ACE_FC_INTPEND, ACE_FC_HRDMA);
@@ -125,5 +168,33 @@ int ace_hash_sha1_digest (
 	return 0;
 }
 
+/**
+ * @brief	This function computes SHA1 hash value of input
+ *		(pBuf[0]..pBuf[buflen-1]).
+ *
+ * @param	pOut	A pointer to the output buffer. When operation is completed
+ * 			20 bytes are copied to pOut[0]...pOut[19]. Thus, a user
+ * 			should allocate at least 20 bytes at pOut in advance.
+ * @param	pBuf	A pointer to the input buffer
+ * @param	bufLen	Byte length of input buffer
+ *
+ * @return	0	Success
+ *
+ * @remark	This function assumes that pBuf is a physical address of input buffer.
+ *
+ * @version V1.00
+ * @b Revision History
+ *	- V01.00	2009.11.13/djpark	Initial Version
+ *	- V01.10	2010.10.19/djpark	Modification to support C210/V310
+ */
+int ace_hash_sha1_digest (
+	unsigned char*	pOut,
+	unsigned char*	pBuf,
+	unsigned int	bufLen
+)
+{
+	return ace_hash_digest(ACE_HASH_ENGSEL_SHA1HASH, pOut, pBuf, bufLen);
+}
+
 #endif
 
@@ -53,12 +53,16 @@ typedef u32(*MSH_EndBootOp_eMMC)
 #ifdef CONFIG_CORTEXA5_ENABLE
 void * uboot_memcpy(void * dest,const void *src,size_t count)
 {
+#ifdef CONFIG_USE_ARCH_MEMCPY
+	return memcpy(dest, src, count);
+#else
 	char *tmp = (char *) dest, *s = (char *) src;
 
 	while (count--)
 		*tmp++ = *s++;
 
 	return dest;
+#endif
 }
 #endif
 
@@ -0,0 +1,102 @@
+/*
+ * (C) Copyright 2011 Samsung Electronics Co. Ltd
+ *
+ * See file CREDITS for list of people who contributed to this
+ * project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ */
+
+#include <common.h>
+#include <smp.h>
+#include <asm/io.h>
+#include <asm/arch/cpu.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+#define ARM_CORE_CONFIGURATION(n)	(S5PV310_POWER_BASE + 0x2000 + (n) * 0x80)
+#define ARM_CORE_STATUS(n)		(ARM_CORE_CONFIGURATION(n) + 0x4)
+#define CORE_LOCAL_PWR_EN		0x3
+
+/*
+ * Boot address words of the wait loop that lowlevel_init copies to the
+ * non-secure iRAM (REG5 onwards). Secondary cores sit in WFE there and
+ * jump to their word once it is non-zero; Linux uses the same words.
+ */
+#if defined(CONFIG_EXYNOS4412)
+#define CPU_BOOT_REG(n)		(CONFIG_PHY_IRAM_NS_BASE + 0x1c + (n) * 4)
+#else
+#define CPU_BOOT_REG(n)		(CONFIG_PHY_IRAM_NS_BASE + 0x1c)
+#endif
+
+#define CORE_POWER_TIMEOUT	10	/* ms */
+
+/* read by smp_secondary_entry */
+ulong smp_secondary_sp[CONFIG_SMP_NR_CPUS];
+ulong smp_secondary_gd;
+
+extern void smp_secondary_entry(void);
+
+/*
+ * With the TrustZone software loaded the secure side has to release
+ * the core into the non-secure wait loop; the board does that.
+ */
+void __exynos_cpu_boot(int cpu)
+{
+}
+void exynos_cpu_boot(int cpu)
+	__attribute__((weak, alias("__exynos_cpu_boot")));
+
+void smp_arch_barrier(void)
+{
+	__asm__ __volatile__ ("dmb" : : : "memory");
+}
+
+void smp_arch_wait_event(void)
+{
+	__asm__ __volatile__ (".word 0xe320f002" : : : "memory");	/* wfe */
+}
+
+void smp_arch_send_event(void)
+{
+	__asm__ __volatile__ ("dsb\n"
+			      ".word 0xe320f004" : : : "memory");	/* sev */
+}
+
+int smp_arch_start(int cpu, ulong sp)
+{
+	ulong start;
+
+	smp_secondary_sp[cpu] = sp;
+	smp_secondary_gd = (ulong)gd;
+
+	if ((readl(ARM_CORE_STATUS(cpu)) & CORE_LOCAL_PWR_EN)
+			!= CORE_LOCAL_PWR_EN) {
+		writel(CORE_LOCAL_PWR_EN, ARM_CORE_CONFIGURATION(cpu));
+
+		start = get_timer(0);
+		while ((readl(ARM_CORE_STATUS(cpu)) & CORE_LOCAL_PWR_EN)
+				!= CORE_LOCAL_PWR_EN) {
+			if (get_timer(start) > CORE_POWER_TIMEOUT)
+				return -1;
+		}
+	}
+
+	writel((ulong)smp_secondary_entry, CPU_BOOT_REG(cpu));
+	exynos_cpu_boot(cpu);
+	smp_arch_send_event();
+
+	return 0;
+}
+
+/* Back into the iRAM wait loop, with the boot address cleared */
+void smp_arch_park(int cpu)
+{
+	writel(0, CPU_BOOT_REG(cpu));
+	smp_arch_barrier();
+
+	((void (*)(void))CONFIG_PHY_IRAM_NS_BASE)();
+}
@@ -37,6 +37,15 @@ int ace_hash_sha1_digest (
 	unsigned char*		pBufAddr,
 	unsigned int		bufLen
 );
+
+int ace_hash_digest (
+	unsigned int		engSel,
+	unsigned char*		pOut,
+	unsigned char*		pBufAddr,
+	unsigned int		bufLen
+);
+
+int ace_hash_init (void);
 #endif
 
 #ifdef __cplusplus
@@ -276,6 +276,7 @@ struct sdhci_host {
 
 	/* Internal data */
 	struct mmc		*mmc;		/* MMC structure */
+	u32			dma_addr;	/* SDMA address of the running transfer */
 	u64			dma_mask;	/* custom DMA mask */
 
 	int			flags;		/* Host attributes */
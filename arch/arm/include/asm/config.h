@@ -23,4 +23,8 @@
 
 #define CONFIG_LMB
 #define CONFIG_SYS_BOOT_RAMDISK_HIGH
+
+#ifdef __ARM_ARCH_7A__
+#define CONFIG_ZLIB_FAST_INFLATE
+#endif
 #endif
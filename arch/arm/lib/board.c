@@ -49,6 +49,7 @@
 #include <nand.h>
 #include <onenand_uboot.h>
 #include <mmc.h>
+#include <hash.h>
 
 #ifdef CONFIG_BITBANGMII
 #include <miiphy.h>
@@ -484,6 +485,10 @@ void board_init_r (gd_t *id, ulong dest_addr)
 	malloc_start = dest_addr - TOTAL_MALLOC_LEN;
 	mem_malloc_init (malloc_start, TOTAL_MALLOC_LEN);
 
+#ifdef CONFIG_HASH
+	hash_init ();	/* register hardware hash engines */
+#endif
+
 #if !defined(CONFIG_SYS_NO_FLASH)
 	puts ("FLASH: ");
 
@@ -29,6 +29,9 @@
 #include <fdt.h>
 #include <libfdt.h>
 #include <fdt_support.h>
+#ifdef CONFIG_SMP
+#include <smp.h>
+#endif
 
 DECLARE_GLOBAL_DATA_PTR;
 
@@ -89,6 +92,12 @@ static void announce_and_cleanup(void)
 		extern void udc_disconnect(void);
 		udc_disconnect();
 	}
+#endif
+#ifdef CONFIG_SMP
+#ifdef CONFIG_FIT
+	fit_image_hash_discard();
+#endif
+	smp_shutdown();
 #endif
 	cleanup_before_linux();
 }
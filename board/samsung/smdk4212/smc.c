@@ -73,6 +73,7 @@ typedef struct ld_image_info {
 #define SMC_CMD_WARMBOOT			(-232)
 #define SMC_CMD_CHECK_SECOND_BOOT		(-233)
 #define SMC_CMD_EMMC_ENDBOOTOP                  (-234)
+#define SMC_CMD_CPU1BOOT			(-4)
 
 #ifdef CONFIG_SECURE_BOOT
 #define SMC_SIGNATURE_SIZE		256
@@ -191,3 +192,14 @@ void emmc_endbootop(void)
 {
 	exynos_smc(SMC_CMD_EMMC_ENDBOOTOP, 0, 0, 0);
 }
+
+#ifdef CONFIG_SMP
+/* release a secondary core into the non-secure wait loop */
+void exynos_cpu_boot(int cpu)
+{
+#ifndef CONFIG_EXYNOS4412
+	cpu = 0;	/* only one secondary, the id is not used */
+#endif
+	exynos_smc(SMC_CMD_CPU1BOOT, cpu, 0, 0);
+}
+#endif
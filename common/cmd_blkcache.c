@@ -0,0 +1,65 @@
+/*
+ * Block device read cache statistics and tuning
+ *
+ * See file CREDITS for list of people who contributed to this
+ * project.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ */
+
+#include <common.h>
+#include <command.h>
+#include <part.h>
+#include <blkcache.h>
+
+int do_blkcache(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
+{
+	struct block_cache_stats stats;
+	unsigned blocks, entries;
+
+	if (argc == 2 && !strcmp(argv[1], "show")) {
+		blkcache_stats(&stats);
+		printf("    hits: %u\n"
+		       "    misses: %u\n"
+		       "    entries: %u\n"
+		       "    max blocks/entry: %u\n"
+		       "    max cache entries: %u\n",
+		       stats.hits, stats.misses, stats.entries,
+		       stats.max_blocks_per_entry, stats.max_entries);
+		return 0;
+	}
+
+	if (argc == 4 && !strncmp(argv[1], "conf", 4)) {
+		blocks = simple_strtoul(argv[2], NULL, 0);
+		entries = simple_strtoul(argv[3], NULL, 0);
+		blkcache_configure(blocks, entries);
+		printf("changed to max of %u entries of %u blocks each\n",
+		       entries, blocks);
+		return 0;
+	}
+
+	return cmd_usage(cmdtp);
+}
+
+U_BOOT_CMD(
+	blkcache,	4,	0,	do_blkcache,
+	"block device read cache control/statistics",
+	"show\n"
+	"    - show and reset block cache statistics\n"
+	"blkcache configure blocks entries\n"
+	"    - set the maximum blocks per entry and the number of entries,\n"
+	"      0 entries disables the cache"
+);
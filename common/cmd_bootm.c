@@ -61,11 +61,11 @@
 #include <linux/lzo.h>
 #endif /* CONFIG_LZO */
 
-DECLARE_GLOBAL_DATA_PTR;
+#ifdef CONFIG_LZ4
+#include <lz4.h>
+#endif /* CONFIG_LZ4 */
 
-#ifndef CONFIG_SYS_BOOTM_LEN
-#define CONFIG_SYS_BOOTM_LEN	0x800000	/* use 8MByte as default max gunzip size */
-#endif
+DECLARE_GLOBAL_DATA_PTR;
 
 #ifdef CONFIG_BZIP2
 extern void bz_internal_error(int);
@@ -219,6 +219,10 @@ static int bootm_start(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[]
 	void		*os_hdr;
 	int		ret;
 
+#if defined(CONFIG_FIT) && defined(CONFIG_SMP)
+	/* results left over from an earlier, failed bootm */
+	fit_image_hash_discard ();
+#endif
 	memset ((void *)&images, 0, sizeof (images));
 	images.verify = getenv_yesno ("verify");
 
@@ -339,9 +343,9 @@ static int bootm_load_os(image_info_t os, ulong *load_end, int boot_progress)
 	ulong image_start = os.image_start;
 	ulong image_len = os.image_len;
 	uint unc_len = CONFIG_SYS_BOOTM_LEN;
-#if defined(CONFIG_LZMA) || defined(CONFIG_LZO)
+#if defined(CONFIG_LZMA) || defined(CONFIG_LZO) || defined(CONFIG_LZ4)
 	int ret;
-#endif /* defined(CONFIG_LZMA) || defined(CONFIG_LZO) */
+#endif /* defined(CONFIG_LZMA) || defined(CONFIG_LZO) || defined(CONFIG_LZ4) */
 
 	const char *type_name = genimg_get_type_name (os.type);
 
@@ -431,6 +435,26 @@ static int bootm_load_os(image_info_t os, ulong *load_end, int boot_progress)
 		*load_end = load + unc_len;
 		break;
 #endif /* CONFIG_LZO */
+#ifdef CONFIG_LZ4
+	case IH_COMP_LZ4: {
+		size_t lz4_len = unc_len;
+		printf ("   Uncompressing %s ... ", type_name);
+
+		ret = lz4_decompress((const unsigned char *)image_start,
+				     image_len, (unsigned char *)load,
+				     &lz4_len);
+		if (ret != LZ4_E_OK) {
+			printf ("LZ4: uncompress or overwrite error %d "
+			      "- must RESET board to recover\n", ret);
+			if (boot_progress)
+				show_boot_progress (-6);
+			return BOOTM_ERR_RESET;
+		}
+
+		*load_end = load + lz4_len;
+		break;
+	}
+#endif /* CONFIG_LZ4 */
 	default:
 		printf ("Unimplemented compression type %d\n", comp);
 		return BOOTM_ERR_UNIMPLEMENTED;
@@ -1012,6 +1036,11 @@ static void *boot_get_kernel (cmd_tbl_t *cmdtp, int flag, int argc, char * const
 
 			os_noffset = fit_conf_get_kernel_node (fit_hdr, cfg_noffset);
 			fit_uname_kernel = fit_get_name (fit_hdr, os_noffset, NULL);
+#if defined(CONFIG_SMP)
+			/* hash kernel, ramdisk and fdt side by side */
+			if (images->verify)
+				fit_conf_hash_start (fit_hdr, cfg_noffset);
+#endif
 		} else {
 			/* get kernel component image node offset */
 			show_boot_progress (102);
@@ -16,10 +16,13 @@
 #include <fat.h>
 #include <menu.h>
 #include <hush.h>
+#include <u-boot/crc.h>
+#include <linux/ctype.h>
 
 #define BOOTSCAN_MAX_DEVICES		10
 #define BOOTSCAN_MAX_PARTITIONS		10
 #define BOOTSCAN_MAX_BOOTABLES		10
+#define BOOTSCAN_MAX_DIRENTS		16
 
 #define BOOTSCAN_EXIT			1
 #define BOOTSCAN_SHOW			2
@@ -60,6 +63,8 @@
 #define UBOOT_BOOTCMD		"bootcmd"
 #define BOOTSCAN_CHOICE		"bootscan_choice"
 #define BOOTSCAN_ROOT		"bootscan_root"
+#define BOOTSCAN_INVENTORY	"bootscan_inventory"
+#define BOOTSCAN_SAVEINVENTORY	"bootscan_saveinventory"
 
 #define BOOTSCAN_BANNER1 \
 	"\n"								\
@@ -855,6 +860,347 @@ static int check_for_file(struct bootscan_bootables bootlist[],
 	return 0;
 }
 
+/*
+ * The entries of a directory that bootscan looks for, so that all
+ * candidate names can be matched without going back to the disk, and a
+ * fingerprint of the names, sizes and times of all of its entries.
+ */
+struct bootscan_dirent {
+	char name[16];
+	int type;
+	unsigned long size;
+};
+
+struct bootscan_dir {
+	char fstype;
+	int count;
+	struct bootscan_dirent ent[BOOTSCAN_MAX_DIRENTS];
+	u32 stamp;
+};
+
+/* FAT names are matched regardless of case, extX names exactly */
+static int bootscan_namematch(char fstype, const char *name,
+			      const char *match, int len)
+{
+	int i;
+
+	if (strlen(name) != len)
+		return 0;
+	if (fstype != 'f')
+		return strncmp(name, match, len) == 0;
+	for (i = 0; i < len; i++) {
+		if (tolower(name[i]) != tolower(match[i]))
+			return 0;
+	}
+	return 1;
+}
+
+/*
+ * Point *name at the first directory of path, as in "/name/...", and
+ * return its length. Returns 0 if path has no directory.
+ */
+static int bootscan_topdir(char *path, char **name)
+{
+	char *end;
+
+	if (*path == '/')
+		path++;
+	end = strchr(path, '/');
+	*name = path;
+	return end ? end - path : 0;
+}
+
+/* Returns 1 if name is a file or directory bootscan looks for */
+static int bootscan_wanted(char fstype, const char *name)
+{
+	char *files[] = { BOOTSCAN_BOOTIMAGES, BOOTSCAN_BOOTINITRDS,
+			  BOOTSCAN_BOOTINIS, BOOTSCAN_ANDROID_SYS_IMAGES };
+	char *paths[] = { BOOTSCAN_BOOTBASEDIRS, BOOTSCAN_ROOTFS };
+	char *dir;
+	int i, len;
+
+	for (i = 0; i < ARRAY_SIZE(files); i++) {
+		if (files[i][0] != '\0' &&
+		    bootscan_namematch(fstype, name, files[i],
+				       strlen(files[i])))
+			return 1;
+	}
+	for (i = 0; i < ARRAY_SIZE(paths); i++) {
+		len = bootscan_topdir(paths[i], &dir);
+		if (len && bootscan_namematch(fstype, name, dir, len))
+			return 1;
+	}
+	return 0;
+}
+
+static void bootscan_dir_add(void *priv, const struct fs_dirent *dent)
+{
+	struct bootscan_dir *dir = priv;
+	struct bootscan_dirent *ent;
+	unsigned long attr[3] = { dent->type, dent->size, dent->mtime };
+
+	dir->stamp = crc32(dir->stamp, (const uchar *)dent->name,
+			   strlen(dent->name) + 1);
+	dir->stamp = crc32(dir->stamp, (const uchar *)attr, sizeof(attr));
+
+	if (dir->count == BOOTSCAN_MAX_DIRENTS ||
+	    strlen(dent->name) >= sizeof(ent->name) ||
+	    !bootscan_wanted(dir->fstype, dent->name))
+		return;
+
+	ent = &dir->ent[dir->count++];
+	strcpy(ent->name, dent->name);
+	ent->type = dent->type;
+	ent->size = dent->size;
+}
+
+/*
+ * Lists the directory dirname of the partition being scanned into dir
+ * Returns 0 on success, -1 otherwise
+ */
+static int bootscan_readdir(struct bootscan_bootables bootlist[],
+			    int *bootindex, char *dirname,
+			    struct bootscan_dir *dir)
+{
+	dir->fstype = bootlist[*bootindex].fstype;
+	dir->count = 0;
+	dir->stamp = 0;
+
+	switch (dir->fstype) {
+	case 'e':
+		return ext4fs_readdir(dirname, bootscan_dir_add, dir);
+	case 'f':
+		return fat_readdir(dirname, bootscan_dir_add, dir) ? -1 : 0;
+	}
+	return -1;
+}
+
+static struct bootscan_dirent *bootscan_find(struct bootscan_dir *dir,
+					    char *name, int len)
+{
+	int i;
+
+	for (i = 0; i < dir->count; i++) {
+		if (bootscan_namematch(dir->fstype, dir->ent[i].name,
+				       name, len))
+			return &dir->ent[i];
+	}
+	return NULL;
+}
+
+/*
+ * Checks for a file called name in the listing dir. Empty files do not
+ * count. Symbolic links are followed by looking up fname, the full path
+ * of the file.
+ * Returns 1 if file is present, 0 otherwise
+ */
+static int bootscan_has_file(struct bootscan_bootables bootlist[],
+			     int *bootindex, struct bootscan_dir *dir,
+			     char *name, char *fname)
+{
+	struct bootscan_dirent *ent;
+
+	ent = bootscan_find(dir, name, strlen(name));
+	if (ent == NULL || ent->type == FS_DT_DIR)
+		return 0;
+	if (ent->type == FS_DT_REG)
+		return ent->size > 0;
+	return check_for_file(bootlist, bootindex, fname);
+}
+
+/*
+ * Returns the listing of the base directory dirname, which is either
+ * "/" or "/dir/": root itself, or sub filled in if root has dir.
+ * Returns NULL if there is no such directory.
+ */
+static struct bootscan_dir *bootscan_basedir(struct bootscan_bootables
+					     bootlist[], int *bootindex,
+					     struct bootscan_dir *root,
+					     char *dirname,
+					     struct bootscan_dir *sub)
+{
+	char *top;
+	int len;
+
+	len = bootscan_topdir(dirname, &top);
+	if (len == 0)
+		return root;
+	if (bootscan_find(root, top, len) == NULL ||
+	    bootscan_readdir(bootlist, bootindex, dirname, sub))
+		return NULL;
+	return sub;
+}
+
+/*
+ * Lists each of BOOTSCAN_BOOTBASEDIRS once: base[i] is the listing of the
+ * i-th one, in root or sub[i], or NULL if there is no such directory.
+ */
+static void bootscan_basedirs(struct bootscan_bootables bootlist[],
+			      int *bootindex, struct bootscan_dir *root,
+			      struct bootscan_dir sub[],
+			      struct bootscan_dir *base[])
+{
+	char *basedirs[] = { BOOTSCAN_BOOTBASEDIRS };
+	int i;
+
+	for (i = 0; basedirs[i][0] != '\0'; i++)
+		base[i] = bootscan_basedir(bootlist, bootindex, root,
+					   basedirs[i], &sub[i]);
+}
+
+#ifdef CONFIG_BOOTSCAN_INVENTORY
+/*
+ * The inventory records what was found on each partition, so that the
+ * next scan can take it from there instead of probing the partition
+ * again, as long as its fingerprint has not changed. The fingerprint
+ * covers the listings of the root directory and of the base directories
+ * in it, so that a kernel or initrd replaced in /boot is noticed even if
+ * the time of /boot itself stays the same, as it does on FAT.
+ *
+ * It is kept in the environment as one word per bootlist entry:
+ * interface:device:partition:fstype:uuid:stamp:rootfs:image:initrd:ini
+ */
+#define BOOTSCAN_INVENTORY_ENTRY	320
+
+/* Inventory of the scan in progress */
+static char *bootscan_inventory;
+
+static void bootscan_inventory_key(struct bootscan_bootables *b, u32 stamp,
+				   char *key)
+{
+	sprintf(key, "%s:%d:%d:%c:%s:%08x:", b->interface, b->device,
+		b->partition, b->fstype, b->uuid, stamp);
+}
+
+/* Adds bootlist entries first to last - 1 to the inventory */
+static void bootscan_inventory_add(struct bootscan_bootables bootlist[],
+				   int first, int last, u32 stamp)
+{
+	char *p;
+	int i;
+
+	if (bootscan_inventory == NULL)
+		return;
+
+	p = bootscan_inventory + strlen(bootscan_inventory);
+	for (i = first; i < last; i++) {
+		if (p != bootscan_inventory)
+			*p++ = ' ';
+		bootscan_inventory_key(&bootlist[i], stamp, p);
+		p += strlen(p);
+		p += sprintf(p, "%d:%s:%s:%s", bootlist[i].rootfs,
+			     bootlist[i].bootimage, bootlist[i].bootinitrd,
+			     bootlist[i].bootini);
+	}
+}
+
+/* Fills in b from the rootfs:image:initrd:ini part of an entry */
+static int bootscan_inventory_parse(struct bootscan_bootables *b,
+				    char *entry)
+{
+	char *field[4];
+	int i;
+
+	for (i = 0; i < 4; i++) {
+		field[i] = strsep(&entry, ":");
+		if (field[i] == NULL)
+			return -1;
+	}
+	if ((strlen(field[1]) >= sizeof(b->bootimage)) ||
+	    (strlen(field[2]) >= sizeof(b->bootinitrd)) ||
+	    (strlen(field[3]) >= sizeof(b->bootini)))
+		return -1;
+
+	b->rootfs = simple_strtoul(field[0], NULL, 10);
+	strcpy(b->bootimage, field[1]);
+	strcpy(b->bootinitrd, field[2]);
+	strcpy(b->bootini, field[3]);
+	return 0;
+}
+
+/*
+ * Fills in the bootlist entries recorded for the partition being
+ * scanned if it still has the fingerprint stamp.
+ * Returns 1 if any were found, 0 if the partition has to be probed.
+ */
+static int bootscan_inventory_find(struct bootscan_bootables bootlist[],
+				   int *bootindex, u32 stamp)
+{
+	char key[BOOTSCAN_INVENTORY_ENTRY];
+	char *s, *p, *entry;
+	int len, found = 0;
+
+	s = getenv(BOOTSCAN_INVENTORY);
+	if (s == NULL)
+		return 0;
+	s = strdup(s);
+	if (s == NULL)
+		return 0;
+
+	bootscan_inventory_key(&bootlist[*bootindex], stamp, key);
+	len = strlen(key);
+	p = s;
+	while (((entry = strsep(&p, " ")) != NULL) &&
+	       (*bootindex < BOOTSCAN_MAX_BOOTABLES)) {
+		if (strncmp(entry, key, len) ||
+		    bootscan_inventory_parse(&bootlist[*bootindex],
+					     entry + len))
+			continue;
+		debug("%s: %s\n", __func__, entry);
+		found = 1;
+		(*bootindex)++;
+		if (*bootindex < BOOTSCAN_MAX_BOOTABLES)
+			/* Prep next bootlist structure */
+			memcpy(&bootlist[*bootindex], &bootlist[*bootindex - 1],
+			       sizeof(struct bootscan_bootables));
+	}
+	free(s);
+
+	return found;
+}
+
+/*
+ * Fingerprint of the partition being scanned: that of the root listing
+ * combined with those of the base directories found in it
+ */
+static u32 bootscan_inventory_stamp(struct bootscan_dir *root,
+				    struct bootscan_dir *base[])
+{
+	char *basedirs[] = { BOOTSCAN_BOOTBASEDIRS };
+	u32 stamp = root->stamp;
+	int i;
+
+	for (i = 0; basedirs[i][0] != '\0'; i++) {
+		if (base[i] && base[i] != root)
+			stamp = crc32(stamp, (const uchar *)&base[i]->stamp,
+				      sizeof(base[i]->stamp));
+	}
+	return stamp;
+}
+
+/*
+ * Keeps the inventory of this scan for the next one, if it changed. It
+ * only goes to storage if bootscan_saveinventory is set, otherwise it
+ * is saved along with the next saveenv.
+ */
+static void bootscan_inventory_save(void)
+{
+	char *s;
+
+	if (bootscan_inventory == NULL)
+		return;
+
+	s = getenv(BOOTSCAN_INVENTORY);
+	if (s ? strcmp(s, bootscan_inventory) : bootscan_inventory[0]) {
+		setenv(BOOTSCAN_INVENTORY, bootscan_inventory);
+		if (getenv_yesno(BOOTSCAN_SAVEINVENTORY) == 1)
+			saveenv();
+	}
+	free(bootscan_inventory);
+	bootscan_inventory = NULL;
+}
+#endif /* CONFIG_BOOTSCAN_INVENTORY */
+
 /*
  * For Android, the checks we do are as follows:
  * 1. There is a file called boot.scr
@@ -882,7 +1228,7 @@ static int check_for_file(struct bootscan_bootables bootlist[],
  *
  */
 static int populate_android(struct bootscan_bootables bootlist[],
-			    int *bootindex)
+			    int *bootindex, struct bootscan_dir *root)
 {
 	char *images[] = { BOOTSCAN_BOOTIMAGES };
 	char *aimages[] = { BOOTSCAN_ANDROID_SYS_IMAGES };
@@ -897,13 +1243,14 @@ static int populate_android(struct bootscan_bootables bootlist[],
 	/* Lets check if there is an android system image */
 	findex = 0;
 	while (aimages[findex][0] != '\0') {
-		if (check_for_file(bootlist, bootindex, aimages[findex]) == 1) {
+		if (bootscan_has_file(bootlist, bootindex, root,
+				      aimages[findex], aimages[findex]) == 1) {
 			/* We hit on an Android system image install */
 			/* This should have a boot.ini or a boot.scr */
 			bindex = 0;
 			while (inis[bindex][0] != '\0') {
-				if (check_for_file(bootlist, bootindex,
-					inis[bindex]) == 1) {
+				if (bootscan_has_file(bootlist, bootindex,
+					root, inis[bindex], inis[bindex]) == 1) {
 					/* We got the ini */
 					isandroid = 1;
 					bootlist[*bootindex].rootfs = ANDROID_INSTALLER;
@@ -922,7 +1269,8 @@ static int populate_android(struct bootscan_bootables bootlist[],
 	/* Lets check if there is a linux image */
 	findex = 0;
 	while ( (isandroid != 1) && (images[findex][0] != '\0') ) {
-		if (check_for_file(bootlist, bootindex, images[findex]) == 1) {
+		if (bootscan_has_file(bootlist, bootindex, root,
+				      images[findex], images[findex]) == 1) {
 			/* We hit on a linux image. Cant be Android! */
 			return 0;
 		}
@@ -940,6 +1288,11 @@ static int populate_android(struct bootscan_bootables bootlist[],
 		strcpy(bootlist[*bootindex].bootimage,
 		       BOOTSCAN_ANDROID_LABEL);
 	(*bootindex)++;
+	if (*bootindex < BOOTSCAN_MAX_BOOTABLES) {
+		/* Prep next bootlist structure */
+		memcpy(&bootlist[*bootindex], &bootlist[*bootindex - 1],
+		       sizeof(struct bootscan_bootables));
+	}
 
 	return 1;
 }
@@ -951,23 +1304,28 @@ static int populate_android(struct bootscan_bootables bootlist[],
  * files.
  */
 static int populate_linux(struct bootscan_bootables bootlist[],
-			  int *bootindex)
+			  int *bootindex, struct bootscan_dir *root,
+			  struct bootscan_dir *base[])
 {
 	char *images[] = { BOOTSCAN_BOOTIMAGES };
 	char *initrds[] = { BOOTSCAN_BOOTINITRDS };
 	char *inis[] = { BOOTSCAN_BOOTINIS };
 	char *basedirs[] = { BOOTSCAN_BOOTBASEDIRS };
 	char *rootfs[] = { BOOTSCAN_ROOTFS };
+	struct bootscan_dir *dir;
 	int bdindex = 0;
-	int findex;
+	int findex, len;
 	int found, updated = 0;
+	char *top;
 
 	/* Lets check for a linux rootfs */
 	findex = 0;
 	bootlist[*bootindex].rootfs = UNKNOWN;
 	while (rootfs[findex][0] != '\0') {
 		/* rootfs[] already contains full path */
-		if (check_for_file(bootlist, bootindex,
+		len = bootscan_topdir(rootfs[findex], &top);
+		if ((len && bootscan_find(root, top, len) == NULL) ||
+		    check_for_file(bootlist, bootindex,
 		    rootfs[findex]) == 0) {
 			findex++;
 			continue;
@@ -979,6 +1337,12 @@ static int populate_linux(struct bootscan_bootables bootlist[],
 
 	/* Now lets check for the linux image related stuff */
 	while (basedirs[bdindex][0] != '\0') {
+		dir = base[bdindex];
+		if (dir == NULL) {
+			bdindex++;
+			continue;
+		}
+
 		/* Lets check if there is a linux image */
 		found = 0;
 		findex = 0;
@@ -988,8 +1352,8 @@ static int populate_linux(struct bootscan_bootables bootlist[],
 			       basedirs[bdindex]);
 			strcat(bootlist[*bootindex].bootimage,
 			       images[findex]);
-			if (check_for_file(bootlist, bootindex,
-			    bootlist[*bootindex].bootimage) == 0) {
+			if (bootscan_has_file(bootlist, bootindex, dir,
+			    images[findex], bootlist[*bootindex].bootimage) == 0) {
 				findex++;
 				bootlist[*bootindex].bootimage[0] = '\0';
 				continue;
@@ -1020,8 +1384,8 @@ static int populate_linux(struct bootscan_bootables bootlist[],
 			       basedirs[bdindex]);
 			strcat(bootlist[*bootindex].bootinitrd,
 			       initrds[findex]);
-			if (check_for_file(bootlist, bootindex,
-			    bootlist[*bootindex].bootinitrd) == 0) {
+			if (bootscan_has_file(bootlist, bootindex, dir,
+			    initrds[findex], bootlist[*bootindex].bootinitrd) == 0) {
 				findex++;
 				bootlist[*bootindex].bootinitrd[0] = '\0';
 				continue;
@@ -1038,8 +1402,8 @@ static int populate_linux(struct bootscan_bootables bootlist[],
 			       basedirs[bdindex]);
 			strcat(bootlist[*bootindex].bootini,
 			       inis[findex]);
-			if (check_for_file(bootlist, bootindex,
-			    bootlist[*bootindex].bootini) == 0) {
+			if (bootscan_has_file(bootlist, bootindex, dir,
+			    inis[findex], bootlist[*bootindex].bootini) == 0) {
 				findex++;
 				bootlist[*bootindex].bootini[0] = '\0';
 				continue;
@@ -1090,16 +1454,55 @@ static int populate_linux(struct bootscan_bootables bootlist[],
  * The above takes care of the location of the linux kernel and its supporting
  * files - could be any partition type - fat/ext
  *
+ * The root directory and the base directories are each listed once, and all
+ * of the names above are matched against those listings. Only the rootfs
+ * files are looked up on their own, when their directory exists.
+ * With CONFIG_BOOTSCAN_INVENTORY, what was found is taken from the inventory
+ * instead when the root and base directories have not changed since the
+ * last scan.
  */
 static void populate_bootfiles(struct bootscan_bootables bootlist[],
 			       int *bootindex)
 {
+	char *basedirs[] = { BOOTSCAN_BOOTBASEDIRS };
+	struct bootscan_dir root, sub[ARRAY_SIZE(basedirs)];
+	struct bootscan_dir *base[ARRAY_SIZE(basedirs)];
+	int listed;
+#ifdef CONFIG_BOOTSCAN_INVENTORY
+	int first = *bootindex;
+	u32 stamp = 0;
+#endif
+
+	bootlist[*bootindex].bootimage[0] = '\0';
+	bootlist[*bootindex].bootinitrd[0] = '\0';
+	bootlist[*bootindex].bootini[0] = '\0';
+	bootlist[*bootindex].rootfs = UNKNOWN;
+
+	/* A root directory we cannot read is scanned as an empty one */
+	listed = (bootscan_readdir(bootlist, bootindex, "/", &root) == 0);
+	if (!listed)
+		root.count = 0;
+	bootscan_basedirs(bootlist, bootindex, &root, sub, base);
+
+#ifdef CONFIG_BOOTSCAN_INVENTORY
+	if (listed) {
+		stamp = bootscan_inventory_stamp(&root, base);
+		if (bootscan_inventory_find(bootlist, bootindex, stamp))
+			goto done;
+	}
+#endif
+
 	/* First do the Android check */
-	if (populate_android(bootlist, bootindex))
-		return;
+	if (!populate_android(bootlist, bootindex, &root)) {
+		/* Lets do the Linux checks now */
+		populate_linux(bootlist, bootindex, &root, base);
+	}
 
-	/* Lets do the Linux checks now */
-	populate_linux(bootlist, bootindex);
+#ifdef CONFIG_BOOTSCAN_INVENTORY
+done:
+	if (listed)
+		bootscan_inventory_add(bootlist, first, *bootindex, stamp);
+#endif
 }
 
 static void populate_partitions(struct bootscan_bootables *bootlist,
@@ -1156,13 +1559,15 @@ static void populate_devices(struct bootscan_bootables bootlist[],
 	int part;
 
 	/* Populate bootlist from each device and the partitions within */
-	for (device = 0; device < BOOTSCAN_MAX_DEVICES; device++) {
+	for (device = 0; (device < BOOTSCAN_MAX_DEVICES) &&
+	     (*bootindex < BOOTSCAN_MAX_BOOTABLES); device++) {
 		dev_desc = get_dev(bootlist[*bootindex].interface, device);
 		if (dev_desc == NULL)
 			continue;
 		bootlist[*bootindex].device = device;
 		debug("Working on device: %d\n", device);
-		for (part = 0; part < BOOTSCAN_MAX_PARTITIONS; part++) {
+		for (part = 0; (part < BOOTSCAN_MAX_PARTITIONS) &&
+		     (*bootindex < BOOTSCAN_MAX_BOOTABLES); part++) {
 			bootlist[*bootindex].partition = part;
 			populate_partitions(bootlist, dev_desc, bootindex);
 		}
@@ -1295,6 +1700,13 @@ static void populate_bootlist(struct bootscan_bootables bootlist[])
 	ide_init();
 #endif /* CONFIG_CMD_IDE */
 
+#ifdef CONFIG_BOOTSCAN_INVENTORY
+	bootscan_inventory = malloc(BOOTSCAN_MAX_BOOTABLES *
+				    BOOTSCAN_INVENTORY_ENTRY);
+	if (bootscan_inventory)
+		bootscan_inventory[0] = '\0';
+#endif
+
 	/* Populate bootlist from each interface */
 	while ((interfaces[i][0] != '\0') &&
 	       (bootindex < BOOTSCAN_MAX_BOOTABLES)) {
@@ -1308,6 +1720,10 @@ static void populate_bootlist(struct bootscan_bootables bootlist[])
 		bootlist[bootindex].fstype = '0';
 	}
 
+#ifdef CONFIG_BOOTSCAN_INVENTORY
+	bootscan_inventory_save();
+#endif
+
 	/* No boot list! */
 	if (bootlist[0].fstype == '0') return;
 
@@ -136,6 +136,7 @@ static struct cmd_fastboot_interface interface =
 	.nand_block_size       = 0,
 	.transfer_buffer       = (unsigned char *)0xffffffff,
 	.transfer_buffer_size  = 0,
+	.rx_dma                = NULL,
 };
 
 static unsigned int download_size;
@@ -143,6 +144,18 @@ static unsigned int download_bytes;
 //static unsigned int download_bytes_unpadded;
 static unsigned int download_error;
 
+#if defined(CFG_FASTBOOT_SDMMCBSP)
+/* Partition armed by 'oem stream:<name>'. The next download is written
+   to it through the sparse image writer while it is being received,
+   so the image is neither limited by nor copied into the transfer buffer.
+   That download disarms it again and records the partition in
+   streamed_ptn, which the following 'flash:' checks */
+static struct fastboot_ptentry *stream_ptn;
+static struct fastboot_ptentry *streamed_ptn;
+static struct ext4_sparse_ctx stream_ctx;
+static unsigned int stream_done;
+#endif
+
 /* To support the Android-style naming of flash */
 #define MAX_PTN 16
 static fastboot_ptentry ptable[MAX_PTN];
@@ -208,6 +221,13 @@ static void save_env(struct fastboot_ptentry *ptn,
 static void reset_handler ()
 {
 	/* If there was a download going on, bail */
+#if defined(CFG_FASTBOOT_SDMMCBSP)
+	if (streamed_ptn && download_size)
+		ext4_sparse_finish(&stream_ctx);
+	stream_ptn = NULL;
+	streamed_ptn = NULL;
+	stream_done = 0;
+#endif
 	download_size = 0;
 	download_bytes = 0;
 	//download_bytes_unpadded = 0;
@@ -491,6 +511,64 @@ static int DEV_NUM = 0;
 #define	DEV_NUM 0
 #endif
 #endif
+/* Clear the whole partition before a sparse ext4 image is written to it,
+   so that the blocks the image leaves out (DONT_CARE) do not keep stale data */
+static void erase_ptn_sdmmc(struct fastboot_ptentry *ptn)
+{
+	char cmd[32], device[32];
+	char start[32], length[32], buffer[32];
+	char *argv[6]  = { NULL, cmd, NULL, NULL, NULL, NULL, };
+	char *nul_buf;
+	struct mmc *mmc;
+	uint bl_st = ptn->start / CFG_FASTBOOT_SDMMC_BLOCKSIZE;
+	uint bl_cnt = ptn->length / CFG_FASTBOOT_SDMMC_BLOCKSIZE;
+
+	nul_buf = calloc(sizeof(char), 512*1024);
+	mmc = find_mmc_device(DEV_NUM);
+
+	if (bl_st&0x3ff)
+	{
+		mmc->block_dev.block_write(DEV_NUM, bl_st, 1024 -(bl_st&0x3ff), nul_buf);
+
+		printf("*** erase start block 0x%x ***\n", bl_st);
+
+		bl_cnt = bl_cnt - (1024-(bl_st&0x3ff));
+		bl_st = (bl_st&(~0x3ff))+1024;
+	}
+
+	if (bl_cnt&0x3ff)
+	{
+		mmc->block_dev.block_write(DEV_NUM, bl_st+bl_cnt-(bl_cnt&0x3ff), bl_cnt&0x3ff, nul_buf);
+
+		printf("*** erase block length 0x%x ***\n", bl_cnt);
+
+		bl_cnt = bl_cnt - (bl_cnt&0x3ff);
+	}
+
+	free(nul_buf);
+
+	if (bl_cnt>>10)
+	{
+		argv[2] = buffer;
+		argv[3] = device;
+		argv[4] = start;
+		argv[5] = length;
+
+		sprintf(cmd, "erase");
+		sprintf(buffer, "user");
+		sprintf(device, "%d", DEV_NUM);
+		sprintf(start, "%d", bl_st);
+		sprintf(length, "%d", bl_cnt);
+		printf("mmc %s %s %s %s %s\n", argv[1], argv[2], argv[3], argv[4], argv[5]);
+
+		do_mmcops(NULL, 0, 6, argv);
+	}
+	else
+	{
+		printf("*** erase block length too small ***\n");
+	}
+}
+
 static int write_to_ptn_sdmmc(struct fastboot_ptentry *ptn, unsigned int addr, unsigned int size)
 {
 	int ret = 1;
@@ -499,8 +577,6 @@ static int write_to_ptn_sdmmc(struct fastboot_ptentry *ptn, unsigned int addr, u
 	char dev_num[2];
 	char *argv[6]  = { NULL, NULL, NULL, NULL, NULL, NULL, };
 	int argc = 0;
-	char *nul_buf;
-	struct mmc *mmc;
 
 	if ((ptn->length != 0) && (size > ptn->length))
 	{
@@ -528,55 +604,9 @@ static int write_to_ptn_sdmmc(struct fastboot_ptentry *ptn, unsigned int addr, u
 
 			ret = do_mmcops(NULL, 0, 6, argv);
 		} else {
-			uint bl_st = ptn->start / CFG_FASTBOOT_SDMMC_BLOCKSIZE;
-			uint bl_cnt = ptn->length / CFG_FASTBOOT_SDMMC_BLOCKSIZE;
-
 			printf("Compressed ext4 image\n");
 
-			nul_buf = calloc(sizeof(char), 512*1024);
-			mmc = find_mmc_device(DEV_NUM);
-
-			if (bl_st&0x3ff)
-			{
-				mmc->block_dev.block_write(DEV_NUM, bl_st, 1024 -(bl_st&0x3ff), nul_buf);
-
-				printf("*** erase start block 0x%x ***\n", bl_st);
-
-				bl_cnt = bl_cnt - (1024-(bl_st&0x3ff));
-				bl_st = (bl_st&(~0x3ff))+1024;
-			}
-
-			if (bl_cnt&0x3ff)
-			{
-				mmc->block_dev.block_write(DEV_NUM, bl_st+bl_cnt-(bl_cnt&0x3ff), bl_cnt&0x3ff, nul_buf);
-
-				printf("*** erase block length 0x%x ***\n", bl_cnt);
-
-				bl_cnt = bl_cnt - (bl_cnt&0x3ff);
-			}
-
-			free(nul_buf);
-
-			if (bl_cnt>>10)
-			{
-				argv[2] = buffer;
-				argv[3] = device;
-				argv[4] = start;
-				argv[5] = length;
-
-				sprintf(cmd, "erase");
-				sprintf(buffer, "user");
-				sprintf(device, "%d", DEV_NUM);
-				sprintf(start, "%d", bl_st);
-				sprintf(length, "%d", bl_cnt);
-				printf("mmc %s %s %s %s %s\n", argv[1], argv[2], argv[3], argv[4], argv[5]);
-
-				ret = do_mmcops(NULL, 0, 6, argv);
-			}
-			else
-			{
-				printf("*** erase block length too small ***\n");
-			}
+			erase_ptn_sdmmc(ptn);
 			ret = write_compressed_ext4((char*)addr,
 					ptn->start / CFG_FASTBOOT_SDMMC_BLOCKSIZE);
 		}
@@ -694,6 +724,22 @@ static int write_to_ptn_sdmmc(struct fastboot_ptentry *ptn, unsigned int addr, u
 #endif
 
 
+#if defined(CFG_FASTBOOT_SDMMCBSP)
+static int stream_start(void)
+{
+	streamed_ptn = stream_ptn;
+	stream_ptn = NULL;
+	stream_done = 0;
+
+	/* As write_to_ptn_sdmmc() does for a buffered sparse image */
+	erase_ptn_sdmmc(streamed_ptn);
+
+	return ext4_sparse_init(&stream_ctx, mmc_get_dev(DEV_NUM),
+			streamed_ptn->start / CFG_FASTBOOT_SDMMC_BLOCKSIZE,
+			streamed_ptn->length / CFG_FASTBOOT_SDMMC_BLOCKSIZE);
+}
+#endif
+
 static int rx_handler (const unsigned char *buffer, unsigned int buffer_size)
 {
 	int ret = 1;
@@ -715,9 +761,21 @@ static int rx_handler (const unsigned char *buffer, unsigned int buffer_size)
 			if (buffer_size < transfer_size)
 				transfer_size = buffer_size;
 
-			/* Save the data to the transfer buffer */
-			memcpy (interface.transfer_buffer + download_bytes,
-				buffer, transfer_size);
+#if defined(CFG_FASTBOOT_SDMMCBSP)
+			if (streamed_ptn)
+			{
+				/* Write the data through to the partition */
+				if (!download_error &&
+				    ext4_sparse_write(&stream_ctx, buffer, transfer_size))
+					download_error = 1;
+			}
+			else
+#endif
+			/* Save the data to the transfer buffer, unless
+			   it was received there already */
+			if (buffer != interface.transfer_buffer + download_bytes)
+				memcpy (interface.transfer_buffer + download_bytes,
+					buffer, transfer_size);
 
 			download_bytes += transfer_size;
 
@@ -729,6 +787,16 @@ static int rx_handler (const unsigned char *buffer, unsigned int buffer_size)
 				   used in the next possible flashing command */
 				download_size = 0;
 
+#if defined(CFG_FASTBOOT_SDMMCBSP)
+				if (streamed_ptn)
+				{
+					if (ext4_sparse_finish(&stream_ctx))
+						download_error = 1;
+					else
+						stream_done = 1;
+				}
+#endif
+
 				if (download_error)
 				{
 					/* There was an earlier error */
@@ -948,6 +1016,11 @@ static int rx_handler (const unsigned char *buffer, unsigned int buffer_size)
 			download_bytes = 0;
 			/* Reset error */
 			download_error = 0;
+#if defined(CFG_FASTBOOT_SDMMCBSP)
+			/* This download replaces an earlier streamed one */
+			streamed_ptn = NULL;
+			stream_done = 0;
+#endif
 
 			printf ("Starting download of %d bytes\n", download_size);
 
@@ -956,6 +1029,22 @@ static int rx_handler (const unsigned char *buffer, unsigned int buffer_size)
 				/* bad user input */
 				sprintf(response, "FAILdata invalid size");
 			}
+#if defined(CFG_FASTBOOT_SDMMCBSP)
+			else if (stream_ptn)
+			{
+				if (stream_start())
+				{
+					download_size = 0;
+					streamed_ptn = NULL;
+					sprintf(response, "FAILstream setup failed");
+				}
+				else
+				{
+					printf("Streaming to '%s'\n", streamed_ptn->name);
+					sprintf(response, "DATA%08x", download_size);
+				}
+			}
+#endif
 			else if (download_size > interface.transfer_buffer_size)
 			{
 				/* set download_size to 0 because this is an error */
@@ -967,6 +1056,14 @@ static int rx_handler (const unsigned char *buffer, unsigned int buffer_size)
 				/* The default case, the transfer fits
 				   completely in the interface buffer */
 				sprintf(response, "DATA%08x", download_size);
+
+				/* Let the controller receive it in place,
+				   otherwise it comes in packet by packet */
+				if (interface.rx_dma &&
+				    interface.rx_dma(interface.transfer_buffer,
+						     download_size))
+					printf("Cannot receive by DMA, "
+					       "copying packets\n");
 			}
 			ret = 0;
 			goto send_tx_status;
@@ -1076,6 +1173,26 @@ static int rx_handler (const unsigned char *buffer, unsigned int buffer_size)
 		   Flash what was downloaded */
 		if (memcmp(cmdbuf, "flash:", 6) == 0)
 		{
+#if defined(CFG_FASTBOOT_SDMMCBSP)
+			/* Streamed downloads are already on the partition */
+			if (streamed_ptn)
+			{
+				if (!strcmp(streamed_ptn->name, cmdbuf + 6) && stream_done)
+				{
+					printf("partition '%s' flashed\n", streamed_ptn->name);
+					sprintf(response, "OKAY");
+				}
+				else
+				{
+					sprintf(response, "FAILstreamed download failed");
+				}
+				streamed_ptn = NULL;
+				stream_done = 0;
+				download_bytes = 0;
+				ret = 0;
+				goto send_tx_status;
+			}
+#endif
 			if (download_bytes == 0)
 			{
 				sprintf(response, "FAILno image downloaded");
@@ -1249,6 +1366,33 @@ static int rx_handler (const unsigned char *buffer, unsigned int buffer_size)
 		   oem command. */
 		if (memcmp(cmdbuf, "oem", 3) == 0)
 		{
+#if defined(CFG_FASTBOOT_SDMMCBSP)
+			/* oem stream:<partition>
+			   Write the next (sparse) download directly to
+			   the partition while receiving it */
+			if (memcmp(cmdbuf + 3, " stream:", 8) == 0)
+			{
+				struct fastboot_ptentry *ptn;
+
+				ptn = fastboot_flash_find_ptn(cmdbuf + 11);
+				if (ptn == 0)
+				{
+					sprintf(response, "FAILpartition does not exist");
+				}
+				else if (!(ptn->flags & FASTBOOT_PTENTRY_FLAGS_USE_MMC_CMD))
+				{
+					sprintf(response, "FAILpartition can not be streamed");
+				}
+				else
+				{
+					stream_ptn = ptn;
+					stream_done = 0;
+					sprintf(response, "OKAY");
+				}
+				ret = 0;
+				goto send_tx_status;
+			}
+#endif
 			sprintf(response,"INFOunknown OEM command");
 			fastboot_tx_status(response, strlen(response), FASTBOOT_TX_ASYNC);
 
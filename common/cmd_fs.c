@@ -37,6 +37,28 @@ U_BOOT_CMD(
 	"      If 'pos' is 0 or omitted, the file is read from the start."
 );
 
+#ifdef CONFIG_DECOMP_STREAM
+int do_loadz_wrapper(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
+{
+	return do_loadz(cmdtp, flag, argc, argv, FS_TYPE_ANY);
+}
+
+U_BOOT_CMD(
+	loadz,	7,	0,	do_loadz_wrapper,
+	"load and uncompress a file from a filesystem",
+	"<interface> [<dev[:part]> [<addr> [<filename> [bytes [comp]]]]]\n"
+	"    - Load compressed file 'filename' from partition 'part' on\n"
+	"      device type 'interface' instance 'dev' and uncompress it to\n"
+	"      address 'addr' while it is being read.\n"
+	"      'bytes' limits the uncompressed size, 0 or omitted means\n"
+	"      the bootm size limit, CONFIG_SYS_BOOTM_LEN.\n"
+	"      'comp' is gzip, lzo, lzma or lz4, if omitted it is taken\n"
+	"      from the file's magic (lzma has none). A compressed legacy\n"
+	"      uImage is stored at 'addr' as an uncompressed one, ready\n"
+	"      for bootm."
+);
+#endif
+
 int do_ls_wrapper(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 {
 	return do_ls(cmdtp, flag, argc, argv, FS_TYPE_ANY);
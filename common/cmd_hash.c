@@ -0,0 +1,57 @@
+/*
+ * Message digest of a memory region
+ *
+ * See file CREDITS for list of people who contributed to this
+ * project.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ */
+
+#include <common.h>
+#include <command.h>
+#include <hash.h>
+
+int do_hash(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
+{
+	unsigned long addr, len;
+	unsigned char output[HASH_MAX_DIGEST_SIZE];
+	int i, size;
+
+	if (argc < 4)
+		return cmd_usage(cmdtp);
+
+	addr = simple_strtoul(argv[2], NULL, 16);
+	len = simple_strtoul(argv[3], NULL, 16);
+
+	if (hash_block(argv[1], (void *)addr, len, output, &size)) {
+		printf("Unknown hash algorithm '%s'\n", argv[1]);
+		return 1;
+	}
+
+	printf("%s for %08lx ... %08lx ==> ", argv[1], addr, addr + len - 1);
+	for (i = 0; i < size; i++)
+		printf("%02x", output[i]);
+	printf("\n");
+
+	return 0;
+}
+
+U_BOOT_CMD(
+	hash,	4,	1,	do_hash,
+	"compute message digest",
+	"algorithm address count\n"
+	"    - algorithm is one of crc32, md5, sha1, sha256"
+);
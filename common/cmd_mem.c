@@ -36,6 +36,9 @@
 
 #include <u-boot/md5.h>
 #include <sha1.h>
+#ifdef CONFIG_HASH
+#include <hash.h>
+#endif
 
 #ifdef	CMD_MEM_DEBUG
 #define	PRINTF(fmt,args...)	printf (fmt ,##args)
@@ -1174,7 +1177,14 @@ int do_md5sum(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 	addr = simple_strtoul(argv[1], NULL, 16);
 	len = simple_strtoul(argv[2], NULL, 16);
 
+#ifdef CONFIG_HASH
+	if (hash_block("md5", (void *)addr, len, output, NULL)) {
+		printf("md5 failed\n");
+		return 1;
+	}
+#else
 	md5((unsigned char *) addr, len, output);
+#endif
 	printf("md5 for %08lx ... %08lx ==> ", addr, addr + len - 1);
 	for (i = 0; i < 16; i++)
 		printf("%02x", output[i]);
@@ -1197,7 +1207,14 @@ int do_sha1sum(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 	addr = simple_strtoul(argv[1], NULL, 16);
 	len = simple_strtoul(argv[2], NULL, 16);
 
+#ifdef CONFIG_HASH
+	if (hash_block("sha1", (void *)addr, len, output, NULL)) {
+		printf("sha1 failed\n");
+		return 1;
+	}
+#else
 	sha1_csum((unsigned char *) addr, len, output);
+#endif
 	printf("SHA1 for %08lx ... %08lx ==> ", addr, addr + len - 1);
 	for (i = 0; i < 20; i++)
 		printf("%02x", output[i]);
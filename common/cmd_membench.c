@@ -0,0 +1,96 @@
+/*
+ * memcpy/memmove/memset throughput
+ *
+ * See file CREDITS for list of people who contributed to this
+ * project.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ */
+
+#include <common.h>
+#include <command.h>
+
+/* run each test for at least this long */
+#define MEMBENCH_MS	500
+
+enum { BENCH_MEMCPY, BENCH_MEMMOVE, BENCH_MEMSET };
+
+static void membench_one(const char *name, int op, char *dst,
+			 const char *src, ulong size)
+{
+	ulong start, ms, kib = 0;
+
+	start = get_timer(0);
+	do {
+		switch (op) {
+		case BENCH_MEMCPY:
+			memcpy(dst, src, size);
+			break;
+		case BENCH_MEMMOVE:
+			memmove(dst, src, size);
+			break;
+		default:
+			memset(dst, 0x5a, size);
+			break;
+		}
+		kib += size >> 10;
+		ms = get_timer(start);
+	} while (ms < MEMBENCH_MS);
+
+	printf("%-26s %6lu MB/s\n", name, kib * 1000 / 1024 / ms);
+}
+
+int do_membench(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
+{
+	ulong addr = CONFIG_SYS_LOAD_ADDR;
+	ulong size = 1 << 20;
+	char *src, *dst;
+
+	if (argc > 1)
+		addr = simple_strtoul(argv[1], NULL, 16);
+	if (argc > 2)
+		size = simple_strtoul(argv[2], NULL, 16);
+
+	if (size < 1024)
+		return cmd_usage(cmdtp);
+
+	/* src and dst are cache line aligned, with room for the offsets */
+	src = (char *)((addr + 63) & ~63);
+	dst = src + ((size + 64 + 63) & ~63);
+
+	printf("%lu KiB buffers at 0x%08lx/0x%08lx\n",
+		size >> 10, (ulong)src, (ulong)dst);
+
+	membench_one("memcpy aligned", BENCH_MEMCPY, dst, src, size);
+	membench_one("memcpy dst+1", BENCH_MEMCPY, dst + 1, src, size);
+	membench_one("memcpy src+3", BENCH_MEMCPY, dst, src + 3, size);
+	membench_one("memcpy dst+2 src+1", BENCH_MEMCPY, dst + 2, src + 1, size);
+	membench_one("memmove overlap up", BENCH_MEMMOVE, src + 64, src, size);
+	membench_one("memmove overlap up +1", BENCH_MEMMOVE, src + 65, src, size);
+	membench_one("memmove overlap down", BENCH_MEMMOVE, src, src + 64, size);
+	membench_one("memset aligned", BENCH_MEMSET, dst, NULL, size);
+	membench_one("memset dst+1", BENCH_MEMSET, dst + 1, NULL, size);
+
+	return 0;
+}
+
+U_BOOT_CMD(
+	membench,	3,	0,	do_membench,
+	"measure memcpy/memmove/memset throughput",
+	"[addr [size]]\n"
+	"    - copy and fill 'size' bytes (default 1 MiB) of RAM at 'addr'\n"
+	"      (default CONFIG_SYS_LOAD_ADDR); needs 2 * size + 256 bytes"
+);
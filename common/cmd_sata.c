@@ -27,16 +27,43 @@
 #include <command.h>
 #include <part.h>
 #include <sata.h>
+#include <blkcache.h>
 
 int sata_curr_device = -1;
 block_dev_desc_t sata_dev_desc[CONFIG_SYS_SATA_MAX_DEVICE];
 
+static unsigned long sata_bread(int dev, lbaint_t start, lbaint_t blkcnt,
+				void *dst)
+{
+	unsigned long ret;
+
+	if (blkcache_read(IF_TYPE_SATA, dev, start, blkcnt,
+			  sata_dev_desc[dev].blksz, dst))
+		return blkcnt;
+
+	ret = sata_read(dev, start, blkcnt, dst);
+	if (ret == blkcnt)
+		blkcache_fill(IF_TYPE_SATA, dev, start, blkcnt,
+			      sata_dev_desc[dev].blksz, dst);
+
+	return ret;
+}
+
+static unsigned long sata_bwrite(int dev, lbaint_t start, lbaint_t blkcnt,
+				 const void *src)
+{
+	blkcache_invalidate(IF_TYPE_SATA, dev);
+
+	return sata_write(dev, start, blkcnt, src);
+}
+
 int __sata_initialize(void)
 {
 	int rc;
 	int i;
 
 	for (i = 0; i < CONFIG_SYS_SATA_MAX_DEVICE; i++) {
+		blkcache_invalidate(IF_TYPE_SATA, i);
 		memset(&sata_dev_desc[i], 0, sizeof(struct block_dev_desc));
 		sata_dev_desc[i].if_type = IF_TYPE_SATA;
 		sata_dev_desc[i].dev = i;
@@ -44,8 +71,8 @@ int __sata_initialize(void)
 		sata_dev_desc[i].type = DEV_TYPE_HARDDISK;
 		sata_dev_desc[i].lba = 0;
 		sata_dev_desc[i].blksz = 512;
-		sata_dev_desc[i].block_read = sata_read;
-		sata_dev_desc[i].block_write = sata_write;
+		sata_dev_desc[i].block_read = sata_bread;
+		sata_dev_desc[i].block_write = sata_bwrite;
 
 		rc = init_sata(i);
 		rc = scan_sata(i);
@@ -157,7 +184,7 @@ int do_sata(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 			printf("\nSATA read: device %d block # %ld, count %ld ... ",
 				sata_curr_device, blk, cnt);
 
-			n = sata_read(sata_curr_device, blk, cnt, (u32 *)addr);
+			n = sata_bread(sata_curr_device, blk, cnt, (u32 *)addr);
 
 			/* flush cache after read */
 			flush_cache(addr, cnt * sata_dev_desc[sata_curr_device].blksz);
@@ -175,7 +202,7 @@ int do_sata(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 			printf("\nSATA write: device %d block # %ld, count %ld ... ",
 				sata_curr_device, blk, cnt);
 
-			n = sata_write(sata_curr_device, blk, cnt, (u32 *)addr);
+			n = sata_bwrite(sata_curr_device, blk, cnt, (u32 *)addr);
 
 			printf("%ld blocks written: %s\n",
 				n, (n == cnt) ? "OK" : "ERROR");
@@ -6,6 +6,7 @@
  * published by the Free Software Foundation.
 */
 
+#ifndef USE_HOSTCC
 #include <common.h>
 #include <asm/io.h>
 #include <asm/types.h>
@@ -16,14 +17,15 @@
 #include <asm/errno.h>
 #include <decompress_ext4.h>
 #include <mmc.h>
+#include <malloc.h>
+#else
+#include "ext4_sparse_test.h"
+#endif
 
 #define SECTOR_BITS		9	/* 512B */
 
 #define ext4_printf(args, ...)
 
-static int write_raw_chunk(char* data, unsigned int sector, unsigned int sector_size);
-
-
 int check_compress_ext4(char *img_base, unsigned long long parti_size) {
 	ext4_file_header *file_header;
 
@@ -70,68 +72,424 @@ int check_compress_ext4(char *img_base, unsigned long long parti_size) {
     extern  unsigned char GLOBAL_SYSTEM_PART;
 #endif    
 
-int write_raw_chunk(char* data, unsigned int sector, unsigned int sector_size) {
-	char run_cmd[64];
+/*
+ * Streaming sparse image writer.
+ *
+ * The image is fed in arbitrary sized pieces, e.g. straight from the
+ * fastboot download handler, so it never has to be resident in memory
+ * as a whole. RAW chunks go to block_write, either directly from the
+ * caller's buffer or gathered in ctx->buf, FILL chunks are written from
+ * ctx->buf holding the replicated pattern and DONT_CARE chunks are skipped.
+ *
+ * Devices with block_write_start get the writes queued: ctx->buf then
+ * alternates between two buffers, so the next one is filled while the
+ * card still writes the previous one.
+ */
+static int sparse_wait(struct ext4_sparse_ctx *ctx)
+{
+	if (!ctx->inflight)
+		return 0;
 
-	ext4_printf("write raw data in %d size %d \n", sector, sector_size);
+	ctx->inflight = 0;
+	ctx->inflight_user = 0;
+	if (ctx->dev->block_xfer_done(ctx->dev->dev, 1)) {
+		printf("sparse: write failed\n");
+		return -1;
+	}
 
-#if defined(CONFIG_HKDK4412)
-	sprintf(run_cmd,"mmc write %d 0x%x 0x%x 0x%x", GLOBAL_SYSTEM_PART, (int)data, sector, sector_size);
-#else
-	sprintf(run_cmd,"mmc write 0 0x%x 0x%x 0x%x", (int)data, sector, sector_size);
-#endif	
-	run_command(run_cmd, 0);
+	return 0;
+}
 
+/* hand the staging buffer to a running write and continue in the other */
+static void sparse_swap_buf(struct ext4_sparse_ctx *ctx)
+{
+	if (ctx->bufs[1])
+		ctx->buf = (ctx->buf == ctx->bufs[0]) ? ctx->bufs[1] :
+							ctx->bufs[0];
+}
+
+static int sparse_block_write(struct ext4_sparse_ctx *ctx,
+			      const void *data, lbaint_t cnt)
+{
+	if (ctx->sector_limit && ctx->sector + cnt > ctx->sector_limit) {
+		printf("sparse: image exceeds partition size\n");
+		return -1;
+	}
+
+	ext4_printf("write raw data in %lu size %lu \n",
+			(ulong)(ctx->sector_base + ctx->sector), (ulong)cnt);
+
+	if (ctx->bufs[1]) {
+		if (sparse_wait(ctx))
+			return -1;
+		if (ctx->dev->block_write_start(ctx->dev->dev,
+				ctx->sector_base + ctx->sector, cnt, data)) {
+			printf("sparse: write failed at sector 0x%lx\n",
+				(ulong)(ctx->sector_base + ctx->sector));
+			return -1;
+		}
+		ctx->inflight = 1;
+		ctx->inflight_user = (data != ctx->buf);
+	} else if (ctx->dev->block_write(ctx->dev->dev,
+				ctx->sector_base + ctx->sector,
+				cnt, data) != cnt) {
+		printf("sparse: write failed at sector 0x%lx\n",
+			(ulong)(ctx->sector_base + ctx->sector));
+		return -1;
+	}
+
+	ctx->sector += cnt;
 	return 0;
 }
 
-int write_compressed_ext4(char* img_base, unsigned int sector_base) {
-	unsigned int sector_size;
-	int total_chunks;
-	ext4_chunk_header *chunk_header;
-	ext4_file_header *file_header;
+static int sparse_flush(struct ext4_sparse_ctx *ctx)
+{
+	int ret = 0;
 
-	file_header = (ext4_file_header*)img_base;
-	total_chunks = file_header->total_chunks;
+	if (ctx->buf_len) {
+		ret = sparse_block_write(ctx, ctx->buf,
+					 ctx->buf_len >> SECTOR_BITS);
+		sparse_swap_buf(ctx);
+	}
+	ctx->buf_len = 0;
 
-	ext4_printf("total chunk = %d \n", total_chunks);
+	return ret;
+}
 
-	img_base += EXT4_FILE_HEADER_SIZE;
+static int sparse_fill(struct ext4_sparse_ctx *ctx)
+{
+	lbaint_t left = ctx->chunk_sectors;
+	lbaint_t max = CONFIG_EXT4_SPARSE_BUF_SIZE >> SECTOR_BITS;
+	lbaint_t cnt;
+	u32 *p;
+	int i;
 
-	while(total_chunks) {
-		chunk_header = (ext4_chunk_header*)img_base;
-		sector_size = (chunk_header->chunk_size * file_header->block_size) >> SECTOR_BITS;
+	/* replicate the pattern once, then reuse it for the whole chunk */
+	cnt = left < max ? left : max;
+	p = (u32 *)ctx->buf;
+	for (i = 0; i < (cnt << SECTOR_BITS) / sizeof(u32); i++)
+		p[i] = ctx->fill;
 
-		switch(chunk_header->type)
-		{
-		case EXT4_CHUNK_TYPE_RAW:
-			ext4_printf("raw_chunk \n");
-			write_raw_chunk(img_base + EXT4_CHUNK_HEADER_SIZE,
-							sector_base, sector_size);
-			sector_base += sector_size;
+	while (left) {
+		cnt = left < max ? left : max;
+		if (sparse_block_write(ctx, ctx->buf, cnt))
+			return -1;
+		left -= cnt;
+	}
+	sparse_swap_buf(ctx);
+
+	return 0;
+}
+
+static int sparse_file_header(struct ext4_sparse_ctx *ctx)
+{
+	ext4_file_header *fh = &ctx->file_header;
+
+	memcpy(fh, ctx->hdr, EXT4_FILE_HEADER_SIZE);
+
+	if (fh->magic != EXT4_FILE_HEADER_MAGIC) {
+		printf("sparse: bad magic 0x%08x\n", fh->magic);
+		return -1;
+	}
+
+	if (fh->major != EXT4_FILE_HEADER_MAJOR) {
+		printf("Invalid Version Info! 0x%2x\n", fh->major);
+		return -1;
+	}
+
+	if (fh->file_header_size < EXT4_FILE_HEADER_SIZE) {
+		printf("Invalid File Header Size! 0x%8x\n",
+						fh->file_header_size);
+		return -1;
+	}
+
+	if (fh->chunk_header_size != EXT4_CHUNK_HEADER_SIZE) {
+		printf("Invalid Chunk Header Size! 0x%8x\n",
+						fh->chunk_header_size);
+		return -1;
+	}
+
+	if (!fh->block_size || (fh->block_size & ((1 << SECTOR_BITS) - 1))) {
+		printf("Invalid Block Size! 0x%8x\n", fh->block_size);
+		return -1;
+	}
+
+	if (ctx->sector_limit && (lbaint_t)fh->total_blocks *
+	    (fh->block_size >> SECTOR_BITS) > ctx->sector_limit) {
+		printf("Invalid Volume Size! Image is bigger than partition size!\n");
+		return -1;
+	}
+
+	ext4_printf("total chunk = %d \n", fh->total_chunks);
+
+	ctx->chunks_left = fh->total_chunks;
+	/* newer images may carry a longer header, skip the rest of it */
+	ctx->chunk_left = fh->file_header_size - EXT4_FILE_HEADER_SIZE;
+	ctx->state = EXT4_SPARSE_SKIP;
+
+	return 0;
+}
+
+static int sparse_chunk_header(struct ext4_sparse_ctx *ctx)
+{
+	ext4_chunk_header *ch = &ctx->chunk_header;
+
+	memcpy(ch, ctx->hdr, EXT4_CHUNK_HEADER_SIZE);
+
+	if (ch->total_size < EXT4_CHUNK_HEADER_SIZE) {
+		printf("sparse: bad chunk size 0x%x\n", ch->total_size);
+		return -1;
+	}
+
+	ctx->chunks_left--;
+	ctx->chunk_left = ch->total_size - EXT4_CHUNK_HEADER_SIZE;
+	ctx->chunk_sectors = (lbaint_t)ch->chunk_size *
+				(ctx->file_header.block_size >> SECTOR_BITS);
+	ctx->hdr_len = 0;
+
+	switch (ch->type) {
+	case EXT4_CHUNK_TYPE_RAW:
+		ext4_printf("raw_chunk \n");
+		if (ctx->chunk_left != ctx->chunk_sectors << SECTOR_BITS) {
+			printf("sparse: bad raw chunk length 0x%x\n",
+				ctx->chunk_left);
+			return -1;
+		}
+		ctx->state = EXT4_SPARSE_RAW;
+		break;
+
+	case EXT4_CHUNK_TYPE_FILL:
+		ext4_printf("fill_chunk \n");
+		if (ctx->chunk_left != sizeof(ctx->fill)) {
+			printf("sparse: bad fill chunk length 0x%x\n",
+				ctx->chunk_left);
+			return -1;
+		}
+		ctx->hdr_want = sizeof(ctx->fill);
+		ctx->state = EXT4_SPARSE_FILL;
+		break;
+
+	case EXT4_CHUNK_TYPE_NONE:
+		ext4_printf("none chunk \n");
+		ctx->sector += ctx->chunk_sectors;
+		ctx->state = EXT4_SPARSE_SKIP;
+		break;
+
+	case EXT4_CHUNK_TYPE_CRC32:
+		ctx->state = EXT4_SPARSE_SKIP;
+		break;
+
+	default:
+		printf("*** unknown chunk type ***\n");
+		ctx->sector += ctx->chunk_sectors;
+		ctx->state = EXT4_SPARSE_SKIP;
+		break;
+	}
+
+	return 0;
+}
+
+static void sparse_next_chunk(struct ext4_sparse_ctx *ctx)
+{
+	ext4_printf("remain chunks = %d \n", ctx->chunks_left);
+
+	if (!ctx->chunks_left) {
+		ctx->state = EXT4_SPARSE_DONE;
+		return;
+	}
+
+	ctx->hdr_len = 0;
+	ctx->hdr_want = EXT4_CHUNK_HEADER_SIZE;
+	ctx->state = EXT4_SPARSE_CHUNK_HDR;
+}
+
+/* Collect header bytes, returns 1 once hdr_want bytes are present */
+static int sparse_gather(struct ext4_sparse_ctx *ctx,
+			 const unsigned char **data, unsigned int *len)
+{
+	unsigned int n = ctx->hdr_want - ctx->hdr_len;
+
+	if (n > *len)
+		n = *len;
+
+	memcpy(ctx->hdr + ctx->hdr_len, *data, n);
+	ctx->hdr_len += n;
+	*data += n;
+	*len -= n;
+
+	return ctx->hdr_len == ctx->hdr_want;
+}
+
+int ext4_sparse_init(struct ext4_sparse_ctx *ctx, block_dev_desc_t *dev,
+		     lbaint_t sector_base, lbaint_t sector_limit)
+{
+	memset(ctx, 0, sizeof(*ctx));
+
+	if (!dev || !dev->block_write) {
+		printf("sparse: no block device\n");
+		return -1;
+	}
+
+	ctx->bufs[0] = memalign(ARCH_DMA_MINALIGN, CONFIG_EXT4_SPARSE_BUF_SIZE);
+	if (!ctx->bufs[0]) {
+		printf("sparse: out of memory\n");
+		return -1;
+	}
+	ctx->buf = ctx->bufs[0];
+
+	/* without a second buffer the writes simply stay synchronous */
+	if (dev->block_write_start && dev->block_xfer_done)
+		ctx->bufs[1] = memalign(ARCH_DMA_MINALIGN,
+					CONFIG_EXT4_SPARSE_BUF_SIZE);
+
+	ctx->dev = dev;
+	ctx->sector_base = sector_base;
+	ctx->sector_limit = sector_limit;
+	ctx->hdr_want = EXT4_FILE_HEADER_SIZE;
+	ctx->state = EXT4_SPARSE_FILE_HDR;
+
+	return 0;
+}
+
+int ext4_sparse_write(struct ext4_sparse_ctx *ctx, const void *data,
+		      unsigned int len)
+{
+	const unsigned char *p = data;
+	unsigned int n;
+
+	while (len) {
+		switch (ctx->state) {
+		case EXT4_SPARSE_FILE_HDR:
+			if (sparse_gather(ctx, &p, &len) &&
+			    sparse_file_header(ctx))
+				goto err;
+			break;
+
+		case EXT4_SPARSE_CHUNK_HDR:
+			if (sparse_gather(ctx, &p, &len) &&
+			    sparse_chunk_header(ctx))
+				goto err;
+			break;
+
+		case EXT4_SPARSE_RAW:
+			n = len < ctx->chunk_left ? len : ctx->chunk_left;
+
+			if (!ctx->buf_len && n >= CONFIG_EXT4_SPARSE_BUF_SIZE) {
+				/* large piece, write it in place */
+				n &= ~((1 << SECTOR_BITS) - 1);
+				if (sparse_block_write(ctx, p, n >> SECTOR_BITS))
+					goto err;
+			} else {
+				if (n > CONFIG_EXT4_SPARSE_BUF_SIZE - ctx->buf_len)
+					n = CONFIG_EXT4_SPARSE_BUF_SIZE - ctx->buf_len;
+				memcpy(ctx->buf + ctx->buf_len, p, n);
+				ctx->buf_len += n;
+			}
+
+			p += n;
+			len -= n;
+			ctx->chunk_left -= n;
+
+			if (ctx->buf_len == CONFIG_EXT4_SPARSE_BUF_SIZE ||
+			    !ctx->chunk_left) {
+				if (sparse_flush(ctx))
+					goto err;
+			}
+			if (!ctx->chunk_left)
+				sparse_next_chunk(ctx);
 			break;
 
-		case EXT4_CHUNK_TYPE_FILL:
-			printf("*** fill_chunk ***\n");
-			sector_base += sector_size;
+		case EXT4_SPARSE_FILL:
+			if (sparse_gather(ctx, &p, &len)) {
+				memcpy(&ctx->fill, ctx->hdr, sizeof(ctx->fill));
+				if (sparse_fill(ctx))
+					goto err;
+				sparse_next_chunk(ctx);
+			}
 			break;
 
-		case EXT4_CHUNK_TYPE_NONE:
-			ext4_printf("none chunk \n");
-			sector_base += sector_size;
+		case EXT4_SPARSE_SKIP:
+			n = len < ctx->chunk_left ? len : ctx->chunk_left;
+			p += n;
+			len -= n;
+			ctx->chunk_left -= n;
+			if (!ctx->chunk_left)
+				sparse_next_chunk(ctx);
 			break;
 
-		default:
-			printf("*** unknown chunk type ***\n");
-			sector_base += sector_size;
+		case EXT4_SPARSE_DONE:
+			/* trailing padding of the download */
+			len = 0;
 			break;
+
+		default:
+			return -1;
 		}
-		total_chunks--;
-		ext4_printf("remain chunks = %d \n", total_chunks);
+	}
 
-		img_base += chunk_header->total_size;
-	};
+	/* chunks without payload complete without further data */
+	if (ctx->state == EXT4_SPARSE_SKIP && !ctx->chunk_left)
+		sparse_next_chunk(ctx);
+
+	/* the caller may reuse its buffer once we return */
+	if (ctx->inflight_user && sparse_wait(ctx))
+		goto err;
 
-	ext4_printf("write done \n");
 	return 0;
+
+err:
+	ctx->state = EXT4_SPARSE_ERROR;
+	return -1;
+}
+
+int ext4_sparse_finish(struct ext4_sparse_ctx *ctx)
+{
+	int ret = 0;
+
+	if (sparse_wait(ctx))
+		ctx->state = EXT4_SPARSE_ERROR;
+
+	if (ctx->state != EXT4_SPARSE_DONE) {
+		if (ctx->state != EXT4_SPARSE_ERROR)
+			printf("sparse: image truncated\n");
+		ret = -1;
+	}
+
+	free(ctx->bufs[0]);
+	free(ctx->bufs[1]);
+	ctx->buf = NULL;
+	ctx->bufs[0] = ctx->bufs[1] = NULL;
+
+	ext4_printf("write done \n");
+	return ret;
+}
+
+int write_compressed_ext4(char* img_base, unsigned int sector_base) {
+	struct ext4_sparse_ctx ctx;
+	ext4_file_header *file_header;
+	ext4_chunk_header *chunk_header;
+	block_dev_desc_t *dev;
+	unsigned int len;
+	int i;
+
+#if defined(CONFIG_HKDK4412)
+	dev = mmc_get_dev(GLOBAL_SYSTEM_PART);
+#else
+	dev = mmc_get_dev(0);
+#endif
+
+	/* the image is resident, so its length follows from the chunk list */
+	file_header = (ext4_file_header*)img_base;
+	len = file_header->file_header_size;
+	for (i = 0; i < file_header->total_chunks; i++) {
+		chunk_header = (ext4_chunk_header*)(img_base + len);
+		len += chunk_header->total_size;
+	}
+
+	if (ext4_sparse_init(&ctx, dev, sector_base, 0))
+		return -1;
+
+	ext4_sparse_write(&ctx, img_base, len);
+
+	return ext4_sparse_finish(&ctx);
 }
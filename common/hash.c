@@ -0,0 +1,176 @@
+/*
+ * Hash algorithm registry
+ *
+ * See file CREDITS for list of people who contributed to this
+ * project.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ */
+
+#include <common.h>
+#include <hash.h>
+#include <u-boot/crc.h>
+#ifdef CONFIG_MD5
+#include <u-boot/md5.h>
+#endif
+#ifdef CONFIG_SHA1
+#include <sha1.h>
+#endif
+#ifdef CONFIG_SHA256
+#include <sha256.h>
+#endif
+#ifdef CONFIG_ACE_HASH
+#include <asm/arch/ace_sha1.h>
+#endif
+
+/* Hardware drivers, most recently registered first */
+static struct hash_algo *hash_drivers;
+
+static int hash_crc32_ws(const unsigned char *input, unsigned int ilen,
+			unsigned char *output, unsigned int chunk_sz)
+{
+	uint32_t crc = crc32_wd(0, input, ilen, chunk_sz);
+
+	/* Stored big endian, as in image headers */
+	output[0] = crc >> 24;
+	output[1] = crc >> 16;
+	output[2] = crc >> 8;
+	output[3] = crc;
+	return 0;
+}
+
+#ifdef CONFIG_MD5
+static int hash_md5_ws(const unsigned char *input, unsigned int ilen,
+			unsigned char *output, unsigned int chunk_sz)
+{
+	md5_wd((unsigned char *)input, ilen, output, chunk_sz);
+	return 0;
+}
+#endif
+
+#ifdef CONFIG_SHA1
+static int hash_sha1_ws(const unsigned char *input, unsigned int ilen,
+			unsigned char *output, unsigned int chunk_sz)
+{
+	sha1_csum_wd((unsigned char *)input, ilen, output, chunk_sz);
+	return 0;
+}
+#endif
+
+#ifdef CONFIG_SHA256
+static int hash_sha256_ws(const unsigned char *input, unsigned int ilen,
+			unsigned char *output, unsigned int chunk_sz)
+{
+	sha256_csum_wd(input, ilen, output, chunk_sz);
+	return 0;
+}
+#endif
+
+static struct hash_algo hash_algos[] = {
+	{ "crc32", 4, 64 * 1024, hash_crc32_ws, },
+#ifdef CONFIG_MD5
+	{ "md5", 16, 64 * 1024, hash_md5_ws, },
+#endif
+#ifdef CONFIG_SHA1
+	{ "sha1", 20, 64 * 1024, hash_sha1_ws, },
+#endif
+#ifdef CONFIG_SHA256
+	{ "sha256", 32, 64 * 1024, hash_sha256_ws, },
+#endif
+};
+
+static struct hash_algo *hash_lookup_soft(const char *name)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(hash_algos); i++)
+		if (strcmp(hash_algos[i].name, name) == 0)
+			return &hash_algos[i];
+	return NULL;
+}
+
+/*
+ * Make a hardware implementation available. It takes precedence over
+ * the software one of the same name and any driver registered before.
+ */
+int hash_register(struct hash_algo *algo)
+{
+	if (algo->digest_size > HASH_MAX_DIGEST_SIZE)
+		return -1;
+
+	algo->next = hash_drivers;
+	hash_drivers = algo;
+	return 0;
+}
+
+struct hash_algo *hash_lookup_algo(const char *name)
+{
+	struct hash_algo *algo;
+
+	for (algo = hash_drivers; algo; algo = algo->next)
+		if (strcmp(algo->name, name) == 0)
+			return algo;
+	return hash_lookup_soft(name);
+}
+
+/*
+ * Whether a hardware driver handles this algorithm. Such a driver may
+ * only be used by one core at a time.
+ */
+int hash_has_driver(const char *name)
+{
+	struct hash_algo *algo;
+
+	for (algo = hash_drivers; algo; algo = algo->next)
+		if (strcmp(algo->name, name) == 0)
+			return 1;
+	return 0;
+}
+
+/*
+ * Hash len bytes at data with the named algorithm into output, which
+ * must have room for the digest (at most HASH_MAX_DIGEST_SIZE bytes).
+ * The digest length is returned in *output_size if it is not NULL.
+ * Returns 0 on success, -1 for an unknown algorithm.
+ */
+int hash_block(const char *name, const void *data, unsigned int len,
+		unsigned char *output, int *output_size)
+{
+	struct hash_algo *algo, *soft;
+
+	algo = hash_lookup_algo(name);
+	if (!algo)
+		return -1;
+
+	if (algo->hash_func_ws(data, len, output, algo->chunk_size)) {
+		soft = hash_lookup_soft(name);
+		if (!soft || soft == algo)
+			return -1;
+		debug("%s: %s driver failed, using software\n", __func__, name);
+		soft->hash_func_ws(data, len, output, soft->chunk_size);
+	}
+
+	if (output_size)
+		*output_size = algo->digest_size;
+	return 0;
+}
+
+void hash_init(void)
+{
+#ifdef CONFIG_ACE_HASH
+	ace_hash_init();
+#endif
+}
@@ -54,6 +54,13 @@
 #if defined(CONFIG_FIT)
 #include <u-boot/md5.h>
 #include <sha1.h>
+#include <sha256.h>
+#ifdef CONFIG_HASH
+#include <hash.h>
+#endif
+#ifdef CONFIG_SMP
+#include <smp.h>
+#endif
 
 static int fit_check_ramdisk (const void *fit, int os_noffset,
 		uint8_t arch, int verify);
@@ -70,6 +77,7 @@ static const image_header_t* image_get_ramdisk (ulong rd_addr, uint8_t arch,
 #else
 #include "mkimage.h"
 #include <u-boot/md5.h>
+#include <sha256.h>
 #include <time.h>
 #include <image.h>
 #endif /* !USE_HOSTCC*/
@@ -150,6 +158,7 @@ static table_entry_t uimage_comp[] = {
 	{	IH_COMP_GZIP,	"gzip",		"gzip compressed",	},
 	{	IH_COMP_LZMA,	"lzma",		"lzma compressed",	},
 	{	IH_COMP_LZO,	"lzo",		"lzo compressed",	},
+	{	IH_COMP_LZ4,	"lz4",		"lz4 compressed",	},
 	{	-1,		"",		"",			},
 };
 
@@ -2394,6 +2403,35 @@ int fit_set_timestamp (void *fit, int noffset, time_t timestamp)
 	return 0;
 }
 
+/*
+ * Software implementations only, these can run on any core.
+ */
+static int calculate_hash_sw (const void *data, int data_len,
+			const char *algo, uint8_t *value, int *value_len)
+{
+	if (strcmp (algo, "crc32") == 0 ) {
+		*((uint32_t *)value) = crc32_wd (0, data, data_len,
+							CHUNKSZ_CRC32);
+		*((uint32_t *)value) = cpu_to_uimage (*((uint32_t *)value));
+		*value_len = 4;
+	} else if (strcmp (algo, "sha1") == 0 ) {
+		sha1_csum_wd ((unsigned char *) data, data_len,
+				(unsigned char *) value, CHUNKSZ_SHA1);
+		*value_len = 20;
+	} else if (strcmp (algo, "md5") == 0 ) {
+		md5_wd ((unsigned char *)data, data_len, value, CHUNKSZ_MD5);
+		*value_len = 16;
+	} else if (strcmp (algo, "sha256") == 0 ) {
+		sha256_csum_wd ((unsigned char *) data, data_len,
+				(unsigned char *) value, CHUNKSZ_SHA256);
+		*value_len = SHA256_SUM_LEN;
+	} else {
+		debug ("Unsupported hash alogrithm\n");
+		return -1;
+	}
+	return 0;
+}
+
 /**
  * calculate_hash - calculate and return hash for provided input data
  * @data: pointer to the input data
@@ -2414,23 +2452,14 @@ int fit_set_timestamp (void *fit, int noffset, time_t timestamp)
 static int calculate_hash (const void *data, int data_len, const char *algo,
 			uint8_t *value, int *value_len)
 {
-	if (strcmp (algo, "crc32") == 0 ) {
-		*((uint32_t *)value) = crc32_wd (0, data, data_len,
-							CHUNKSZ_CRC32);
-		*((uint32_t *)value) = cpu_to_uimage (*((uint32_t *)value));
-		*value_len = 4;
-	} else if (strcmp (algo, "sha1") == 0 ) {
-		sha1_csum_wd ((unsigned char *) data, data_len,
-				(unsigned char *) value, CHUNKSZ_SHA1);
-		*value_len = 20;
-	} else if (strcmp (algo, "md5") == 0 ) {
-		md5_wd ((unsigned char *)data, data_len, value, CHUNKSZ_MD5);
-		*value_len = 16;
-	} else {
-		debug ("Unsupported hash alogrithm\n");
-		return -1;
-	}
-	return 0;
+#if !defined(USE_HOSTCC) && defined(CONFIG_HASH)
+	struct hash_algo *ha = hash_lookup_algo (algo);
+
+	/* Hardware engines when registered, software otherwise */
+	if (ha && ha->digest_size <= FIT_MAX_HASH_LEN)
+		return hash_block (algo, data, data_len, value, value_len);
+#endif
+	return calculate_hash_sw (data, data_len, algo, value, value_len);
 }
 
 #ifdef USE_HOSTCC
@@ -2604,6 +2633,214 @@ int fit_image_hash_set_value (void *fit, int noffset, uint8_t *value,
 }
 #endif /* USE_HOSTCC */
 
+#if !defined(USE_HOSTCC) && defined(CONFIG_SMP)
+/*
+ * Hashes computed ahead on the secondary cores, picked up by
+ * fit_image_check_hashes(). Algorithms with a hardware driver are left
+ * to the boot core, there is only one engine.
+ */
+#define FIT_HASH_JOBS	8
+
+struct fit_hash_job {
+	struct smp_job	job;
+	int		busy;
+	const void	*fit;
+	int		noffset;	/* hash node */
+	const void	*data;
+	size_t		size;
+	const char	*algo;
+	int		value_len;
+	uint8_t		value[FIT_MAX_HASH_LEN] __attribute__ ((aligned (4)));
+};
+
+static struct fit_hash_job fit_hash_jobs[FIT_HASH_JOBS];
+
+static int fit_hash_job_run (void *arg)
+{
+	struct fit_hash_job *hj = arg;
+
+	return calculate_hash_sw (hj->data, hj->size, hj->algo,
+			hj->value, &hj->value_len);
+}
+
+/**
+ * fit_image_hash_start - start computing image hashes on other cores
+ * @fit: pointer to the FIT format image header
+ * @image_noffset: component image node offset
+ *
+ * fit_image_hash_start() queues a job for every hash node of the image;
+ * a later fit_image_check_hashes() for the same image waits for the
+ * results instead of computing them. Hash nodes that do not fit in the
+ * job table are computed by fit_image_check_hashes() as usual.
+ *
+ * returns:
+ *     no returned results
+ */
+void fit_image_hash_start (const void *fit, int image_noffset)
+{
+	struct fit_hash_job *hj;
+	const void	*data;
+	size_t		size;
+	char		*algo;
+	int		noffset;
+	int		ndepth;
+	int		i;
+
+	if (fit_image_get_data (fit, image_noffset, &data, &size))
+		return;
+
+	for (ndepth = 0, noffset = fdt_next_node (fit, image_noffset, &ndepth);
+	     (noffset >= 0) && (ndepth > 0);
+	     noffset = fdt_next_node (fit, noffset, &ndepth)) {
+		if (ndepth != 1 ||
+		    strncmp (fit_get_name (fit, noffset, NULL),
+				FIT_HASH_NODENAME,
+				strlen (FIT_HASH_NODENAME)) != 0)
+			continue;
+
+		if (fit_image_hash_get_algo (fit, noffset, &algo))
+			continue;
+#ifdef CONFIG_HASH
+		if (hash_has_driver (algo))
+			continue;
+#endif
+
+		for (i = 0; i < FIT_HASH_JOBS; i++)
+			if (!fit_hash_jobs[i].busy)
+				break;
+		if (i == FIT_HASH_JOBS)
+			return;
+
+		hj = &fit_hash_jobs[i];
+		hj->busy = 1;
+		hj->fit = fit;
+		hj->noffset = noffset;
+		hj->data = data;
+		hj->size = size;
+		hj->algo = algo;
+		hj->job.func = fit_hash_job_run;
+		hj->job.arg = hj;
+		smp_job_start (&hj->job);
+	}
+}
+
+/*
+ * Get the memory bootm_load_os() may write when it loads the kernel
+ * image: its size if uncompressed, up to CONFIG_SYS_BOOTM_LEN otherwise.
+ */
+static int fit_image_load_area (const void *fit, int noffset,
+		ulong *start, ulong *end)
+{
+	const void	*data;
+	size_t		size;
+	uint8_t		comp;
+
+	if (fit_image_get_load (fit, noffset, start) ||
+	    fit_image_get_data (fit, noffset, &data, &size) ||
+	    fit_image_get_comp (fit, noffset, &comp))
+		return -1;
+
+	*end = *start + (comp == IH_COMP_NONE ? size : CONFIG_SYS_BOOTM_LEN);
+	return 0;
+}
+
+/**
+ * fit_conf_hash_start - start computing the hashes of a configuration
+ * @fit: pointer to the FIT format image header
+ * @noffset: configuration node offset
+ *
+ * fit_conf_hash_start() calls fit_image_hash_start() for the kernel,
+ * ramdisk and fdt images of the configuration, so that they are hashed
+ * side by side and while the kernel is loaded. The kernel hashes are
+ * collected before it is loaded. A ramdisk or fdt whose data lies where
+ * the kernel is loaded to is left alone: it is hashed after the load, as
+ * without CONFIG_SMP, so that the check sees the data actually used.
+ *
+ * returns:
+ *     no returned results
+ */
+void fit_conf_hash_start (const void *fit, int noffset)
+{
+	const void	*data;
+	size_t		size;
+	ulong		load_start, load_end;
+	int		image_noffset;
+	int		i;
+
+	image_noffset = fit_conf_get_kernel_node (fit, noffset);
+	if (image_noffset < 0)
+		return;
+	fit_image_hash_start (fit, image_noffset);
+	if (fit_image_load_area (fit, image_noffset, &load_start, &load_end))
+		return;
+
+	for (i = 0; i < 2; i++) {
+		if (i == 0)
+			image_noffset = fit_conf_get_ramdisk_node (fit, noffset);
+		else
+			image_noffset = fit_conf_get_fdt_node (fit, noffset);
+		if (image_noffset < 0 ||
+		    fit_image_get_data (fit, image_noffset, &data, &size))
+			continue;
+
+		if ((ulong)data < load_end && (ulong)data + size > load_start)
+			continue;
+		fit_image_hash_start (fit, image_noffset);
+	}
+}
+
+/**
+ * fit_image_hash_discard - drop hashes computed ahead
+ *
+ * fit_image_hash_discard() cancels all jobs started by
+ * fit_image_hash_start() that were not collected, so that their results
+ * can not be mistaken for those of a different image loaded later.
+ *
+ * returns:
+ *     no returned results
+ */
+void fit_image_hash_discard (void)
+{
+	int i;
+
+	for (i = 0; i < FIT_HASH_JOBS; i++) {
+		if (fit_hash_jobs[i].busy) {
+			smp_job_cancel (&fit_hash_jobs[i].job);
+			fit_hash_jobs[i].busy = 0;
+		}
+	}
+}
+
+/* Take the result of a job started for this hash node, if any */
+static int fit_image_hash_collect (const void *fit, int noffset,
+		const void *data, size_t size, const char *algo,
+		uint8_t *value, int *value_len)
+{
+	struct fit_hash_job *hj;
+	int ret;
+	int i;
+
+	for (i = 0; i < FIT_HASH_JOBS; i++) {
+		hj = &fit_hash_jobs[i];
+		if (hj->busy && hj->fit == fit && hj->noffset == noffset &&
+		    hj->data == data && hj->size == size &&
+		    strcmp (hj->algo, algo) == 0)
+			break;
+	}
+	if (i == FIT_HASH_JOBS)
+		return calculate_hash (data, size, algo, value, value_len);
+
+	ret = smp_job_wait (&hj->job);
+	hj->busy = 0;
+	if (ret)
+		return ret;
+
+	memcpy (value, hj->value, hj->value_len);
+	*value_len = hj->value_len;
+	return 0;
+}
+#endif /* !USE_HOSTCC && CONFIG_SMP */
+
 /**
  * fit_image_check_hashes - verify data intergity
  * @fit: pointer to the FIT format image header
@@ -2628,6 +2865,7 @@ int fit_image_check_hashes (const void *fit, int image_noffset)
 	int		value_len;
 	int		noffset;
 	int		ndepth;
+	int		ret;
 	char		*err_msg = "";
 
 	/* Get image data and data length */
@@ -2667,7 +2905,13 @@ int fit_image_check_hashes (const void *fit, int image_noffset)
 				goto error;
 			}
 
-			if (calculate_hash (data, size, algo, value, &value_len)) {
+#if !defined(USE_HOSTCC) && defined(CONFIG_SMP)
+			ret = fit_image_hash_collect (fit, noffset, data, size,
+					algo, value, &value_len);
+#else
+			ret = calculate_hash (data, size, algo, value, &value_len);
+#endif
+			if (ret) {
 				err_msg = " error!\nUnsupported hash algorithm";
 				goto error;
 			}
@@ -2709,6 +2953,7 @@ int fit_all_image_check_hashes (const void *fit)
 	int noffset;
 	int ndepth;
 	int count;
+	int ret;
 
 	/* Find images parent node offset */
 	images_noffset = fdt_path_offset (fit, FIT_IMAGES_PATH);
@@ -2718,10 +2963,20 @@ int fit_all_image_check_hashes (const void *fit)
 		return 0;
 	}
 
+#if !defined(USE_HOSTCC) && defined(CONFIG_SMP)
+	/* Hash all images side by side, collected in the loop below */
+	for (ndepth = 0, noffset = fdt_next_node (fit, images_noffset, &ndepth);
+		(noffset >= 0) && (ndepth > 0);
+		noffset = fdt_next_node (fit, noffset, &ndepth)) {
+		if (ndepth == 1)
+			fit_image_hash_start (fit, noffset);
+	}
+#endif
+
 	/* Process all image subnodes, check hashes for each */
 	printf ("## Checking hash(es) for FIT Image at %08lx ...\n",
 		(ulong)fit);
-	for (ndepth = 0, count = 0,
+	for (ndepth = 0, count = 0, ret = 1,
 		noffset = fdt_next_node (fit, images_noffset, &ndepth);
 		(noffset >= 0) && (ndepth > 0);
 		noffset = fdt_next_node (fit, noffset, &ndepth)) {
@@ -2733,12 +2988,17 @@ int fit_all_image_check_hashes (const void *fit)
 			printf ("   Hash(es) for Image %u (%s): ", count++,
 					fit_get_name (fit, noffset, NULL));
 
-			if (!fit_image_check_hashes (fit, noffset))
-				return 0;
+			if (!fit_image_check_hashes (fit, noffset)) {
+				ret = 0;
+				break;
+			}
 			printf ("\n");
 		}
 	}
-	return 1;
+#if !defined(USE_HOSTCC) && defined(CONFIG_SMP)
+	fit_image_hash_discard ();
+#endif
+	return ret;
 }
 
 /**
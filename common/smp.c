@@ -0,0 +1,280 @@
+/*
+ * Run jobs on secondary cores
+ *
+ * See file CREDITS for list of people who contributed to this
+ * project.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ */
+
+/*
+ * The boot core owns the job queue; each secondary core only looks at
+ * its own mailbox. A job is handed over by storing it in the mailbox
+ * and bumping 'req'; the secondary runs it, marks it done and copies
+ * 'req' to 'done'. With one writer per field no locking is needed,
+ * only barriers. The cores are started on the first job.
+ */
+
+#ifndef USE_HOSTCC
+#include <common.h>
+#include <malloc.h>
+#else
+#include "smp_test.h"
+#endif
+#include <smp.h>
+
+#ifndef CONFIG_SYS_NO_DCACHE
+#error "CONFIG_SMP: secondary cores run uncached, the boot core must too"
+#endif
+
+#define SMP_START_TIMEOUT	100	/* ms to wait for a core to come up */
+
+struct smp_mailbox {
+	struct smp_job * volatile job;
+	volatile u32 req;		/* written by the boot core */
+	volatile u32 done;		/* written by the secondary */
+	volatile int online;		/* written by the secondary */
+	volatile int park;		/* leave the job loop */
+};
+
+static struct smp_mailbox smp_mbox[CONFIG_SMP_NR_CPUS];
+static struct smp_job *smp_queue;
+static int smp_started;
+static int smp_online;
+
+void smp_secondary_loop(int cpu)
+{
+	struct smp_mailbox *mb = &smp_mbox[cpu];
+	struct smp_job *job;
+
+	mb->online = 1;
+	smp_arch_send_event();
+
+	for (;;) {
+		while (mb->req == mb->done)
+			smp_arch_wait_event();
+		smp_arch_barrier();
+
+		if (mb->park) {
+			mb->done = mb->req;
+			smp_arch_send_event();
+			smp_arch_park(cpu);
+		}
+
+		job = mb->job;
+		job->ret = job->func(job->arg);
+		smp_arch_barrier();
+		job->state = SMP_JOB_DONE;
+		mb->done = mb->req;
+		smp_arch_send_event();
+	}
+}
+
+static void smp_start_cpus(void)
+{
+	struct smp_mailbox *mb;
+	void *stack;
+	ulong start;
+	int cpu;
+
+	smp_started = 1;
+
+	for (cpu = 1; cpu < CONFIG_SMP_NR_CPUS; cpu++) {
+		mb = &smp_mbox[cpu];
+
+		stack = malloc(CONFIG_SMP_STACK_SIZE);
+		if (!stack)
+			break;
+
+		if (smp_arch_start(cpu, (ulong)stack + CONFIG_SMP_STACK_SIZE)) {
+			free(stack);
+			continue;
+		}
+
+		start = get_timer(0);
+		while (!mb->online) {
+			if (get_timer(start) > SMP_START_TIMEOUT)
+				break;
+		}
+		if (!mb->online) {
+			/* the stack stays allocated in case it wakes up late */
+			debug("smp: cpu%d did not come up\n", cpu);
+			continue;
+		}
+		smp_online++;
+	}
+	debug("smp: %d secondary cores online\n", smp_online);
+}
+
+static int smp_idle_cpu(void)
+{
+	struct smp_mailbox *mb;
+	int cpu;
+
+	for (cpu = 1; cpu < CONFIG_SMP_NR_CPUS; cpu++) {
+		mb = &smp_mbox[cpu];
+		if (mb->online && !mb->park && mb->req == mb->done)
+			return cpu;
+	}
+	return 0;
+}
+
+/* Hand queued jobs to idle cores */
+static void smp_dispatch(void)
+{
+	struct smp_mailbox *mb;
+	struct smp_job *job;
+	int cpu;
+
+	while (smp_queue && (cpu = smp_idle_cpu()) != 0) {
+		mb = &smp_mbox[cpu];
+		job = smp_queue;
+		smp_queue = job->next;
+
+		job->state = SMP_JOB_RUNNING;
+		job->cpu = cpu;
+		mb->job = job;
+		smp_arch_barrier();
+		mb->req++;
+		smp_arch_send_event();
+	}
+}
+
+static void smp_run_here(struct smp_job *job)
+{
+	job->state = SMP_JOB_RUNNING;
+	job->cpu = 0;
+	job->ret = job->func(job->arg);
+	job->state = SMP_JOB_DONE;
+}
+
+static void smp_dequeue(struct smp_job *job)
+{
+	struct smp_job **p;
+
+	for (p = &smp_queue; *p; p = &(*p)->next) {
+		if (*p == job) {
+			*p = job->next;
+			break;
+		}
+	}
+}
+
+/*
+ * Queue a job and start it on an idle secondary core if there is one.
+ * Otherwise it waits in the queue until a core frees up or until
+ * smp_job_wait() runs it on the boot core.
+ */
+int smp_job_start(struct smp_job *job)
+{
+	struct smp_job **p;
+
+	if (!smp_started)
+		smp_start_cpus();
+
+	job->state = SMP_JOB_QUEUED;
+	job->next = NULL;
+	for (p = &smp_queue; *p; p = &(*p)->next)
+		;
+	*p = job;
+
+	smp_dispatch();
+	return 0;
+}
+
+/*
+ * Wait for a job and return its result. A job nobody has picked up yet
+ * is run right here; while waiting for one that runs elsewhere the boot
+ * core works through the rest of the queue.
+ */
+int smp_job_wait(struct smp_job *job)
+{
+	struct smp_job *other;
+
+	for (;;) {
+		smp_dispatch();
+
+		switch (job->state) {
+		case SMP_JOB_IDLE:
+			return -1;
+		case SMP_JOB_DONE:
+			smp_arch_barrier();
+			return job->ret;
+		case SMP_JOB_QUEUED:
+			smp_dequeue(job);
+			smp_run_here(job);
+			return job->ret;
+		}
+
+		if (smp_queue) {
+			other = smp_queue;
+			smp_queue = other->next;
+			smp_run_here(other);
+			continue;
+		}
+
+		smp_arch_wait_event();
+	}
+}
+
+/*
+ * Drop a job nobody has picked up yet; one already running is waited
+ * for. Either way the job is no longer referenced afterwards.
+ */
+void smp_job_cancel(struct smp_job *job)
+{
+	if (job->state == SMP_JOB_QUEUED) {
+		smp_dequeue(job);
+		job->state = SMP_JOB_IDLE;
+		return;
+	}
+	if (job->state == SMP_JOB_RUNNING)
+		smp_job_wait(job);
+}
+
+int smp_cpus_online(void)
+{
+	return 1 + smp_online;
+}
+
+/*
+ * Send the secondary cores back to where the OS expects to find them.
+ * Jobs still queued run on the boot core when they are waited for.
+ */
+void smp_shutdown(void)
+{
+	struct smp_mailbox *mb;
+	int cpu;
+
+	for (cpu = 1; cpu < CONFIG_SMP_NR_CPUS; cpu++) {
+		mb = &smp_mbox[cpu];
+		if (!mb->online)
+			continue;
+
+		while (mb->req != mb->done)
+			smp_arch_wait_event();
+
+		mb->park = 1;
+		smp_arch_barrier();
+		mb->req++;
+		smp_arch_send_event();
+
+		while (mb->req != mb->done)
+			smp_arch_wait_event();
+		mb->online = 0;
+		smp_online--;
+	}
+}
@@ -38,6 +38,7 @@
 
 #include <part.h>
 #include <usb.h>
+#include <blkcache.h>
 
 #undef BBB_COMDAT_TRACE
 #undef BBB_XPORT_TRACE
@@ -129,6 +130,8 @@ struct us_data {
 	ccb		*srb;			/* current srb */
 	trans_reset	transport_reset;	/* reset routine */
 	trans_cmnd	transport;		/* transport routine */
+	unsigned int	max_xfer;		/* bytes per READ/WRITE(10) */
+	unsigned long	xfer_err;		/* bulk status of a broken transfer */
 };
 
 #ifdef CONFIG_USB_EHCI
@@ -142,8 +145,47 @@ struct us_data {
 #define USB_MAX_XFER_BLK	20
 #endif
 
+/*
+ * Bytes moved per READ(10)/WRITE(10), on top of USB_MAX_XFER_BLK. Some
+ * sticks and USB-SATA bridges break on commands longer than they can
+ * buffer; the limit of such a device is halved on every transfer that
+ * fails with one of USB_STOR_SHRINK_ERR, down to USB_MIN_XFER_BYTES.
+ */
+#ifndef CONFIG_USB_STOR_MAX_XFER
+#define CONFIG_USB_STOR_MAX_XFER	0xffffffff	/* no byte limit */
+#endif
+#define USB_MIN_XFER_BYTES		(64 << 10)
+#define USB_STOR_SHRINK_ERR		(USB_ST_BUF_ERR | USB_ST_BABBLE_DET | \
+					 USB_ST_CRC_ERR | USB_ST_BIT_ERR)
+
 static struct us_data usb_stor[USB_MAX_STOR_DEV];
 
+#ifdef CONFIG_USB_STOR_READAHEAD
+/*
+ * Blocks read ahead of a sequential reader, so that a loader going
+ * through a file in small pieces issues one READ(10) per window rather
+ * than one per piece. There is a single window, owned by the device
+ * read last.
+ */
+static struct {
+	int device;
+	lbaint_t start;		/* first block in the window */
+	lbaint_t blkcnt;	/* blocks in the window, 0 if empty */
+	lbaint_t next;		/* block following the last read */
+} usb_ra;
+
+static unsigned char usb_ra_buf[CONFIG_USB_STOR_READAHEAD]
+	__aligned(ARCH_DMA_MINALIGN);
+
+static void usb_stor_ra_invalidate(int device)
+{
+	if (usb_ra.device == device)
+		usb_ra.blkcnt = 0;
+}
+#else
+static inline void usb_stor_ra_invalidate(int device) {}
+#endif
+
 
 #define USB_STOR_TRANSPORT_GOOD	   0
 #define USB_STOR_TRANSPORT_FAILED -1
@@ -223,6 +265,8 @@ int usb_stor_scan(int mode)
 	usb_disable_asynch(1); /* asynch transfer not allowed */
 
 	for (i = 0; i < USB_MAX_STOR_DEV; i++) {
+		blkcache_invalidate(IF_TYPE_USB, i);
+		usb_stor_ra_invalidate(i);
 		memset(&usb_dev_desc[i], 0, sizeof(block_dev_desc_t));
 		usb_dev_desc[i].if_type = IF_TYPE_USB;
 		usb_dev_desc[i].dev = i;
@@ -664,6 +708,7 @@ static int usb_stor_BBB_transport(ccb *srb, struct us_data *us)
 #endif
 
 	dir_in = US_DIRECTION(srb->cmd[0]);
+	us->xfer_err = 0;
 
 	/* COMMAND phase */
 	debug("COMMAND phase\n");
@@ -703,6 +748,7 @@ static int usb_stor_BBB_transport(ccb *srb, struct us_data *us)
 	if (result < 0) {
 		debug("usb_bulk_msg error status %ld\n",
 		      us->pusb_dev->status);
+		us->xfer_err = us->pusb_dev->status;
 		usb_stor_BBB_reset(us);
 		return USB_STOR_TRANSPORT_FAILED;
 	}
@@ -732,6 +778,7 @@ again:
 	if (result < 0) {
 		debug("usb_bulk_msg error status %ld\n",
 		      us->pusb_dev->status);
+		us->xfer_err = us->pusb_dev->status;
 		usb_stor_BBB_reset(us);
 		return USB_STOR_TRANSPORT_FAILED;
 	}
@@ -1037,58 +1084,65 @@ static void usb_bin_fixup(struct usb_device_descriptor descriptor,
 }
 #endif /* CONFIG_USB_BIN_FIXUP */
 
-unsigned long usb_stor_read(int device, lbaint_t blknr,
-			    lbaint_t blkcnt, void *buffer)
+/* Blocks moved per READ(10)/WRITE(10) on device */
+static unsigned short usb_stor_xfer_blks(struct us_data *ss, int device)
 {
-	lbaint_t start, blks;
-	uintptr_t buf_addr;
-	unsigned short smallblks;
-	struct usb_device *dev;
-	struct us_data *ss;
-	int retry, i;
-	ccb *srb = &usb_ccb;
+	unsigned long blks = ss->max_xfer >> usb_dev_desc[device].log2blksz;
 
-	if (blkcnt == 0)
-		return 0;
+	if (blks > USB_MAX_XFER_BLK)
+		blks = USB_MAX_XFER_BLK;
+	return blks ? blks : 1;
+}
 
-	device &= 0xff;
-	/* Setup  device */
-	debug("\nusb_read: dev %d \n", device);
-	dev = NULL;
-	for (i = 0; i < USB_MAX_DEVICE; i++) {
-		dev = usb_get_dev_index(i);
-		if (dev == NULL)
-			return 0;
-		if (dev->devnum == usb_dev_desc[device].target)
-			break;
-	}
-	ss = (struct us_data *)dev->privptr;
+/*
+ * Called after a READ(10)/WRITE(10) of len bytes failed. If the bulk
+ * transfer itself broke, rather than the device reporting an error for
+ * the command, halves the transfer size of the device if the command was
+ * longer than USB_MIN_XFER_BYTES, so that it is retried in smaller pieces.
+ * Returns 1 if the size was reduced, 0 otherwise.
+ */
+static int usb_stor_shrink_xfer(struct us_data *ss, unsigned long len)
+{
+	if (!(ss->xfer_err & USB_STOR_SHRINK_ERR) || len <= USB_MIN_XFER_BYTES)
+		return 0;
 
-	usb_disable_asynch(1); /* asynch transfer not allowed */
-	srb->lun = usb_dev_desc[device].lun;
-	buf_addr = (unsigned long)buffer;
-	start = blknr;
-	blks = blkcnt;
+	ss->max_xfer = max(len / 2, (unsigned long)USB_MIN_XFER_BYTES);
+	debug("usb: transfers limited to %u bytes\n", ss->max_xfer);
+	return 1;
+}
 
-	debug("\nusb_read: dev %d startblk " LBAF ", blccnt " LBAF
-	      " buffer %lx\n", device, start, blks, buf_addr);
+/*
+ * Reads blks blocks from device to buffer.
+ * Returns the number of blocks read before an error.
+ */
+static lbaint_t usb_stor_read_blks(int device, struct us_data *ss,
+				   lbaint_t start, lbaint_t blks, void *buffer)
+{
+	uintptr_t buf_addr = (uintptr_t)buffer;
+	lbaint_t blkcnt = blks;
+	unsigned short smallblks;
+	int retry, shrink;
+	ccb *srb = &usb_ccb;
 
 	do {
 		/* XXX need some comment here */
 		retry = 2;
-		srb->pdata = (unsigned char *)buf_addr;
-		if (blks > USB_MAX_XFER_BLK)
-			smallblks = USB_MAX_XFER_BLK;
-		else
-			smallblks = (unsigned short) blks;
 retry_it:
+		smallblks = usb_stor_xfer_blks(ss, device);
+		if (blks < smallblks)
+			smallblks = (unsigned short) blks;
 		if (smallblks == USB_MAX_XFER_BLK)
 			usb_show_progress();
 		srb->datalen = usb_dev_desc[device].blksz * smallblks;
 		srb->pdata = (unsigned char *)buf_addr;
 		if (usb_read_10(srb, ss, start, smallblks)) {
 			debug("Read ERROR\n");
+			/* before REQUEST SENSE overwrites the status */
+			shrink = usb_stor_shrink_xfer(ss,
+					usb_dev_desc[device].blksz * smallblks);
 			usb_request_sense(srb, ss);
+			if (shrink)
+				goto retry_it;
 			if (retry--)
 				goto retry_it;
 			blkcnt -= blks;
@@ -1104,10 +1158,106 @@ retry_it:
 	      ", blccnt %x buffer %lx\n",
 	      start, smallblks, buf_addr);
 
+	return blkcnt;
+}
+
+#ifdef CONFIG_USB_STOR_READAHEAD
+static lbaint_t usb_stor_readahead(int device, struct us_data *ss,
+				   lbaint_t blknr, lbaint_t blkcnt,
+				   void *buffer)
+{
+	unsigned long blksz = usb_dev_desc[device].blksz;
+	lbaint_t lba = usb_dev_desc[device].lba;
+	lbaint_t n, done = 0;
+	int seq;
+
+	if (usb_ra.device != device) {
+		usb_ra.device = device;
+		usb_ra.blkcnt = 0;
+		usb_ra.next = 0;
+	}
+
+	/* Take what the window already holds */
+	if (blknr >= usb_ra.start && blknr < usb_ra.start + usb_ra.blkcnt) {
+		n = min(blkcnt, usb_ra.start + usb_ra.blkcnt - blknr);
+		memcpy(buffer, usb_ra_buf + (blknr - usb_ra.start) * blksz,
+		       n * blksz);
+		done = n;
+		blknr += n;
+		blkcnt -= n;
+		buffer += n * blksz;
+		seq = 1;
+	} else {
+		seq = blknr == usb_ra.next;
+	}
+	usb_ra.next = blknr + blkcnt;
+	if (!blkcnt)
+		return done;
+
+	/* Read a whole window, but not past the end of the device */
+	n = sizeof(usb_ra_buf) >> usb_dev_desc[device].log2blksz;
+	n = blknr < lba ? min(n, lba - blknr) : 0;
+	if (!seq || blkcnt >= n)
+		return done + usb_stor_read_blks(device, ss, blknr, blkcnt,
+						 buffer);
+
+	usb_ra.start = blknr;
+	usb_ra.blkcnt = usb_stor_read_blks(device, ss, blknr, n, usb_ra_buf);
+	n = min(blkcnt, usb_ra.blkcnt);
+	memcpy(buffer, usb_ra_buf, n * blksz);
+	return done + n;
+}
+#endif /* CONFIG_USB_STOR_READAHEAD */
+
+unsigned long usb_stor_read(int device, lbaint_t blknr,
+			    lbaint_t blkcnt, void *buffer)
+{
+	struct usb_device *dev;
+	struct us_data *ss;
+	lbaint_t done;
+	int i;
+	ccb *srb = &usb_ccb;
+
+	if (blkcnt == 0)
+		return 0;
+
+	device &= 0xff;
+
+	if (blkcache_read(IF_TYPE_USB, device, blknr, blkcnt,
+			  usb_dev_desc[device].blksz, buffer))
+		return blkcnt;
+
+	/* Setup  device */
+	debug("\nusb_read: dev %d \n", device);
+	dev = NULL;
+	for (i = 0; i < USB_MAX_DEVICE; i++) {
+		dev = usb_get_dev_index(i);
+		if (dev == NULL)
+			return 0;
+		if (dev->devnum == usb_dev_desc[device].target)
+			break;
+	}
+	ss = (struct us_data *)dev->privptr;
+
+	usb_disable_asynch(1); /* asynch transfer not allowed */
+	srb->lun = usb_dev_desc[device].lun;
+
+	debug("\nusb_read: dev %d startblk " LBAF ", blccnt " LBAF
+	      " buffer %lx\n", device, blknr, blkcnt, (ulong)buffer);
+
+#ifdef CONFIG_USB_STOR_READAHEAD
+	done = usb_stor_readahead(device, ss, blknr, blkcnt, buffer);
+#else
+	done = usb_stor_read_blks(device, ss, blknr, blkcnt, buffer);
+#endif
+
 	usb_disable_asynch(0); /* asynch transfer allowed */
 	if (blkcnt >= USB_MAX_XFER_BLK)
 		debug("\n");
-	return blkcnt;
+	if (done == blkcnt)
+		blkcache_fill(IF_TYPE_USB, device, blknr, blkcnt,
+			      usb_dev_desc[device].blksz, buffer);
+	return done;
 }
 
 unsigned long usb_stor_write(int device, lbaint_t blknr,
@@ -1118,13 +1268,17 @@ unsigned long usb_stor_write(int device, lbaint_t blknr,
 	unsigned short smallblks;
 	struct usb_device *dev;
 	struct us_data *ss;
-	int retry, i;
+	int retry, shrink, i;
 	ccb *srb = &usb_ccb;
 
 	if (blkcnt == 0)
 		return 0;
 
 	device &= 0xff;
+
+	blkcache_invalidate(IF_TYPE_USB, device);
+	usb_stor_ra_invalidate(device);
+
 	/* Setup  device */
 	debug("\nusb_write: dev %d \n", device);
 	dev = NULL;
@@ -1152,19 +1306,22 @@ unsigned long usb_stor_write(int device, lbaint_t blknr,
 		 * return with number of blocks written successfully.
 		 */
 		retry = 2;
-		srb->pdata = (unsigned char *)buf_addr;
-		if (blks > USB_MAX_XFER_BLK)
-			smallblks = USB_MAX_XFER_BLK;
-		else
-			smallblks = (unsigned short) blks;
 retry_it:
+		smallblks = usb_stor_xfer_blks(ss, device);
+		if (blks < smallblks)
+			smallblks = (unsigned short) blks;
 		if (smallblks == USB_MAX_XFER_BLK)
 			usb_show_progress();
 		srb->datalen = usb_dev_desc[device].blksz * smallblks;
 		srb->pdata = (unsigned char *)buf_addr;
 		if (usb_write_10(srb, ss, start, smallblks)) {
 			debug("Write ERROR\n");
+			/* before REQUEST SENSE overwrites the status */
+			shrink = usb_stor_shrink_xfer(ss,
+					usb_dev_desc[device].blksz * smallblks);
 			usb_request_sense(srb, ss);
+			if (shrink)
+				goto retry_it;
 			if (retry--)
 				goto retry_it;
 			blkcnt -= blks;
@@ -1370,6 +1527,7 @@ int usb_stor_get_info(struct usb_device *dev, struct us_data *ss,
 #endif /* CONFIG_USB_BIN_FIXUP */
 	debug("ISO Vers %X, Response Data %X\n", usb_stor_buf[2],
 	      usb_stor_buf[3]);
+	ss->max_xfer = CONFIG_USB_STOR_MAX_XFER;
 	if (usb_test_unit_ready(pccb, ss)) {
 		printf("Device NOT ready\n"
 		       "   Request Sense returned %02X %02X %02X\n",
@@ -0,0 +1,183 @@
+/*
+ * Block device read cache
+ *
+ * A small LRU list of recent block reads, shared by all mmc, usb and
+ * sata devices. It pays off for the partition table, superblock and
+ * FAT sectors that are read again and again while file systems are
+ * probed. Writes go to the device and drop the device's cache entries.
+ *
+ * See file CREDITS for list of people who contributed to this
+ * project.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ */
+
+#include <common.h>
+#include <malloc.h>
+#include <part.h>
+#include <blkcache.h>
+#include <linux/list.h>
+
+struct block_cache_node {
+	struct list_head lh;
+	int iftype;
+	int dev;
+	lbaint_t start;
+	lbaint_t blkcnt;
+	unsigned long blksz;
+	char *cache;
+};
+
+/* most recently used entry first */
+static LIST_HEAD(block_cache);
+
+static struct block_cache_stats _stats = {
+	.max_blocks_per_entry = CONFIG_BLOCK_CACHE_MAX_BLOCKS,
+	.max_entries = CONFIG_BLOCK_CACHE_MAX_ENTRIES,
+};
+
+static struct block_cache_node *cache_find(int iftype, int dev,
+					   lbaint_t start, lbaint_t blkcnt,
+					   unsigned long blksz)
+{
+	struct block_cache_node *node;
+
+	list_for_each_entry(node, &block_cache, lh) {
+		if (node->iftype == iftype && node->dev == dev &&
+		    node->blksz == blksz && node->start <= start &&
+		    node->start + node->blkcnt >= start + blkcnt) {
+			if (block_cache.next != &node->lh) {
+				/* keep the list in MRU order */
+				list_del(&node->lh);
+				list_add(&node->lh, &block_cache);
+			}
+			return node;
+		}
+	}
+
+	return NULL;
+}
+
+int blkcache_read(int iftype, int dev, lbaint_t start, lbaint_t blkcnt,
+		  unsigned long blksz, void *buffer)
+{
+	struct block_cache_node *node;
+
+	node = cache_find(iftype, dev, start, blkcnt, blksz);
+	if (node) {
+		memcpy(buffer, node->cache + (start - node->start) * blksz,
+		       blkcnt * blksz);
+		debug("blkcache hit: start " LBAF ", count " LBAF "\n",
+		      start, blkcnt);
+		++_stats.hits;
+		return 1;
+	}
+
+	debug("blkcache miss: start " LBAF ", count " LBAF "\n",
+	      start, blkcnt);
+	++_stats.misses;
+	return 0;
+}
+
+void blkcache_fill(int iftype, int dev, lbaint_t start, lbaint_t blkcnt,
+		   unsigned long blksz, const void *buffer)
+{
+	struct block_cache_node *node;
+	lbaint_t bytes = blkcnt * blksz;
+
+	if (!blkcnt || blkcnt > _stats.max_blocks_per_entry ||
+	    !_stats.max_entries)
+		return;
+
+	if (_stats.entries >= _stats.max_entries) {
+		/* recycle the least recently used entry */
+		node = list_entry(block_cache.prev, struct block_cache_node, lh);
+		list_del(&node->lh);
+		_stats.entries--;
+		if (node->blkcnt * node->blksz < bytes) {
+			free(node->cache);
+			node->cache = NULL;
+		}
+	} else {
+		node = malloc(sizeof(*node));
+		if (!node)
+			return;
+		node->cache = NULL;
+	}
+
+	if (!node->cache) {
+		node->cache = malloc(bytes);
+		if (!node->cache) {
+			free(node);
+			return;
+		}
+	}
+
+	node->iftype = iftype;
+	node->dev = dev;
+	node->start = start;
+	node->blkcnt = blkcnt;
+	node->blksz = blksz;
+	memcpy(node->cache, buffer, bytes);
+	list_add(&node->lh, &block_cache);
+	_stats.entries++;
+}
+
+void blkcache_invalidate(int iftype, int dev)
+{
+	struct list_head *entry, *n;
+	struct block_cache_node *node;
+
+	list_for_each_safe(entry, n, &block_cache) {
+		node = list_entry(entry, struct block_cache_node, lh);
+		if (node->iftype == iftype && node->dev == dev) {
+			list_del(entry);
+			free(node->cache);
+			free(node);
+			_stats.entries--;
+		}
+	}
+}
+
+void blkcache_configure(unsigned blocks, unsigned entries)
+{
+	struct block_cache_node *node;
+
+	if (blocks != _stats.max_blocks_per_entry ||
+	    entries != _stats.max_entries) {
+		while (!list_empty(&block_cache)) {
+			node = list_entry(block_cache.next,
+					  struct block_cache_node, lh);
+			list_del(&node->lh);
+			free(node->cache);
+			free(node);
+		}
+		_stats.entries = 0;
+	}
+
+	_stats.max_blocks_per_entry = blocks;
+	_stats.max_entries = entries;
+
+	_stats.hits = 0;
+	_stats.misses = 0;
+}
+
+void blkcache_stats(struct block_cache_stats *stats)
+{
+	memcpy(stats, &_stats, sizeof(*stats));
+	_stats.hits = 0;
+	_stats.misses = 0;
+}
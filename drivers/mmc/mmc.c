@@ -32,6 +32,7 @@
 #include <linux/list.h>
 #include <mmc.h>
 #include <div64.h>
+#include <blkcache.h>
 
 #if defined(CONFIG_S5P6450)
 DECLARE_GLOBAL_DATA_PTR;
@@ -63,8 +64,14 @@ int __board_mmc_getcd(u8 *cd, struct mmc *mmc) {
 int board_mmc_getcd(u8 *cd, struct mmc *mmc)__attribute__((weak,
 	alias("__board_mmc_getcd")));
 
+static void mmc_async_sync(struct mmc *mmc);
+
 int mmc_send_cmd(struct mmc *mmc, struct mmc_cmd *cmd, struct mmc_data *data)
 {
+	/* nothing may go out on the bus while a data phase is running */
+	if (mmc->async.inflight)
+		mmc_async_sync(mmc);
+
 	return mmc->send_cmd(mmc, cmd, data);
 }
 
@@ -97,18 +104,48 @@ struct mmc *find_mmc_device(int dev_num)
 	return NULL;
 }
 
+static int mmc_set_blockcount(struct mmc *mmc, lbaint_t blkcnt)
+{
+	struct mmc_cmd cmd;
+
+	cmd.cmdidx = MMC_CMD_SET_BLOCK_COUNT;
+	cmd.resp_type = MMC_RSP_R1;
+	cmd.cmdarg = blkcnt & 0xffff;
+	cmd.flags = 0;
+
+	return mmc_send_cmd(mmc, &cmd, NULL);
+}
+
+/*
+ * Send a read/write command. Multi block transfers are announced with
+ * SET_BLOCK_COUNT when card and host support it, so the card stops by
+ * itself and the host must not issue an automatic STOP_TRANSMISSION.
+ */
+static int mmc_send_rw(struct mmc *mmc, struct mmc_cmd *cmd,
+		       struct mmc_data *data)
+{
+	int err;
+
+	data->flags &= ~MMC_DATA_SBC;
+
+	if (data->blocks > 1 && (mmc->card_caps & MMC_MODE_SBC)) {
+		err = mmc_set_blockcount(mmc, data->blocks);
+		if (err)
+			return err;
+		data->flags |= MMC_DATA_SBC;
+	}
+
+	return mmc_send_cmd(mmc, cmd, data);
+}
+
 static ulong
-mmc_bwrite(int dev_num, ulong start, lbaint_t blkcnt, const void*src)
+mmc_write_blocks(struct mmc *mmc, ulong start, lbaint_t blkcnt, const void*src)
 {
 	struct mmc_cmd cmd;
 	struct mmc_data data;
 	int err;
-	struct mmc *mmc = find_mmc_device(dev_num);
 	int blklen;
 
-	if (!mmc)
-		return -1;
-
 	int count=1;
 	int timeout_c = 100;
 	int timeout_d = 100;
@@ -133,7 +170,7 @@ mmc_bwrite(int dev_num, ulong start, lbaint_t blkcnt, const void*src)
 	data.blocksize = (1<<9);
 	data.flags = MMC_DATA_WRITE;
 
-	err = mmc_send_cmd(mmc, &cmd, &data);
+	err = mmc_send_rw(mmc, &cmd, &data);
 
 	if (err) {
 
@@ -167,7 +204,7 @@ if (strncmp(mmc->name, "S5P_MSHC", 8) != 0) {
 
 			udelay(1000);
 
-			err = mmc_send_cmd(mmc, &cmd, &data);
+			err = mmc_send_rw(mmc, &cmd, &data);
 
 			/* If No error */
 			if (!err)
@@ -191,6 +228,33 @@ if (strncmp(mmc->name, "S5P_MSHC", 8) != 0) {
 	return blkcnt;
 }
 
+static ulong
+mmc_bwrite(int dev_num, ulong start, lbaint_t blkcnt, const void*src)
+{
+	struct mmc *mmc = find_mmc_device(dev_num);
+	lbaint_t cur, blocks_todo = blkcnt;
+	const char *buf = src;
+	ulong ret;
+
+	if (!mmc)
+		return -1;
+
+	blkcache_invalidate(IF_TYPE_MMC, dev_num);
+
+	/* split the request at the host's transfer limit */
+	while (blocks_todo > 0) {
+		cur = (blocks_todo > mmc->b_max) ? mmc->b_max : blocks_todo;
+		ret = mmc_write_blocks(mmc, start, cur, buf);
+		if (ret != cur)
+			return ret;
+		blocks_todo -= cur;
+		start += cur;
+		buf += cur * mmc->write_bl_len;
+	}
+
+	return blkcnt;
+}
+
 int mmc_read_block(struct mmc *mmc, void *dst, uint blocknum)
 {
 	struct mmc_cmd cmd;
@@ -260,19 +324,16 @@ free_buffer:
 	return err;
 }
 
-static ulong mmc_bread(int dev_num, ulong start, lbaint_t blkcnt, void *dst)
+static ulong
+mmc_read_blocks(struct mmc *mmc, ulong start, lbaint_t blkcnt, void *dst)
 {
 	int err;
 	struct mmc_cmd cmd;
 	struct mmc_data data;
-	struct mmc *mmc = find_mmc_device(dev_num);
 	int count = 1;
 	int timeout_c = 100;
 	int timeout_d = 100;
 
-	if (!mmc)
-		return 0;
-
 	if (blkcnt > 1)
 		cmd.cmdidx = MMC_CMD_READ_MULTIPLE_BLOCK;
 	else
@@ -291,7 +352,7 @@ static ulong mmc_bread(int dev_num, ulong start, lbaint_t blkcnt, void *dst)
 	data.blocksize = (1<<9);
 	data.flags = MMC_DATA_READ;
 
-	err = mmc_send_cmd(mmc, &cmd, &data);
+	err = mmc_send_rw(mmc, &cmd, &data);
 	if (err) {
 
 if (strncmp(mmc->name, "S5P_MSHC", 8) != 0) {
@@ -320,7 +381,7 @@ if (strncmp(mmc->name, "S5P_MSHC", 8) != 0) {
 				udelay(1000);
 			}
 
-			err = mmc_send_cmd(mmc, &cmd, &data);
+			err = mmc_send_rw(mmc, &cmd, &data);
 
 			/* If No error */
 			if (!err)
@@ -344,6 +405,187 @@ if (strncmp(mmc->name, "S5P_MSHC", 8) != 0) {
 	return blkcnt;
 }
 
+static ulong mmc_bread(int dev_num, ulong start, lbaint_t blkcnt, void *dst)
+{
+	struct mmc *mmc = find_mmc_device(dev_num);
+	lbaint_t cur, blocks_todo = blkcnt;
+	ulong ret;
+	ulong blk = start;
+	char *buf = dst;
+
+	if (!mmc)
+		return 0;
+
+	if (blkcache_read(IF_TYPE_MMC, dev_num, start, blkcnt,
+			  mmc->read_bl_len, dst))
+		return blkcnt;
+
+	/* split the request at the host's transfer limit */
+	while (blocks_todo > 0) {
+		cur = (blocks_todo > mmc->b_max) ? mmc->b_max : blocks_todo;
+		ret = mmc_read_blocks(mmc, blk, cur, buf);
+		if (ret != cur)
+			return ret;
+		blocks_todo -= cur;
+		blk += cur;
+		buf += cur * mmc->read_bl_len;
+	}
+
+	blkcache_fill(IF_TYPE_MMC, dev_num, start, blkcnt,
+		      mmc->read_bl_len, dst);
+
+	return blkcnt;
+}
+
+/*
+ * Split transfers: mmc_bread_start/mmc_bwrite_start queue the first
+ * chunk and return while the host moves the data, mmc_xfer_done reaps
+ * it and queues the following chunks. Only one transfer per device is
+ * outstanding; starting another one waits for the previous.
+ */
+static void mmc_async_sync(struct mmc *mmc)
+{
+	struct mmc_async *a = &mmc->async;
+
+	a->err = mmc->data_done(mmc, 1);
+	a->inflight = 0;
+}
+
+static inline uint mmc_async_bl_len(struct mmc *mmc)
+{
+	return mmc->async.write ? mmc->write_bl_len : mmc->read_bl_len;
+}
+
+static void mmc_async_submit(struct mmc *mmc)
+{
+	struct mmc_async *a = &mmc->async;
+	struct mmc_cmd *cmd = &a->cmd;
+	struct mmc_data *data = &a->data;
+
+	a->cur = (a->left > mmc->b_max) ? mmc->b_max : a->left;
+
+	if (a->write)
+		cmd->cmdidx = (a->cur > 1) ? MMC_CMD_WRITE_MULTIPLE_BLOCK :
+					     MMC_CMD_WRITE_SINGLE_BLOCK;
+	else
+		cmd->cmdidx = (a->cur > 1) ? MMC_CMD_READ_MULTIPLE_BLOCK :
+					     MMC_CMD_READ_SINGLE_BLOCK;
+
+	if (mmc->high_capacity)
+		cmd->cmdarg = a->start;
+	else
+		cmd->cmdarg = a->start * mmc_async_bl_len(mmc);
+
+	cmd->resp_type = MMC_RSP_R1;
+	cmd->flags = 0;
+
+	data->dest = a->buf;
+	data->blocks = a->cur;
+	data->blocksize = (1<<9);
+	data->flags = a->write ? MMC_DATA_WRITE : MMC_DATA_READ;
+	if (mmc->data_done)
+		data->flags |= MMC_DATA_ASYNC;
+
+	a->err = mmc_send_rw(mmc, cmd, data);
+	a->inflight = !a->err && mmc->data_done;
+}
+
+static int mmc_async_poll(struct mmc *mmc, int wait)
+{
+	struct mmc_async *a = &mmc->async;
+	ulong ret;
+	int err;
+
+	while (a->active) {
+		if (a->inflight) {
+			err = mmc->data_done(mmc, wait);
+			if (err > 0)
+				return 1;
+			a->err = err;
+			a->inflight = 0;
+		}
+
+		/* redo a failed chunk the slow way, with error recovery */
+		if (a->err) {
+			if (a->write)
+				ret = mmc_write_blocks(mmc, a->start, a->cur,
+						       a->buf);
+			else
+				ret = mmc_read_blocks(mmc, a->start, a->cur,
+						      a->buf);
+			if (ret != a->cur) {
+				a->active = 0;
+				return -1;
+			}
+		}
+
+		a->start += a->cur;
+		a->left -= a->cur;
+		a->buf += a->cur * mmc_async_bl_len(mmc);
+		if (!a->left)
+			a->active = 0;
+		else
+			mmc_async_submit(mmc);
+	}
+
+	return 0;
+}
+
+static int mmc_xfer_start(int dev_num, lbaint_t start, lbaint_t blkcnt,
+			  void *buf, int write)
+{
+	struct mmc *mmc = find_mmc_device(dev_num);
+	struct mmc_async *a;
+	int err;
+
+	if (!mmc)
+		return -1;
+
+	a = &mmc->async;
+	err = mmc_async_poll(mmc, 1);
+	if (err)
+		return err;
+
+	if (write)
+		blkcache_invalidate(IF_TYPE_MMC, dev_num);
+	else if (blkcache_read(IF_TYPE_MMC, dev_num, start, blkcnt,
+			       mmc->read_bl_len, buf))
+		return 0;
+
+	if (!blkcnt)
+		return 0;
+
+	a->write = write;
+	a->start = start;
+	a->left = blkcnt;
+	a->buf = buf;
+	a->active = 1;
+	mmc_async_submit(mmc);
+
+	return 0;
+}
+
+int mmc_bread_start(int dev_num, lbaint_t start, lbaint_t blkcnt, void *dst)
+{
+	return mmc_xfer_start(dev_num, start, blkcnt, dst, 0);
+}
+
+int mmc_bwrite_start(int dev_num, lbaint_t start, lbaint_t blkcnt,
+		     const void *src)
+{
+	return mmc_xfer_start(dev_num, start, blkcnt, (void *)src, 1);
+}
+
+int mmc_xfer_done(int dev_num, int wait)
+{
+	struct mmc *mmc = find_mmc_device(dev_num);
+
+	if (!mmc)
+		return -1;
+
+	return mmc_async_poll(mmc, wait);
+}
+
 ulong movi_write(int dev_num, ulong start, lbaint_t blkcnt, void *src)
 {
 	return mmc_bwrite(dev_num, start, blkcnt, src);
@@ -1127,6 +1369,11 @@ int mmc_startup(struct mmc *mmc)
 	if (err)
 		return err;
 
+	/* SET_BLOCK_COUNT: MMC from 3.1 on, SD cards if the SCR says so */
+	if (IS_SD(mmc) ? (mmc->scr[0] & SD_DATA_CMD23) :
+			 (mmc->version >= MMC_VERSION_3))
+		mmc->card_caps |= MMC_MODE_SBC;
+
 	/* Restrict card's capabilities by what the host can do */
 	mmc->card_caps &= mmc->host_caps;
 
@@ -1285,6 +1532,11 @@ int mmc_register(struct mmc *mmc)
 	mmc->block_dev.removable = 1;
 	mmc->block_dev.block_read = mmc_bread;
 	mmc->block_dev.block_write = mmc_bwrite;
+	mmc->block_dev.block_read_start = mmc_bread_start;
+	mmc->block_dev.block_write_start = mmc_bwrite_start;
+	mmc->block_dev.block_xfer_done = mmc_xfer_done;
+	if (!mmc->b_max)
+		mmc->b_max = CONFIG_SYS_MMC_MAX_BLK_COUNT;
 
 	INIT_LIST_HEAD (&mmc->link);
 
@@ -1304,6 +1556,8 @@ int mmc_init(struct mmc *mmc)
 {
 	int err;
 
+	blkcache_invalidate(IF_TYPE_MMC, mmc->block_dev.dev);
+
 	err = mmc->init(mmc);
 
 	if (err)
@@ -1400,6 +1654,8 @@ int mmc_erase(struct mmc *mmc, int part, u32 start, u32 block)
 	u32 count, dis, blk_hc;
 	struct mmc_cmd cmd;
 
+	blkcache_invalidate(IF_TYPE_MMC, mmc->block_dev.dev);
+
 	printf("START: %d BLOCK: %d\n", start, block);
 	printf("high_capacity: %d\n", mmc->high_capacity);
 	printf("Capacity: %d\n", mmc->capacity);
@@ -1684,6 +1940,9 @@ int emmc_boot_open(struct mmc *mmc)
 	int err;
 	struct mmc_cmd cmd;
 
+	/* block addresses now refer to another hardware partition */
+	blkcache_invalidate(IF_TYPE_MMC, mmc->block_dev.dev);
+
 	/* Boot ack enable, boot partition enable , boot partition access */
 	cmd.cmdidx = MMC_CMD_SWITCH;
 	cmd.resp_type = MMC_RSP_R1b;
@@ -1712,6 +1971,8 @@ int emmc_boot_close(struct mmc *mmc)
 	int err;
 	struct mmc_cmd cmd;
 
+	blkcache_invalidate(IF_TYPE_MMC, mmc->block_dev.dev);
+
 	/* Boot ack enable, boot partition enable , boot partition access */
 	cmd.cmdidx = MMC_CMD_SWITCH;
 	cmd.resp_type = MMC_RSP_R1b;
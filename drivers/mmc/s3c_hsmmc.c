@@ -57,6 +57,9 @@ DECLARE_GLOBAL_DATA_PTR;
 #define mdelay(x)	udelay(1000*x)
 #endif
 
+/* matches SDHCI_MAKE_BLKSZ(7, ...) in sdhci_prepare_data */
+#define SDHCI_SDMA_BOUNDARY	(512 * 1024)
+
 struct mmc mmc_channel[MMC_MAX_CHANNEL];
 
 struct sdhci_host mmc_host[MMC_MAX_CHANNEL];
@@ -77,7 +80,7 @@ static void sdhci_prepare_data(struct sdhci_host *host, struct mmc_data *data)
 	ctrl &= ~SDHCI_CTRL_DMA_MASK;
 	writeb(ctrl, host->ioaddr + SDHCI_HOST_CONTROL);
 
-	/* We do not handle DMA boundaries, so set it to max (512 KiB) */
+	/* SDMA pauses at every 512 KiB boundary, see sdhci_data_done */
 	writew(SDHCI_MAKE_BLKSZ(7, data->blocksize),
 		host->ioaddr + SDHCI_BLOCK_SIZE);
 	writew(data->blocks, host->ioaddr + SDHCI_BLOCK_COUNT);
@@ -89,14 +92,59 @@ static void sdhci_set_transfer_mode(struct sdhci_host *host,
 	u16 mode;
 
 	mode = SDHCI_TRNS_BLK_CNT_EN | SDHCI_TRNS_DMA;
-	if (data->blocks > 1)
-		mode |= SDHCI_TRNS_MULTI | SDHCI_TRNS_ACMD12;
+	if (data->blocks > 1) {
+		mode |= SDHCI_TRNS_MULTI;
+		/* the card stops by itself after SET_BLOCK_COUNT */
+		if (!(data->flags & MMC_DATA_SBC))
+			mode |= SDHCI_TRNS_ACMD12;
+	}
 	if (data->flags & MMC_DATA_READ)
 		mode |= SDHCI_TRNS_READ;
 
 	writew(mode, host->ioaddr + SDHCI_TRANSFER_MODE);
 }
 
+/*
+ * Wait for (or with wait == 0 just check) the end of the data phase.
+ * Returns 1 while the transfer is still running.
+ */
+static int sdhci_data_done(struct sdhci_host *host, int wait)
+{
+	u32 mask;
+
+	do {
+		mask = readl(host->ioaddr + SDHCI_INT_STATUS);
+		if (mask & SDHCI_INT_ERROR)
+			break;
+		if ((mask & SDHCI_INT_DMA_END) &&
+		    !(mask & SDHCI_INT_DATA_END)) {
+			/*
+			 * SDMA stopped at a buffer boundary, restart
+			 * it at the next one so large multi block
+			 * transfers run as one command.
+			 */
+			writel(SDHCI_INT_DMA_END,
+				host->ioaddr + SDHCI_INT_STATUS);
+			host->dma_addr &= ~(SDHCI_SDMA_BOUNDARY - 1);
+			host->dma_addr += SDHCI_SDMA_BOUNDARY;
+			writel(host->dma_addr, host->ioaddr + SDHCI_DMA_ADDRESS);
+			mask &= ~SDHCI_INT_DMA_END;
+		}
+		if (!wait && !(mask & SDHCI_INT_DATA_END))
+			return 1;
+	} while (!(mask & SDHCI_INT_DATA_END));
+	writel(mask, host->ioaddr + SDHCI_INT_STATUS);
+	if (mask & SDHCI_INT_ERROR) {
+		printf("error during transfer: 0x%08x\n", mask);
+		return -1;
+	} else {		
+		dbg("r/w is done\n");
+	}
+
+	mdelay(1);
+	return 0;
+}
+
 /*
  * Sends a command out on the bus.  Takes the mmc pointer,
  * a command pointer, and an optional data pointer.
@@ -224,24 +272,22 @@ s3c_hsmmc_send_command(struct mmc *mmc, struct mmc_cmd *cmd,
 	}
 
 	if (data) {
-		while (!(mask & (SDHCI_INT_DATA_END | SDHCI_INT_ERROR | SDHCI_INT_DMA_END))) {
-			mask = readl(host->ioaddr + SDHCI_INT_STATUS);
-		}
-		writel(mask, host->ioaddr + SDHCI_INT_STATUS);
-		if (mask & SDHCI_INT_ERROR) {
-			printf("error during transfer: 0x%08x\n", mask);
-			return -1;
-		} else if (mask & SDHCI_INT_DMA_END) {
-			printf("SDHCI_INT_DMA_END\n");
-		} else {		
-			dbg("r/w is done\n");
-		}
+		host->dma_addr = virt_to_phys((u32)data->dest);
+		/* the caller reaps the data phase through data_done */
+		if (data->flags & MMC_DATA_ASYNC)
+			return 0;
+		return sdhci_data_done(host, 1);
 	}
 
 	mdelay(1);
 	return 0;
 }
 
+static int s3c_hsmmc_data_done(struct mmc *mmc, int wait)
+{
+	return sdhci_data_done(mmc->priv, wait);
+}
+
 static void sdhci_change_clock(struct sdhci_host *host, uint clock)
 {
 	u16 clk;
@@ -380,12 +426,15 @@ static int s3c_hsmmc_initialize(int channel)
 	sprintf(mmc->name, "S3C_HSMMC%d", channel);
 	mmc->priv = &mmc_host[channel];
 	mmc->send_cmd = s3c_hsmmc_send_command;
+	mmc->data_done = s3c_hsmmc_data_done;
 	mmc->set_ios = s3c_hsmmc_set_ios;
 	mmc->init = s3c_hsmmc_init;
 
 	mmc->voltages = MMC_VDD_32_33 | MMC_VDD_33_34;
 	mmc->host_caps = MMC_MODE_4BIT | MMC_MODE_8BIT |
-			MMC_MODE_HS_52MHz | MMC_MODE_HS;
+			MMC_MODE_HS_52MHz | MMC_MODE_HS | MMC_MODE_SBC;
+	/* 16 bit block count register */
+	mmc->b_max = 65535;
 
 	mmc->f_min = 400000;
 #ifdef CONFIG_EXYNOS4212
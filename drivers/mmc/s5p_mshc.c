@@ -54,7 +54,9 @@ struct mmc mshc_channel[MMC_MAX_CHANNEL];
 
 struct mshci_host mshc_host[MMC_MAX_CHANNEL];
 
-static struct mshci_idmac idmac_desc[0x10000]; /* it can cover to transfer 256MB at a time */
+/* 8 KiB per descriptor, enough for MSHCI_MAX_BLK_COUNT blocks */
+static struct mshci_idmac idmac_desc[MSHCI_MAX_BLK_COUNT * 512 /
+					(2 * MSHCI_IDMAC_BUF_SIZE) + 1];
 static int first_init=0;
 
 #if defined(CONFIG_CPU_EXYNOS5250_EVT1)
@@ -190,7 +192,7 @@ static void mshci_reset_dma(struct mshci_host *host)
 	writel(ier, host->ioaddr + MSHCI_CTRL);
 	while (readl(host->ioaddr + MSHCI_CTRL) & DMA_RESET) {
 		if (timeout == 0) {
-			printf("Reset DMA never completed.\n");
+			printf("Reset DMA never completed.\n");
 			return;
 		}
 		timeout--;
@@ -226,23 +228,22 @@ static void mshci_reset_all(struct mshci_host *host)
 
 
 
-static void mshci_set_mdma_desc(u8 *desc_vir, u8 *desc_phy, 
-				u32 des0, u32 des1, u32 des2)
+static void mshci_set_mdma_desc(u8 *desc_vir,
+				u32 des0, u32 des1, u32 des2, u32 des3)
 {
 	((struct mshci_idmac *)(desc_vir))->des0 = des0;
 	((struct mshci_idmac *)(desc_vir))->des1 = des1;
 	((struct mshci_idmac *)(desc_vir))->des2 = des2;
-	((struct mshci_idmac *)(desc_vir))->des3 = (u32)desc_phy +
-					sizeof(struct mshci_idmac);
+	((struct mshci_idmac *)(desc_vir))->des3 = des3;
 }
 
 
 static void mshci_prepare_data(struct mshci_host *host, struct mmc_data *data)
 {
 	u32 i;
-	u32 data_cnt;
+	u32 left;
 	u32 des_flag;
-	u32 blksz;
+	u32 buf, size1, size2;
 
 	struct mshci_idmac *pdesc_dmac;
 
@@ -250,29 +251,32 @@ static void mshci_prepare_data(struct mshci_host *host, struct mmc_data *data)
 
 	pdesc_dmac = idmac_desc;
 
-	blksz = data->blocksize;
-	data_cnt = data->blocks;
+	buf = virt_to_phys((u32)data->dest);
+	left = data->blocksize * data->blocks;
 
-	for ( i = 0;; i++)
+	/*
+	 * The IDMAC runs in dual buffer mode: a descriptor carries two
+	 * buffers of up to MSHCI_IDMAC_BUF_SIZE each and the descriptors
+	 * follow each other in memory (BMOD skip length 0).
+	 */
+	for (i = 0; left; i++)
 	{
-		des_flag = (MSHCI_IDMAC_OWN|MSHCI_IDMAC_CH);
+		des_flag = MSHCI_IDMAC_OWN;
 		des_flag |= (i==0) ? MSHCI_IDMAC_FS:0;
-		if (data_cnt <= 8)
-		{
-			des_flag |= MSHCI_IDMAC_LD;		
-			mshci_set_mdma_desc((u8 *)pdesc_dmac,
-					(u8 *)virt_to_phys((u32)pdesc_dmac),
-					des_flag, blksz * data_cnt,
-					(u32)(virt_to_phys((u32)data->dest))+(u32)(i*0x1000));
-			break;
-		}
-		/* max transfer size is 4KB per a description. */
-		mshci_set_mdma_desc((u8 *)pdesc_dmac,
-				(u8 *)virt_to_phys((u32)pdesc_dmac),
-				des_flag, blksz * 8,
-				virt_to_phys((u32)data->dest)+(u32)(i*0x1000));
 
-		data_cnt-= 8;
+		size1 = min(left, (u32)MSHCI_IDMAC_BUF_SIZE);
+		left -= size1;
+		size2 = min(left, (u32)MSHCI_IDMAC_BUF_SIZE);
+		left -= size2;
+
+		if (!left)
+			des_flag |= MSHCI_IDMAC_LD | MSHCI_IDMAC_ER;
+
+		mshci_set_mdma_desc((u8 *)pdesc_dmac, des_flag,
+				MSHCI_IDMAC_BS1(size1) | MSHCI_IDMAC_BS2(size2),
+				buf, size2 ? buf + size1 : 0);
+
+		buf += size1 + size2;
 		pdesc_dmac++;
 	}
 
@@ -297,7 +301,8 @@ static int mshci_set_transfer_mode(struct mshci_host *host,
  
 	/* this cmd has data to transmit */
 	mode |= CMD_DATA_EXP_BIT;
-	if (data->blocks > 1)
+	/* the card stops by itself after SET_BLOCK_COUNT */
+	if (data->blocks > 1 && !(data->flags & MMC_DATA_SBC))
 		mode |= CMD_SENT_AUTO_STOP_BIT;
 	if (data->flags & MMC_DATA_WRITE)
 		mode |= CMD_RW_BIT;
@@ -307,6 +312,43 @@ static int mshci_set_transfer_mode(struct mshci_host *host,
 }
 
 
+/*
+ * Wait for (or with wait == 0 just check) the end of the data phase.
+ * Returns 1 while the transfer is still running.
+ */
+static int mshci_data_done(struct mshci_host *host, int wait)
+{
+	u32 mask;
+
+	do {
+		mask = readl(host->ioaddr + MSHCI_RINTSTS);
+		if (!wait && !(mask & (DATA_ERR | DATA_TOUT | INTMSK_DTO)))
+			return 1;
+	} while (!(mask & (DATA_ERR | DATA_TOUT | INTMSK_DTO)));
+	writel(mask, host->ioaddr + MSHCI_RINTSTS);
+	if (mask & (DATA_ERR | DATA_TOUT)) {
+		printf("error during transfer: 0x%08x\n", mask);
+
+		/* make sure disable IDMAC and IDMAC_Interrupts */
+		mshci_writel(host, (mshci_readl(host, MSHCI_CTRL) & 
+				~(DMA_ENABLE|ENABLE_IDMAC)), MSHCI_CTRL);
+		/* mask all interrupt source of IDMAC */
+		mshci_writel(host, 0x0, MSHCI_IDINTEN);				
+
+		return -1;
+	}
+	dbg("MSHCI_INT_DMA_END\n");
+
+	/* make sure disable IDMAC and IDMAC_Interrupts */
+	mshci_writel(host, (mshci_readl(host, MSHCI_CTRL) & 
+			~(DMA_ENABLE|ENABLE_IDMAC)), MSHCI_CTRL);
+	/* mask all interrupt source of IDMAC */
+	mshci_writel(host, 0x0, MSHCI_IDINTEN);		
+
+	mdelay(1); /* ############# why it is ############## */
+	return 0;
+}
+
 #define COMMAND_TIMEOUT (0x200000)
 
 /*
@@ -428,36 +470,21 @@ s5p_mshc_send_command(struct mmc *mmc, struct mmc_cmd *cmd,
 	}
 
 	if (data) {
-		while (!(mask & (DATA_ERR | DATA_TOUT | INTMSK_DTO ))) {
-			mask = readl(host->ioaddr + MSHCI_RINTSTS);
-		}
-		writel(mask, host->ioaddr + MSHCI_RINTSTS);
-		if (mask & (DATA_ERR | DATA_TOUT)) {
-			printf("error during transfer: 0x%08x\n", mask);
-			
-			/* make sure disable IDMAC and IDMAC_Interrupts */
-			mshci_writel(host, (mshci_readl(host, MSHCI_CTRL) & 
-					~(DMA_ENABLE|ENABLE_IDMAC)), MSHCI_CTRL);
-			/* mask all interrupt source of IDMAC */
-			mshci_writel(host, 0x0, MSHCI_IDINTEN);				
-			
-			return -1;
-		} else if (mask & INTMSK_DTO) {
-			dbg("MSHCI_INT_DMA_END\n");
-		} else {		
-			printf("unexpected condition 0x%x\n",mask);
-		}
-		/* make sure disable IDMAC and IDMAC_Interrupts */
-		mshci_writel(host, (mshci_readl(host, MSHCI_CTRL) & 
-				~(DMA_ENABLE|ENABLE_IDMAC)), MSHCI_CTRL);
-		/* mask all interrupt source of IDMAC */
-		mshci_writel(host, 0x0, MSHCI_IDINTEN);		
+		/* the caller reaps the data phase through data_done */
+		if (data->flags & MMC_DATA_ASYNC)
+			return 0;
+		return mshci_data_done(host, 1);
 	}
 
 	mdelay(1); /* ############# why it is ############## */
 	return 0;
 }
 
+static int s5p_mshc_data_done(struct mmc *mmc, int wait)
+{
+	return mshci_data_done(mmc->priv, wait);
+}
+
 static void mshci_clock_onoff(struct mshci_host *host, int val)
 {
 	volatile u32 loop_count = 0x100000;
@@ -768,6 +795,7 @@ static int s5p_mshc_initialize(int channel)
 	sprintf(mmc->name, "S5P_MSHC%d", channel);
 	mmc->priv = &mshc_host[channel];
 	mmc->send_cmd = s5p_mshc_send_command;
+	mmc->data_done = s5p_mshc_data_done;
 	mmc->set_ios = s5p_mshc_set_ios;
 	mmc->init = s5c_mshc_init;
 
@@ -791,6 +819,9 @@ static int s5p_mshc_initialize(int channel)
 				MMC_MODE_HS_52MHz_DDR_18_3V; // |
 //				MMC_MODE_4BIT_DDR;
 #endif
+	mmc->host_caps |= MMC_MODE_SBC;
+	mmc->b_max = MSHCI_MAX_BLK_COUNT;
+
 	mmc->f_min = 400000;
 	mmc->f_max = 50000000;
 
@@ -82,7 +82,13 @@
 #define USB_BULK_SEND_TIMEOUT 5000
 #define USB_BULK_RECV_TIMEOUT 5000
 
+/*
+ * The chip packs frames into bulk in transfers of up to AX_RX_URB_SIZE
+ * bytes. Keep several of them queued so that it can go on receiving
+ * while earlier ones are being handled.
+ */
 #define AX_RX_URB_SIZE 2048
+#define AX_RX_URB_COUNT 8
 #define PHY_CONNECT_TIMEOUT 5000
 
 /* asix_flags defines */
@@ -447,6 +453,11 @@ static int asix_init(struct eth_device *eth, bd_t *bd)
 		goto out_err;
 	}
 
+	if (usb_ether_rx_start(dev, AX_RX_URB_SIZE, AX_RX_URB_COUNT) < 0) {
+		printf("unable to set up receive buffers\n");
+		goto out_err;
+	}
+
 	return 0;
 out_err:
 	return -1;
@@ -486,71 +497,66 @@ static int asix_send(struct eth_device *eth, void *packet, int length)
 static int asix_recv(struct eth_device *eth)
 {
 	struct ueth_data *dev = (struct ueth_data *)eth->priv;
-	ALLOC_CACHE_ALIGN_BUFFER(unsigned char, recv_buf, AX_RX_URB_SIZE);
+	unsigned char *recv_buf;
 	unsigned char *buf_ptr;
-	int err;
 	int actual_len;
 	u32 packet_len;
 
 	debug("** %s()\n", __func__);
 
-	err = usb_bulk_msg(dev->pusb_dev,
-				usb_rcvbulkpipe(dev->pusb_dev, dev->ep_in),
-				(void *)recv_buf,
-				AX_RX_URB_SIZE,
-				&actual_len,
-				USB_BULK_RECV_TIMEOUT);
-	debug("Rx: len = %u, actual = %u, err = %d\n", AX_RX_URB_SIZE,
-		actual_len, err);
-	if (err != 0) {
-		debug("Rx: failed to receive\n");
-		return -1;
-	}
-	if (actual_len > AX_RX_URB_SIZE) {
-		debug("Rx: received too many bytes %d\n", actual_len);
-		return -1;
-	}
+	/* Hand every frame of every transfer completed so far to the stack */
+	while ((recv_buf = usb_ether_rx(dev, &actual_len)) != NULL) {
+		debug("Rx: actual = %u\n", actual_len);
+		buf_ptr = recv_buf;
+		while (actual_len > 0) {
+			/*
+			 * 1st 4 bytes contain the length of the actual data
+			 * as two complementary 16-bit words. Extract the
+			 * length of the data.
+			 */
+			if (actual_len < sizeof(packet_len)) {
+				debug("Rx: incomplete packet length\n");
+				break;
+			}
+			memcpy(&packet_len, buf_ptr, sizeof(packet_len));
+			le32_to_cpus(&packet_len);
+			if (((~packet_len >> 16) & 0x7ff) !=
+			    (packet_len & 0x7ff)) {
+				debug("Rx: malformed packet length: "
+				      "%#x (%#x:%#x)\n", packet_len,
+				      (~packet_len >> 16) & 0x7ff,
+				      packet_len & 0x7ff);
+				break;
+			}
+			packet_len = packet_len & 0x7ff;
+			if (packet_len > actual_len - sizeof(packet_len)) {
+				debug("Rx: too large packet: %d\n", packet_len);
+				break;
+			}
 
-	buf_ptr = recv_buf;
-	while (actual_len > 0) {
-		/*
-		 * 1st 4 bytes contain the length of the actual data as two
-		 * complementary 16-bit words. Extract the length of the data.
-		 */
-		if (actual_len < sizeof(packet_len)) {
-			debug("Rx: incomplete packet length\n");
-			return -1;
-		}
-		memcpy(&packet_len, buf_ptr, sizeof(packet_len));
-		le32_to_cpus(&packet_len);
-		if (((~packet_len >> 16) & 0x7ff) != (packet_len & 0x7ff)) {
-			debug("Rx: malformed packet length: %#x (%#x:%#x)\n",
-			      packet_len, (~packet_len >> 16) & 0x7ff,
-			      packet_len & 0x7ff);
-			return -1;
-		}
-		packet_len = packet_len & 0x7ff;
-		if (packet_len > actual_len - sizeof(packet_len)) {
-			debug("Rx: too large packet: %d\n", packet_len);
-			return -1;
+			/* Notify net stack */
+			NetReceive(buf_ptr + sizeof(packet_len), packet_len);
+
+			/*
+			 * Adjust for next iteration. Packets are padded to
+			 * 16-bits
+			 */
+			if (packet_len & 1)
+				packet_len++;
+			actual_len -= sizeof(packet_len) + packet_len;
+			buf_ptr += sizeof(packet_len) + packet_len;
 		}
-
-		/* Notify net stack */
-		NetReceive(buf_ptr + sizeof(packet_len), packet_len);
-
-		/* Adjust for next iteration. Packets are padded to 16-bits */
-		if (packet_len & 1)
-			packet_len++;
-		actual_len -= sizeof(packet_len) + packet_len;
-		buf_ptr += sizeof(packet_len) + packet_len;
 	}
 
-	return err;
+	return 0;
 }
 
 static void asix_halt(struct eth_device *eth)
 {
+	struct ueth_data *dev = (struct ueth_data *)eth->priv;
+
 	debug("** %s()\n", __func__);
+	usb_ether_rx_stop(dev);
 }
 
 /*
@@ -130,7 +130,20 @@
 #define USB_BULK_SEND_TIMEOUT 5000
 #define USB_BULK_RECV_TIMEOUT 5000
 
-#define AX_RX_URB_SIZE 2048
+/*
+ * In turbo mode the chip packs as many frames into one bulk in transfer as
+ * BURST_CAP allows. Keep a few such transfers queued so that it does not
+ * have to wait for us between them.
+ */
+#define RX_URB_SIZE	(16 * 1024)
+#define RX_URB_COUNT	4
+
+/*
+ * The chip puts this many bytes of padding in front of every received
+ * frame. Two bytes leave the IP header, and with it the payload of TFTP
+ * and NFS data packets, word aligned for the copy to the load address.
+ */
+#define NET_IP_ALIGN	2
 #define PHY_CONNECT_TIMEOUT 5000
 
 #define TURBO_MODE
@@ -533,11 +546,12 @@ static int smsc95xx_init(struct eth_device *eth, bd_t *bd)
 
 #ifdef TURBO_MODE
 	if (dev->pusb_dev->speed == USB_SPEED_HIGH) {
-		burst_cap = DEFAULT_HS_BURST_CAP_SIZE / HS_USB_PKT_SIZE;
-		priv->rx_urb_size = DEFAULT_HS_BURST_CAP_SIZE;
+		burst_cap = RX_URB_SIZE / HS_USB_PKT_SIZE;
+		priv->rx_urb_size = RX_URB_SIZE;
 	} else {
 		burst_cap = DEFAULT_FS_BURST_CAP_SIZE / FS_USB_PKT_SIZE;
-		priv->rx_urb_size = DEFAULT_FS_BURST_CAP_SIZE;
+		priv->rx_urb_size = ALIGN(DEFAULT_FS_BURST_CAP_SIZE,
+					  ARCH_DMA_MINALIGN);
 	}
 #else
 	burst_cap = 0;
@@ -574,8 +588,6 @@ static int smsc95xx_init(struct eth_device *eth, bd_t *bd)
 	read_buf |= (HW_CFG_MEF_ | HW_CFG_BCE_);
 #endif
 	read_buf &= ~HW_CFG_RXDOFF_;
-
-#define NET_IP_ALIGN 0
 	read_buf |= NET_IP_ALIGN << 9;
 
 	ret = smsc95xx_write_reg(dev, HW_CFG, read_buf);
@@ -650,6 +662,11 @@ static int smsc95xx_init(struct eth_device *eth, bd_t *bd)
 	smsc95xx_start_tx_path(dev);
 	smsc95xx_start_rx_path(dev);
 
+	if (usb_ether_rx_start(dev, priv->rx_urb_size, RX_URB_COUNT) < 0) {
+		printf("unable to set up receive buffers\n");
+		return -1;
+	}
+
 	timeout = 0;
 	do {
 		link_detected = smsc95xx_mdio_read(dev, dev->phy_id, MII_BMSR)
@@ -710,75 +727,69 @@ static int smsc95xx_send(struct eth_device *eth, void* packet, int length)
 static int smsc95xx_recv(struct eth_device *eth)
 {
 	struct ueth_data *dev = (struct ueth_data *)eth->priv;
-	DEFINE_CACHE_ALIGN_BUFFER(unsigned char, recv_buf, AX_RX_URB_SIZE);
+	unsigned char *recv_buf;
 	unsigned char *buf_ptr;
-	int err;
 	int actual_len;
 	u32 packet_len;
 	int cur_buf_align;
 
 	debug("** %s()\n", __func__);
-	err = usb_bulk_msg(dev->pusb_dev,
-				usb_rcvbulkpipe(dev->pusb_dev, dev->ep_in),
-				(void *)recv_buf,
-				AX_RX_URB_SIZE,
-				&actual_len,
-				USB_BULK_RECV_TIMEOUT);
-	debug("Rx: len = %u, actual = %u, err = %d\n", AX_RX_URB_SIZE,
-	      actual_len, err);
-	if (err != 0) {
-		debug("Rx: failed to receive\n");
-		return -1;
-	}
-	if (actual_len > AX_RX_URB_SIZE) {
-		debug("Rx: received too many bytes %d\n", actual_len);
-		return -1;
-	}
-
-	buf_ptr = recv_buf;
-	while (actual_len > 0) {
-		/*
-		 * 1st 4 bytes contain the length of the actual data plus error
-		 * info. Extract data length.
-		 */
-		if (actual_len < sizeof(packet_len)) {
-			debug("Rx: incomplete packet length\n");
-			return -1;
-		}
-		memcpy(&packet_len, buf_ptr, sizeof(packet_len));
-		le32_to_cpus(&packet_len);
-		if (packet_len & RX_STS_ES_) {
-			debug("Rx: Error header=%#x", packet_len);
-			return -1;
-		}
-		packet_len = ((packet_len & RX_STS_FL_) >> 16);
-
-		if (packet_len > actual_len - sizeof(packet_len)) {
-			debug("Rx: too large packet: %d\n", packet_len);
-			return -1;
-		}
 
-		/* Notify net stack */
-		NetReceive(buf_ptr + sizeof(packet_len), packet_len - 4);
-
-		/* Adjust for next iteration */
-		actual_len -= sizeof(packet_len) + packet_len;
-		buf_ptr += sizeof(packet_len) + packet_len;
-		cur_buf_align = (int)buf_ptr - (int)recv_buf;
-
-		if (cur_buf_align & 0x03) {
-			int align = 4 - (cur_buf_align & 0x03);
-
-			actual_len -= align;
-			buf_ptr += align;
+	/* Hand every frame of every transfer completed so far to the stack */
+	while ((recv_buf = usb_ether_rx(dev, &actual_len)) != NULL) {
+		debug("Rx: actual = %u\n", actual_len);
+		buf_ptr = recv_buf;
+		while (actual_len > 0) {
+			/*
+			 * 1st 4 bytes contain the length of the actual data
+			 * plus error info. Extract data length.
+			 */
+			if (actual_len < sizeof(packet_len) + NET_IP_ALIGN) {
+				debug("Rx: incomplete packet length\n");
+				break;
+			}
+			memcpy(&packet_len, buf_ptr, sizeof(packet_len));
+			le32_to_cpus(&packet_len);
+			if (packet_len & RX_STS_ES_) {
+				debug("Rx: Error header=%#x", packet_len);
+				break;
+			}
+			packet_len = ((packet_len & RX_STS_FL_) >> 16);
+
+			if (packet_len > actual_len - sizeof(packet_len) -
+					 NET_IP_ALIGN) {
+				debug("Rx: too large packet: %d\n", packet_len);
+				break;
+			}
+
+			/* Notify net stack */
+			NetReceive(buf_ptr + sizeof(packet_len) + NET_IP_ALIGN,
+				   packet_len - 4);
+
+			/* Adjust for next iteration */
+			actual_len -= sizeof(packet_len) + NET_IP_ALIGN +
+				      packet_len;
+			buf_ptr += sizeof(packet_len) + NET_IP_ALIGN +
+				   packet_len;
+			cur_buf_align = (int)buf_ptr - (int)recv_buf;
+
+			if (cur_buf_align & 0x03) {
+				int align = 4 - (cur_buf_align & 0x03);
+
+				actual_len -= align;
+				buf_ptr += align;
+			}
 		}
 	}
-	return err;
+	return 0;
 }
 
 static void smsc95xx_halt(struct eth_device *eth)
 {
+	struct ueth_data *dev = (struct ueth_data *)eth->priv;
+
 	debug("** %s()\n", __func__);
+	usb_ether_rx_stop(dev);
 }
 
 /*
@@ -5,6 +5,7 @@
  */
 
 #include <common.h>
+#include <malloc.h>
 #include <usb.h>
 
 #include "usb_ether.h"
@@ -147,3 +148,85 @@ int usb_host_eth_scan(int mode)
 		return 0;
 	return -1;
 }
+
+#define USB_ETHER_RX_TIMEOUT	5000
+
+int usb_ether_rx_start(struct ueth_data *ueth, int size, int count)
+{
+	usb_ether_rx_stop(ueth);
+
+#ifndef CONFIG_USB_EHCI
+	count = 1;
+#endif
+	ueth->rx_buf = memalign(ARCH_DMA_MINALIGN, size * count);
+	if (!ueth->rx_buf)
+		return -1;
+	ueth->rx_size = size;
+	ueth->rx_count = count;
+	ueth->rx_held = 0;
+
+#ifdef CONFIG_USB_EHCI
+	ueth->rx_queue = create_bulk_queue(ueth->pusb_dev,
+			usb_rcvbulkpipe(ueth->pusb_dev, ueth->ep_in),
+			count, size, ueth->rx_buf);
+	if (!ueth->rx_queue) {
+		usb_ether_rx_stop(ueth);
+		return -1;
+	}
+#endif
+	return 0;
+}
+
+unsigned char *usb_ether_rx(struct ueth_data *ueth, int *len)
+{
+	struct usb_device *dev = ueth->pusb_dev;
+	unsigned int pipe = usb_rcvbulkpipe(dev, ueth->ep_in);
+#ifdef CONFIG_USB_EHCI
+	unsigned char *buf;
+
+	if (!ueth->rx_queue)
+		return NULL;
+
+	dev->status = 0;
+	buf = poll_bulk_queue(dev, ueth->rx_queue, len);
+	if (!buf && dev->status) {
+		debug("Rx: endpoint halted, status %#lx\n", dev->status);
+		destroy_bulk_queue(dev, ueth->rx_queue);
+		usb_clear_halt(dev, pipe);
+		ueth->rx_queue = create_bulk_queue(dev, pipe, ueth->rx_count,
+						   ueth->rx_size, ueth->rx_buf);
+	}
+	return buf;
+#else
+	int err;
+
+	if (!ueth->rx_buf)
+		return NULL;
+
+	/* Do not block again once the caller has had a transfer */
+	if (ueth->rx_held) {
+		ueth->rx_held = 0;
+		return NULL;
+	}
+
+	err = usb_bulk_msg(dev, pipe, ueth->rx_buf, ueth->rx_size, len,
+			   USB_ETHER_RX_TIMEOUT);
+	debug("Rx: len = %u, actual = %u, err = %d\n", ueth->rx_size,
+	      *len, err);
+	if (err != 0 || *len > ueth->rx_size)
+		return NULL;
+	ueth->rx_held = 1;
+	return ueth->rx_buf;
+#endif
+}
+
+void usb_ether_rx_stop(struct ueth_data *ueth)
+{
+#ifdef CONFIG_USB_EHCI
+	if (ueth->rx_queue)
+		destroy_bulk_queue(ueth->pusb_dev, ueth->rx_queue);
+	ueth->rx_queue = NULL;
+#endif
+	free(ueth->rx_buf);
+	ueth->rx_buf = NULL;
+}
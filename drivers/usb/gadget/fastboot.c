@@ -203,6 +203,65 @@ void fboot_usb_int_bulkin(void)
 	return;
 }
 
+#ifndef CONFIG_USB_CPUMODE
+/* A download received by DMA straight into the transfer buffer, in
+   transfers of up to FBOOT_DMA_XFER_PKTS packets with one interrupt each */
+#define FBOOT_DMA_XFER_PKTS	512
+
+static u8 *fboot_dma_ptr;
+static u32 fboot_dma_left;
+static u32 fboot_dma_xfer;
+
+static int fboot_rx_dma(unsigned char *buffer, unsigned int size)
+{
+	if ((u32)buffer & 0x7)
+		return -1;
+
+	fboot_dma_ptr = buffer;
+	fboot_dma_left = size;
+	return 0;
+}
+
+static void fboot_dma_start(void)
+{
+	u32 pktcnt;
+
+	fboot_dma_xfer = MIN(fboot_dma_left,
+			     FBOOT_DMA_XFER_PKTS * otg.bulkout_max_pktsize);
+	pktcnt = (fboot_dma_xfer - 1) / otg.bulkout_max_pktsize + 1;
+
+	writel(virt_to_phys(fboot_dma_ptr), S5P_OTG_DOEPDMA_OUT);
+	s3c_usb_set_outep_xfersize(EP_TYPE_BULK, pktcnt, fboot_dma_xfer);
+	writel(DEPCTL_EPENA|DEPCTL_CNAK|readl(S5P_OTG_DOEPCTL_OUT),
+		S5P_OTG_DOEPCTL_OUT);
+}
+
+static void fboot_dma_done(void)
+{
+	u8 *data = fboot_dma_ptr;
+	u32 cnt_byte;
+
+	cnt_byte = fboot_dma_xfer - (readl(S5P_OTG_DOEPTSIZ_OUT) & 0x7FFFF);
+	fboot_dma_ptr += cnt_byte;
+	/* A short packet, a zero length one from the host included, ends
+	   the DMA early. Whatever is left of the download then comes in
+	   through tmp_buf packet by packet, which rx_handler copies to
+	   where it belongs, and an empty one is only reported. */
+	if (cnt_byte < fboot_dma_xfer)
+		fboot_dma_left = 0;
+	else
+		fboot_dma_left -= cnt_byte;
+
+	if (fastboot_interface && fastboot_interface->rx_handler)
+		fastboot_interface->rx_handler(data, cnt_byte);
+
+	if (fboot_dma_left)
+		fboot_dma_start();
+	else
+		s3c_usb_bulk_outep_setdma(tmp_buf, HS_BULK_PKT_SIZE);
+}
+#endif
+
 #ifdef CONFIG_USB_CPUMODE
 void fboot_usb_int_bulkout(u32 fifo_cnt_byte)
 #else
@@ -211,6 +270,13 @@ void fboot_usb_int_bulkout( void )
 {
 	DBG_BULK0("@@\n Bulk Out Function : otg.dn_filesize=0x%x\n", otg.dn_filesize);
 
+#ifndef CONFIG_USB_CPUMODE
+	if (fboot_dma_left) {
+		fboot_dma_done();
+		return;
+	}
+#endif
+
 #ifdef CONFIG_USB_CPUMODE
 	s3c_usb_read_out_fifo((u8 *)fastboot_bulk_fifo, fifo_cnt_byte);
 	if (fifo_cnt_byte<64) {
@@ -238,7 +304,11 @@ void fboot_usb_int_bulkout( void )
 #else
 		if (!fastboot_interface->rx_handler(&tmp_buf, cnt_byte));
 	}
-	s3c_usb_bulk_outep_setdma(tmp_buf, HS_BULK_PKT_SIZE);
+	/* a download: command may have set up the data phase */
+	if (fboot_dma_left)
+		fboot_dma_start();
+	else
+		s3c_usb_bulk_outep_setdma(tmp_buf, HS_BULK_PKT_SIZE);
 #endif
 }
 
@@ -367,6 +437,10 @@ int fastboot_init(struct cmd_fastboot_interface *interface)
 	fastboot_interface->nand_block_size               = CFG_FASTBOOT_PAGESIZE * 64;
 	fastboot_interface->transfer_buffer               = (unsigned char *) CFG_FASTBOOT_TRANSFER_BUFFER;
 	fastboot_interface->transfer_buffer_size          = CFG_FASTBOOT_TRANSFER_BUFFER_SIZE;
+#ifndef CONFIG_USB_CPUMODE
+	fastboot_interface->rx_dma                        = fboot_rx_dma;
+	fboot_dma_left = 0;
+#endif
 
 	memset((unsigned char *) CFG_FASTBOOT_TRANSFER_BUFFER, 0x0, FASTBOOT_REBOOT_MAGIC_SIZE);
 
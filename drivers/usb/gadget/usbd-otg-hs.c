@@ -2072,6 +2072,11 @@ void s3c_usb_reset(void)
 {
 	s3c_usb_set_all_outep_nak();
 
+#if defined(CONFIG_FASTBOOT) && !defined(CONFIG_USB_CPUMODE)
+	/* a download in progress does not survive the bus reset */
+	fboot_dma_left = 0;
+#endif
+
 	otg.ep0_state = EP0_STATE_INIT;
 	writel(((1<<BULK_OUT_EP)|(1<<CONTROL_EP))<<16|((1<<BULK_IN_EP)|(1<<CONTROL_EP)),
 		S5P_OTG_DAINTMSK);
@@ -273,20 +273,216 @@ static inline u8 ehci_encode_speed(enum usb_device_speed speed)
 	return QH_FULL_SPEED;
 }
 
+static int ehci_enable_async(struct ehci_ctrl *ctrl, int enable)
+{
+	uint32_t cmd, usbsts;
+	int ret;
+
+	cmd = ehci_readl(&ctrl->hcor->or_usbcmd);
+	if (!!(cmd & CMD_ASE) == enable)
+		return 0;
+
+	if (enable) {
+		/* Set async. queue head pointer. */
+		ehci_writel(&ctrl->hcor->or_asynclistaddr,
+			    (uint32_t)&ctrl->qh_list);
+
+		usbsts = ehci_readl(&ctrl->hcor->or_usbsts);
+		ehci_writel(&ctrl->hcor->or_usbsts, (usbsts & 0x3f));
+
+		cmd |= CMD_ASE;
+	} else {
+		cmd &= ~CMD_ASE;
+	}
+	ehci_writel(&ctrl->hcor->or_usbcmd, cmd);
+
+	ret = handshake((uint32_t *)&ctrl->hcor->or_usbsts, STS_ASS,
+			enable ? STS_ASS : 0, 100 * 1000);
+	if (ret < 0)
+		printf("EHCI fail timeout STS_ASS %s\n",
+		       enable ? "set" : "reset");
+	return ret;
+}
+
+/*
+ * Takes qh out of the async schedule. Once the controller has answered
+ * the doorbell it no longer holds on to the QH, which may then be reused.
+ */
+static int ehci_unlink_qh(struct ehci_ctrl *ctrl, struct QH *qh)
+{
+	struct QH *prev = &ctrl->qh_list;
+	uint32_t cmd;
+	int ret;
+
+	while ((hc32_to_cpu(prev->qh_link) & ~0x1f) != (uint32_t)qh) {
+		prev = (struct QH *)(hc32_to_cpu(prev->qh_link) & ~0x1f);
+		if (prev == &ctrl->qh_list)
+			return 0;
+	}
+	prev->qh_link = qh->qh_link;
+	flush_dcache_range((uint32_t)prev, ALIGN_END_ADDR(struct QH, prev, 1));
+
+	cmd = ehci_readl(&ctrl->hcor->or_usbcmd);
+	if (!(cmd & CMD_ASE))
+		return 0;
+
+	ehci_writel(&ctrl->hcor->or_usbsts, STS_IAA);
+	ehci_writel(&ctrl->hcor->or_usbcmd, cmd | CMD_IAAD);
+	ret = handshake((uint32_t *)&ctrl->hcor->or_usbsts, STS_IAA, STS_IAA,
+			100 * 1000);
+	ehci_writel(&ctrl->hcor->or_usbsts, STS_IAA);
+	if (ret < 0)
+		printf("EHCI fail timeout STS_IAA set\n");
+	return ret;
+}
+
+/* Links an idle qh with the given endpoint characteristics into the list */
+static void ehci_link_qh(struct ehci_ctrl *ctrl, struct QH *qh,
+			 uint32_t endpt1, uint32_t endpt2)
+{
+	memset(qh, 0, sizeof(struct QH));
+	qh->qh_endpt1 = cpu_to_hc32(endpt1);
+	qh->qh_endpt2 = cpu_to_hc32(endpt2);
+	qh->qh_overlay.qt_next = cpu_to_hc32(QT_NEXT_TERMINATE);
+	qh->qh_overlay.qt_altnext = cpu_to_hc32(QT_NEXT_TERMINATE);
+	qh->qh_link = ctrl->qh_list.qh_link;
+	flush_dcache_range((uint32_t)qh, ALIGN_END_ADDR(struct QH, qh, 1));
+
+	ctrl->qh_list.qh_link = cpu_to_hc32((uint32_t)qh | QH_LINK_TYPE_QH);
+	flush_dcache_range((uint32_t)&ctrl->qh_list,
+		ALIGN_END_ADDR(struct QH, &ctrl->qh_list, 1));
+}
+
+/* The fields of qh_endpt1 that tell endpoints apart */
+#define EHCI_ENDPT1_ID	(QH_ENDPT1_ENDPT(0xf) | QH_ENDPT1_DEVADDR(0x7f))
+
+static int ehci_same_ep(struct ehci_async_ep *ep, uint32_t endpt1, int out)
+{
+	return ep->endpt1 && ep->out == out &&
+		!((ep->endpt1 ^ endpt1) & EHCI_ENDPT1_ID);
+}
+
+/*
+ * Returns the QH kept in the async schedule for an endpoint, linking one
+ * in if there is none yet. There is at most one per endpoint: if the
+ * endpoint characteristics changed, its QH is set up again. The least
+ * recently used QH is recycled once all are taken.
+ */
+static struct QH *ehci_get_qh(struct ehci_ctrl *ctrl, uint32_t endpt1,
+			      uint32_t endpt2, int out)
+{
+	struct ehci_async_ep *ep;
+	struct QH *qh;
+	int i, slot = 0;
+
+	for (i = 0; i < EHCI_ASYNC_QHS; i++) {
+		ep = &ctrl->async_ep[i];
+		if (ehci_same_ep(ep, endpt1, out)) {
+			if (ep->endpt1 == endpt1 && ep->endpt2 == endpt2) {
+				ep->last = ++ctrl->async_seq;
+				return &ctrl->async_qh[i].qh;
+			}
+			slot = i;
+			break;
+		}
+		if (ep->last < ctrl->async_ep[slot].last)
+			slot = i;
+	}
+
+	ep = &ctrl->async_ep[slot];
+	qh = &ctrl->async_qh[slot].qh;
+	if (ep->endpt1 && ehci_unlink_qh(ctrl, qh) < 0)
+		return NULL;
+
+	ehci_link_qh(ctrl, qh, endpt1, endpt2);
+	ep->endpt1 = endpt1;
+	ep->endpt2 = endpt2;
+	ep->out = out;
+	ep->last = ++ctrl->async_seq;
+	return qh;
+}
+
+/* Takes the QH of an endpoint out of the schedule, if it has one */
+static int ehci_drop_qh(struct ehci_ctrl *ctrl, uint32_t endpt1, int out)
+{
+	struct ehci_async_ep *ep;
+	int i;
+
+	for (i = 0; i < EHCI_ASYNC_QHS; i++) {
+		ep = &ctrl->async_ep[i];
+		if (ehci_same_ep(ep, endpt1, out)) {
+			ep->endpt1 = 0;
+			ep->last = 0;
+			return ehci_unlink_qh(ctrl, &ctrl->async_qh[i].qh);
+		}
+	}
+	return 0;
+}
+
+struct bulk_queue {
+	struct bulk_queue *next_queue;	/* on ctrl->bulk_queues */
+	struct QH *qh;
+	struct qTD *tds;
+	void *buffer;
+	int queuesize;
+	int elementsize;
+	int next;	/* element to complete next */
+	int held;	/* element handed out by poll_bulk_queue(), or -1 */
+	unsigned long pipe;
+};
+
+/* Whether a bulk queue owns the endpoint of pipe */
+static int ehci_bulk_queued(struct ehci_ctrl *ctrl, unsigned long pipe)
+{
+	struct bulk_queue *queue;
+
+	for (queue = ctrl->bulk_queues; queue; queue = queue->next_queue)
+		if (usb_pipedevice(queue->pipe) == usb_pipedevice(pipe) &&
+		    usb_pipeendpoint(queue->pipe) == usb_pipeendpoint(pipe) &&
+		    usb_pipein(queue->pipe) == usb_pipein(pipe))
+			return 1;
+	return 0;
+}
+
+/* Maps the status of a retired qTD to USB_ST_* */
+static int ehci_td_status(uint32_t token)
+{
+	int status;
+
+	switch (QT_TOKEN_GET_STATUS(token) &
+		~(QT_TOKEN_STATUS_SPLITXSTATE | QT_TOKEN_STATUS_PERR)) {
+	case 0:
+		return 0;
+	case QT_TOKEN_STATUS_HALTED:
+		return USB_ST_STALLED;
+	case QT_TOKEN_STATUS_ACTIVE | QT_TOKEN_STATUS_DATBUFERR:
+	case QT_TOKEN_STATUS_DATBUFERR:
+		return USB_ST_BUF_ERR;
+	case QT_TOKEN_STATUS_HALTED | QT_TOKEN_STATUS_BABBLEDET:
+	case QT_TOKEN_STATUS_BABBLEDET:
+		return USB_ST_BABBLE_DET;
+	default:
+		status = USB_ST_CRC_ERR;
+		if (QT_TOKEN_GET_STATUS(token) & QT_TOKEN_STATUS_HALTED)
+			status |= USB_ST_STALLED;
+		return status;
+	}
+}
+
 static int
 ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
 		   int length, struct devrequest *req)
 {
-	ALLOC_ALIGN_BUFFER(struct QH, qh, 1, USB_DMA_MINALIGN);
+	struct QH *qh;
 	struct qTD *qtd;
 	int qtd_count = 0;
 	int qtd_counter = 0;
+	int data_first, data_last;
 	volatile struct qTD *vtd;
 	unsigned long ts;
 	uint32_t *tdp;
-	uint32_t endpt, maxpacket, token, usbsts;
+	uint32_t endpt1, endpt2, maxpacket, token, first;
 	uint32_t c, toggle;
-	uint32_t cmd;
 	int timeout;
 	int ret = 0;
 	struct ehci_ctrl *ctrl = dev->controller;
@@ -300,6 +496,12 @@ ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
 		      le16_to_cpu(req->value), le16_to_cpu(req->value),
 		      le16_to_cpu(req->index));
 
+	if (usb_pipetype(pipe) == PIPE_BULK && ehci_bulk_queued(ctrl, pipe)) {
+		printf("EHCI: endpoint %lu has a bulk queue\n",
+		       usb_pipeendpoint(pipe));
+		return -1;
+	}
+
 #define PKT_ALIGN	512
 	/*
 	 * The USB transfer is split into qTD transfers. Eeach qTD transfer is
@@ -365,38 +567,37 @@ ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
 		return -1;
 	}
 
-	memset(qh, 0, sizeof(struct QH));
 	memset(qtd, 0, qtd_count * sizeof(*qtd));
 
 	toggle = usb_gettoggle(dev, usb_pipeendpoint(pipe), usb_pipeout(pipe));
 
 	/*
-	 * Setup QH (3.6 in ehci-r10.pdf)
+	 * Find the QH of the endpoint (3.6 in ehci-r10.pdf)
 	 *
-	 *   qh_link ................. 03-00 H
 	 *   qh_endpt1 ............... 07-04 H
 	 *   qh_endpt2 ............... 0B-08 H
-	 * - qh_curtd
-	 *   qh_overlay.qt_next ...... 13-10 H
-	 * - qh_overlay.qt_altnext
+	 *
+	 * Control endpoints use a single QH for both directions.
 	 */
-	qh->qh_link = cpu_to_hc32((uint32_t)&ctrl->qh_list | QH_LINK_TYPE_QH);
 	c = (dev->speed != USB_SPEED_HIGH) && !usb_pipeendpoint(pipe);
 	maxpacket = usb_maxpacket(dev, pipe);
-	endpt = QH_ENDPT1_RL(8) | QH_ENDPT1_C(c) |
+	endpt1 = QH_ENDPT1_RL(8) | QH_ENDPT1_C(c) |
 		QH_ENDPT1_MAXPKTLEN(maxpacket) | QH_ENDPT1_H(0) |
 		QH_ENDPT1_DTC(QH_ENDPT1_DTC_DT_FROM_QTD) |
 		QH_ENDPT1_EPS(ehci_encode_speed(dev->speed)) |
 		QH_ENDPT1_ENDPT(usb_pipeendpoint(pipe)) | QH_ENDPT1_I(0) |
 		QH_ENDPT1_DEVADDR(usb_pipedevice(pipe));
-	qh->qh_endpt1 = cpu_to_hc32(endpt);
-	endpt = QH_ENDPT2_MULT(1) | QH_ENDPT2_PORTNUM(dev->portnr) |
+	endpt2 = QH_ENDPT2_MULT(1) | QH_ENDPT2_PORTNUM(dev->portnr) |
 		QH_ENDPT2_HUBADDR(dev->parent->devnum) |
 		QH_ENDPT2_UFCMASK(0) | QH_ENDPT2_UFSMASK(0);
-	qh->qh_endpt2 = cpu_to_hc32(endpt);
-	qh->qh_overlay.qt_next = cpu_to_hc32(QT_NEXT_TERMINATE);
+	qh = ehci_get_qh(ctrl, endpt1, endpt2,
+			 usb_pipetype(pipe) != PIPE_CONTROL &&
+			 usb_pipeout(pipe));
+	if (qh == NULL)
+		goto fail;
 
-	tdp = &qh->qh_overlay.qt_next;
+	first = cpu_to_hc32(QT_NEXT_TERMINATE);
+	tdp = &first;
 
 	if (req != NULL) {
 		/*
@@ -425,6 +626,7 @@ ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
 		toggle = 1;
 	}
 
+	data_first = qtd_counter;
 	if (length > 0 || req == NULL) {
 		uint8_t *buf_ptr = buffer;
 		int left_length = length;
@@ -492,6 +694,7 @@ ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
 			left_length -= xfr_bytes;
 		} while (left_length > 0);
 	}
+	data_last = qtd_counter;
 
 	if (req != NULL) {
 		/*
@@ -514,32 +717,24 @@ ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
 		tdp = &qtd[qtd_counter++].qt_next;
 	}
 
-	ctrl->qh_list.qh_link = cpu_to_hc32((uint32_t)qh | QH_LINK_TYPE_QH);
-
 	/* Flush dcache */
-	flush_dcache_range((uint32_t)&ctrl->qh_list,
-		ALIGN_END_ADDR(struct QH, &ctrl->qh_list, 1));
-	flush_dcache_range((uint32_t)qh, ALIGN_END_ADDR(struct QH, qh, 1));
 	flush_dcache_range((uint32_t)qtd,
 			   ALIGN_END_ADDR(struct qTD, qtd, qtd_count));
 
-	/* Set async. queue head pointer. */
-	ehci_writel(&ctrl->hcor->or_asynclistaddr, (uint32_t)&ctrl->qh_list);
-
-	usbsts = ehci_readl(&ctrl->hcor->or_usbsts);
-	ehci_writel(&ctrl->hcor->or_usbsts, (usbsts & 0x3f));
-
-	/* Enable async. schedule. */
-	cmd = ehci_readl(&ctrl->hcor->or_usbcmd);
-	cmd |= CMD_ASE;
-	ehci_writel(&ctrl->hcor->or_usbcmd, cmd);
+	/*
+	 * Hand the qTDs to the QH, which is idle: the controller picks them
+	 * up the next time it visits the QH. Clearing the token also clears
+	 * a halt left by the previous transfer.
+	 */
+	qh->qh_overlay.qt_next = first;
+	qh->qh_overlay.qt_altnext = cpu_to_hc32(QT_NEXT_TERMINATE);
+	qh->qh_overlay.qt_token = 0;
+	flush_dcache_range((uint32_t)qh, ALIGN_END_ADDR(struct QH, qh, 1));
 
-	ret = handshake((uint32_t *)&ctrl->hcor->or_usbsts, STS_ASS, STS_ASS,
-			100 * 1000);
-	if (ret < 0) {
-		printf("EHCI fail timeout STS_ASS set\n");
-		goto fail;
-	}
+	/* Enable async. schedule, it stays on between transfers. */
+	ret = ehci_enable_async(ctrl, 1);
+	if (ret < 0)
+		goto idle;
 
 	/* Wait for TDs to be processed. */
 	ts = get_timer(0);
@@ -550,8 +745,6 @@ ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
 		timeout = USB_TIMEOUT_MS(pipe);
 	do {
 		/* Invalidate dcache */
-		invalidate_dcache_range((uint32_t)&ctrl->qh_list,
-			ALIGN_END_ADDR(struct QH, &ctrl->qh_list, 1));
 		invalidate_dcache_range((uint32_t)qh,
 			ALIGN_END_ADDR(struct QH, qh, 1));
 		invalidate_dcache_range((uint32_t)qtd,
@@ -560,6 +753,10 @@ ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
 		token = hc32_to_cpu(vtd->qt_token);
 		if (!(QT_TOKEN_GET_STATUS(token) & QT_TOKEN_STATUS_ACTIVE))
 			break;
+		/* A halted QH does not get to the last qTD */
+		token = hc32_to_cpu(qh->qh_overlay.qt_token);
+		if (QT_TOKEN_GET_STATUS(token) & QT_TOKEN_STATUS_HALTED)
+			break;
 		WATCHDOG_RESET();
 	} while (get_timer(ts) < timeout);
 
@@ -575,51 +772,31 @@ ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
 	invalidate_dcache_range((uint32_t)buffer,
 		ALIGN((uint32_t)buffer + length, ARCH_DMA_MINALIGN));
 
-	/* Check that the TD processing happened */
-	if (QT_TOKEN_GET_STATUS(token) & QT_TOKEN_STATUS_ACTIVE)
+	/*
+	 * Check that the TD processing happened. If it did not, stop the
+	 * schedule so that the controller lets go of the qTDs before they
+	 * are freed.
+	 */
+	if (QT_TOKEN_GET_STATUS(token) & QT_TOKEN_STATUS_ACTIVE) {
 		debug("EHCI timed out on TD - token=%#x\n", token);
-
-	/* Disable async schedule. */
-	cmd = ehci_readl(&ctrl->hcor->or_usbcmd);
-	cmd &= ~CMD_ASE;
-	ehci_writel(&ctrl->hcor->or_usbcmd, cmd);
-
-	ret = handshake((uint32_t *)&ctrl->hcor->or_usbsts, STS_ASS, 0,
-			100 * 1000);
-	if (ret < 0) {
-		printf("EHCI fail timeout STS_ASS reset\n");
-		goto fail;
+		ehci_enable_async(ctrl, 0);
+		invalidate_dcache_range((uint32_t)qh,
+			ALIGN_END_ADDR(struct QH, qh, 1));
+		token = hc32_to_cpu(qh->qh_overlay.qt_token);
 	}
 
-	token = hc32_to_cpu(qh->qh_overlay.qt_token);
 	if (!(QT_TOKEN_GET_STATUS(token) & QT_TOKEN_STATUS_ACTIVE)) {
 		debug("TOKEN=%#x\n", token);
-		switch (QT_TOKEN_GET_STATUS(token) &
-			~(QT_TOKEN_STATUS_SPLITXSTATE | QT_TOKEN_STATUS_PERR)) {
-		case 0:
+		dev->status = ehci_td_status(token);
+		if (dev->status == 0) {
 			toggle = QT_TOKEN_GET_DT(token);
 			usb_settoggle(dev, usb_pipeendpoint(pipe),
 				       usb_pipeout(pipe), toggle);
-			dev->status = 0;
-			break;
-		case QT_TOKEN_STATUS_HALTED:
-			dev->status = USB_ST_STALLED;
-			break;
-		case QT_TOKEN_STATUS_ACTIVE | QT_TOKEN_STATUS_DATBUFERR:
-		case QT_TOKEN_STATUS_DATBUFERR:
-			dev->status = USB_ST_BUF_ERR;
-			break;
-		case QT_TOKEN_STATUS_HALTED | QT_TOKEN_STATUS_BABBLEDET:
-		case QT_TOKEN_STATUS_BABBLEDET:
-			dev->status = USB_ST_BABBLE_DET;
-			break;
-		default:
-			dev->status = USB_ST_CRC_ERR;
-			if (QT_TOKEN_GET_STATUS(token) & QT_TOKEN_STATUS_HALTED)
-				dev->status |= USB_ST_STALLED;
-			break;
 		}
-		dev->act_len = length - QT_TOKEN_GET_TOTALBYTES(token);
+		dev->act_len = length;
+		for (c = data_first; c < data_last; c++)
+			dev->act_len -= QT_TOKEN_GET_TOTALBYTES(
+					hc32_to_cpu(qtd[c].qt_token));
 	} else {
 		dev->act_len = 0;
 #ifndef CONFIG_USB_EHCI_FARADAY
@@ -628,6 +805,18 @@ ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
 		      ehci_readl(&ctrl->hcor->or_portsc[0]),
 		      ehci_readl(&ctrl->hcor->or_portsc[1]));
 #endif
+		ret = -1;
+	}
+
+idle:
+	if (ret < 0) {
+		/* Leave the QH idle, without the qTDs */
+		qh->qh_overlay.qt_next = cpu_to_hc32(QT_NEXT_TERMINATE);
+		qh->qh_overlay.qt_token = 0;
+		flush_dcache_range((uint32_t)qh,
+				   ALIGN_END_ADDR(struct QH, qh, 1));
+		free(qtd);
+		return -1;
 	}
 
 	free(qtd);
@@ -967,6 +1156,11 @@ int usb_lowlevel_init(int index, void **controller)
 	/* Set async. queue head pointer. */
 	ehci_writel(&ehcic[index].hcor->or_asynclistaddr, (uint32_t)qh_list);
 
+	/* No endpoint has a QH in the fresh list */
+	memset(ehcic[index].async_ep, 0, sizeof(ehcic[index].async_ep));
+	ehcic[index].async_seq = 0;
+	ehcic[index].bulk_queues = NULL;
+
 	/*
 	 * Set up periodic list
 	 * Step 1: Parent QH for all periodic transfers.
@@ -1390,3 +1584,186 @@ submit_int_msg(struct usb_device *dev, unsigned long pipe, void *buffer,
 	/* everything worked out fine */
 	return result;
 }
+
+static void bulk_queue_arm(struct bulk_queue *queue, int i)
+{
+	struct qTD *td = queue->tds + i;
+
+	ehci_td_buffer(td, queue->buffer + i * queue->elementsize,
+		       queue->elementsize);
+	td->qt_token = cpu_to_hc32(QT_TOKEN_TOTALBYTES(queue->elementsize) |
+			QT_TOKEN_CERR(3) | QT_TOKEN_PID(QT_TOKEN_PID_IN) |
+			QT_TOKEN_STATUS(QT_TOKEN_STATUS_ACTIVE));
+	flush_dcache_range((uint32_t)td, ALIGN_END_ADDR(struct qTD, td, 1));
+}
+
+/*
+ * Keeps queuesize IN transfers of elementsize bytes each queued on a bulk
+ * endpoint, so that the device can go on sending while the caller is busy
+ * with data received earlier. buffer holds the elements back to back.
+ * The qTDs form a ring: the controller stops at the first one that has
+ * not been handed back yet by the next poll_bulk_queue() call.
+ */
+struct bulk_queue *
+create_bulk_queue(struct usb_device *dev, unsigned long pipe, int queuesize,
+		  int elementsize, void *buffer)
+{
+	struct ehci_ctrl *ctrl = dev->controller;
+	struct bulk_queue *result;
+	uint32_t endpt1, endpt2;
+	int i;
+
+	if (usb_pipetype(pipe) != PIPE_BULK || !usb_pipein(pipe)) {
+		debug("not a bulk in pipe (type=%lu)\n", usb_pipetype(pipe));
+		return NULL;
+	}
+
+	if (ehci_bulk_queued(ctrl, pipe)) {
+		debug("endpoint already has a bulk queue\n");
+		return NULL;
+	}
+
+	/* Every element has to fit a single TD, whatever its alignment */
+	if (queuesize < 2 || elementsize > 16384 ||
+	    elementsize % USB_DMA_MINALIGN ||
+	    (uint32_t)buffer % USB_DMA_MINALIGN) {
+		debug("unsupported bulk queue layout\n");
+		return NULL;
+	}
+
+	result = malloc(sizeof(*result));
+	if (!result)
+		return NULL;
+	result->qh = memalign(USB_DMA_MINALIGN, sizeof(struct QH));
+	result->tds = memalign(USB_DMA_MINALIGN,
+			       sizeof(struct qTD) * queuesize);
+	if (!result->qh || !result->tds) {
+		debug("ehci bulk queue: out of memory\n");
+		goto fail;
+	}
+	memset(result->tds, 0, sizeof(struct qTD) * queuesize);
+	result->buffer = buffer;
+	result->queuesize = queuesize;
+	result->elementsize = elementsize;
+	result->next = 0;
+	result->held = -1;
+	result->pipe = pipe;
+
+	for (i = 0; i < queuesize; i++) {
+		struct qTD *td = result->tds + i;
+
+		td->qt_next = cpu_to_hc32((uint32_t)(result->tds +
+						     (i + 1) % queuesize));
+		td->qt_altnext = cpu_to_hc32(QT_NEXT_TERMINATE);
+		bulk_queue_arm(result, i);
+	}
+
+	/* The toggle lives in the QH, the qTDs are reused as they are */
+	endpt1 = QH_ENDPT1_RL(8) | QH_ENDPT1_C(0) |
+		QH_ENDPT1_MAXPKTLEN(usb_maxpacket(dev, pipe)) |
+		QH_ENDPT1_H(0) | QH_ENDPT1_DTC(QH_ENDPT1_DTC_IGNORE_QTD_TD) |
+		QH_ENDPT1_EPS(ehci_encode_speed(dev->speed)) |
+		QH_ENDPT1_ENDPT(usb_pipeendpoint(pipe)) | QH_ENDPT1_I(0) |
+		QH_ENDPT1_DEVADDR(usb_pipedevice(pipe));
+	endpt2 = QH_ENDPT2_MULT(1) | QH_ENDPT2_PORTNUM(dev->portnr) |
+		QH_ENDPT2_HUBADDR(dev->parent->devnum) |
+		QH_ENDPT2_UFCMASK(0) | QH_ENDPT2_UFSMASK(0);
+	/* The queue's QH replaces the one single transfers used */
+	if (ehci_drop_qh(ctrl, endpt1, 0) < 0)
+		goto fail;
+	ehci_link_qh(ctrl, result->qh, endpt1, endpt2);
+
+	result->qh->qh_overlay.qt_next = cpu_to_hc32((uint32_t)result->tds);
+	result->qh->qh_overlay.qt_token = cpu_to_hc32(QT_TOKEN_DT(
+			usb_gettoggle(dev, usb_pipeendpoint(pipe), 0)));
+	flush_dcache_range((uint32_t)result->qh,
+			   ALIGN_END_ADDR(struct QH, result->qh, 1));
+
+	if (ehci_enable_async(ctrl, 1) < 0) {
+		ehci_unlink_qh(ctrl, result->qh);
+		goto fail;
+	}
+
+	result->next_queue = ctrl->bulk_queues;
+	ctrl->bulk_queues = result;
+	return result;
+fail:
+	free(result->tds);
+	free(result->qh);
+	free(result);
+	return NULL;
+}
+
+/*
+ * Returns the next element the device has filled and stores its length
+ * in *len, or NULL if there is none yet. The element belongs to the
+ * caller until the next call, which queues it again. If the endpoint
+ * halted, dev->status tells why and the queue has to be destroyed.
+ */
+void *poll_bulk_queue(struct usb_device *dev, struct bulk_queue *queue,
+		      int *len)
+{
+	struct qTD *td = queue->tds + queue->next;
+	void *buf;
+	uint32_t token;
+
+	if (queue->held >= 0) {
+		bulk_queue_arm(queue, queue->held);
+		queue->held = -1;
+	}
+
+	invalidate_dcache_range((uint32_t)td,
+				ALIGN_END_ADDR(struct qTD, td, 1));
+	token = hc32_to_cpu(td->qt_token);
+	if (QT_TOKEN_GET_STATUS(token) & QT_TOKEN_STATUS_ACTIVE) {
+		/* A halted QH leaves its current qTD active */
+		invalidate_dcache_range((uint32_t)queue->qh,
+			ALIGN_END_ADDR(struct QH, queue->qh, 1));
+		token = hc32_to_cpu(queue->qh->qh_overlay.qt_token);
+		if (QT_TOKEN_GET_STATUS(token) & QT_TOKEN_STATUS_HALTED)
+			dev->status = ehci_td_status(token);
+		return NULL;
+	}
+
+	dev->status = ehci_td_status(token);
+	if (dev->status)
+		return NULL;
+
+	buf = queue->buffer + queue->next * queue->elementsize;
+	*len = queue->elementsize - QT_TOKEN_GET_TOTALBYTES(token);
+	invalidate_dcache_range((uint32_t)buf,
+				ALIGN((uint32_t)buf + *len, ARCH_DMA_MINALIGN));
+
+	queue->held = queue->next;
+	queue->next = (queue->next + 1) % queue->queuesize;
+	return buf;
+}
+
+/* The buffer is the caller's, as for interrupt queues */
+int destroy_bulk_queue(struct usb_device *dev, struct bulk_queue *queue)
+{
+	struct ehci_ctrl *ctrl = dev->controller;
+	struct bulk_queue **pq;
+	uint32_t token;
+	int ret;
+
+	for (pq = &ctrl->bulk_queues; *pq; pq = &(*pq)->next_queue)
+		if (*pq == queue) {
+			*pq = queue->next_queue;
+			break;
+		}
+
+	ret = ehci_unlink_qh(ctrl, queue->qh);
+	if (ret == 0) {
+		invalidate_dcache_range((uint32_t)queue->qh,
+			ALIGN_END_ADDR(struct QH, queue->qh, 1));
+		token = hc32_to_cpu(queue->qh->qh_overlay.qt_token);
+		usb_settoggle(dev, usb_pipeendpoint(queue->pipe), 0,
+			      QT_TOKEN_GET_DT(token));
+	}
+
+	free(queue->tds);
+	free(queue->qh);
+	free(queue);
+	return ret;
+}
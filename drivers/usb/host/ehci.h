@@ -65,7 +65,7 @@ struct ehci_hcor {
 #define CMD_PARK_CNT(c)	(((c) >> 8) & 3)	/* how many transfers to park */
 #define CMD_ASE		(1 << 5)		/* async schedule enable */
 #define CMD_LRESET	(1 << 7)		/* partial reset */
-#define CMD_IAAD	(1 << 5)		/* "doorbell" interrupt */
+#define CMD_IAAD	(1 << 6)		/* "doorbell" interrupt */
 #define CMD_PSE		(1 << 4)		/* periodic schedule enable */
 #define CMD_RESET	(1 << 1)		/* reset HC not bus */
 #define CMD_RUN		(1 << 0)		/* start/stop HC */
@@ -73,6 +73,7 @@ struct ehci_hcor {
 #define STS_ASS		(1 << 15)
 #define	STS_PSS		(1 << 14)
 #define STS_HALT	(1 << 12)
+#define STS_IAA		(1 << 5)
 	uint32_t or_usbintr;
 #define INTR_UE         (1 << 0)                /* USB interrupt enable */
 #define INTR_UEE        (1 << 1)                /* USB error interrupt enable */
@@ -254,6 +255,25 @@ struct QH {
 	};
 };
 
+/*
+ * Async QHs stay linked into the schedule between transfers, one per
+ * endpoint and direction, so that a transfer only has to queue its qTDs.
+ * An endpoint with a bulk queue has the queue's QH instead.
+ */
+#define EHCI_ASYNC_QHS		8
+
+/* A QH taking up whole cache lines, so that flushing it leaves others alone */
+struct ehci_async_qh {
+	struct QH qh;
+} __aligned(USB_DMA_MINALIGN);
+
+struct ehci_async_ep {
+	uint32_t endpt1;	/* QH endpoint characteristics, 0 if unused */
+	uint32_t endpt2;
+	int out;
+	unsigned int last;	/* last use, for recycling */
+};
+
 struct ehci_ctrl {
 	struct ehci_hccr *hccr;	/* R/O registers, not need for volatile */
 	struct ehci_hcor *hcor;
@@ -263,6 +283,10 @@ struct ehci_ctrl {
 	struct QH periodic_queue __aligned(USB_DMA_MINALIGN);
 	uint32_t *periodic_list;
 	int ntds;
+	struct ehci_async_qh async_qh[EHCI_ASYNC_QHS];
+	struct ehci_async_ep async_ep[EHCI_ASYNC_QHS];
+	unsigned int async_seq;
+	struct bulk_queue *bulk_queues;	/* each owns its endpoint */
 };
 
 /* Low level init functions */
@@ -0,0 +1,166 @@
+/*
+ * Directory name cache for the filesystem drivers
+ *
+ * See file CREDITS for list of people who contributed to this
+ * project.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ */
+
+#include <common.h>
+#include <malloc.h>
+#include <dircache.h>
+
+struct dircache_ent {
+	struct dircache_ent *next;	/* hash chain */
+	ulong dir;
+	unsigned int hash;
+	short namelen;
+	short len;			/* record length, -1: no such name */
+	char data[0];			/* record, then the name */
+};
+
+static unsigned int dircache_hash(ulong dir, const char *name, int namelen)
+{
+	unsigned int hash = dir * 0x9e3779b9;
+
+	while (namelen--)
+		hash = hash * 31 + (unsigned char)*name++;
+	return hash;
+}
+
+static struct dircache_ent **dircache_head(struct dircache *dc,
+					   unsigned int hash)
+{
+	return &dc->hash[(hash ^ (hash >> 16)) & (DIRCACHE_HASH_SIZE - 1)];
+}
+
+static struct dircache_ent *dircache_find(struct dircache *dc, ulong dir,
+					  const char *name, int namelen)
+{
+	unsigned int hash = dircache_hash(dir, name, namelen);
+	struct dircache_ent *ent;
+
+	for (ent = *dircache_head(dc, hash); ent; ent = ent->next) {
+		if (ent->hash == hash && ent->dir == dir &&
+		    ent->namelen == namelen &&
+		    !memcmp(ent->data + (ent->len > 0 ? ent->len : 0), name,
+			    namelen))
+			return ent;
+	}
+	return NULL;
+}
+
+void dircache_flush(struct dircache *dc)
+{
+	struct dircache_ent *ent, *next;
+	int i;
+
+	for (i = 0; i < DIRCACHE_HASH_SIZE; i++) {
+		for (ent = dc->hash[i]; ent; ent = next) {
+			next = ent->next;
+			free(ent);
+		}
+		dc->hash[i] = NULL;
+	}
+	dc->ndone = 0;
+	dc->full = 0;
+	dc->size = 0;
+}
+
+/*
+ * Add name (namelen bytes, need not be terminated) in directory dir
+ * with the len bytes at rec, or as not existing if rec is NULL. The
+ * first record added for a name is kept. Returns 0 on success, -1 if
+ * the cache is full.
+ */
+int dircache_add(struct dircache *dc, ulong dir, const char *name,
+		 int namelen, const void *rec, int len)
+{
+	struct dircache_ent *ent, **head;
+	unsigned int size;
+
+	if (dc->full)
+		return -1;
+	if (dircache_find(dc, dir, name, namelen))
+		return 0;
+
+	if (!rec)
+		len = 0;
+	size = sizeof(*ent) + len + namelen;
+	if (dc->size + size > CONFIG_FS_DIRCACHE_SIZE)
+		goto full;
+	ent = malloc(size);
+	if (!ent)
+		goto full;
+
+	ent->dir = dir;
+	ent->hash = dircache_hash(dir, name, namelen);
+	ent->namelen = namelen;
+	ent->len = rec ? len : -1;
+	memcpy(ent->data, rec, len);
+	memcpy(ent->data + len, name, namelen);
+
+	head = dircache_head(dc, ent->hash);
+	ent->next = *head;
+	*head = ent;
+	dc->size += size;
+	return 0;
+
+full:
+	debug("%s: directory cache full\n", __func__);
+	dc->full = 1;
+	return -1;
+}
+
+/*
+ * Note that every name in directory dir has been added. Returns 0 on
+ * success, -1 if the cache is full or tracks too many directories.
+ */
+int dircache_done(struct dircache *dc, ulong dir)
+{
+	if (dc->full || dc->ndone == DIRCACHE_MAX_DIRS)
+		return -1;
+	dc->done[dc->ndone++] = dir;
+	return 0;
+}
+
+/*
+ * Look name up in directory dir. Returns 1 and copies the record,
+ * which must be len bytes long, to rec if it is known, 0 if the name
+ * does not exist and -1 if the directory has to be searched.
+ */
+int dircache_lookup(struct dircache *dc, ulong dir, const char *name,
+		    void *rec, int len)
+{
+	struct dircache_ent *ent;
+	int i;
+
+	ent = dircache_find(dc, dir, name, strlen(name));
+	if (ent) {
+		if (ent->len < 0)
+			return 0;
+		if (ent->len != len)
+			return -1;
+		memcpy(rec, ent->data, len);
+		return 1;
+	}
+
+	for (i = 0; i < dc->ndone; i++)
+		if (dc->done[i] == dir)
+			return 0;
+	return -1;
+}
@@ -27,6 +27,7 @@
 #include <linux/stat.h>
 #include <linux/time.h>
 #include <asm/byteorder.h>
+#include <dircache.h>
 #include "ext4_common.h"
 
 extern disk_partition_t *part_info;
@@ -46,6 +47,43 @@ int ext4fs_indir3_blkno = -1;
 struct ext2_inode *g_parent_inode;
 static int symlinknest;
 
+/* Set while ext4fs_readdir() lists a directory instead of printing it */
+fs_dir_func *ext4fs_readdir_func;
+void *ext4fs_readdir_priv;
+
+/*
+ * Extent tree blocks read last, one per level below the root in the
+ * inode, so that looking up the next extent of a file does not read
+ * the same index and leaf blocks again. 0 means nothing cached.
+ */
+#define EXT4_EXT_MAX_DEPTH	5
+static char *ext4fs_ext_block[EXT4_EXT_MAX_DEPTH];
+static lbaint_t ext4fs_ext_blkno[EXT4_EXT_MAX_DEPTH];
+
+static void ext4fs_ext_cache_invalidate(void)
+{
+	int i;
+
+	for (i = 0; i < EXT4_EXT_MAX_DEPTH; i++)
+		ext4fs_ext_blkno[i] = 0;
+}
+
+static void ext4fs_ext_cache_free(void)
+{
+	int i;
+
+	for (i = 0; i < EXT4_EXT_MAX_DEPTH; i++) {
+		free(ext4fs_ext_block[i]);
+		ext4fs_ext_block[i] = NULL;
+		ext4fs_ext_blkno[i] = 0;
+	}
+}
+
+#ifdef CONFIG_FS_DIRCACHE
+/* Names looked up since ext4fs_mount(), keyed by directory inode */
+static struct dircache ext4fs_dircache;
+#endif
+
 #if defined(CONFIG_EXT4_WRITE)
 uint32_t ext4fs_div_roundup(uint32_t size, uint32_t n)
 {
@@ -72,6 +110,12 @@ void put_ext4(uint64_t off, void *buf, uint32_t size)
 	if (fs->dev_desc == NULL)
 		return;
 
+	/* the blocks written may have held part of an extent tree */
+	ext4fs_ext_cache_invalidate();
+#ifdef CONFIG_FS_DIRCACHE
+	dircache_flush(&ext4fs_dircache);
+#endif
+
 	if ((startblock + (size >> log2blksz)) >
 	    (part_offset + fs->total_sect)) {
 		printf("part_offset is " LBAFU "\n", part_offset);
@@ -1410,13 +1454,14 @@ void ext4fs_allocate_blocks(struct ext2_inode *file_inode,
 #endif
 
 static struct ext4_extent_header *ext4fs_get_extent_block
-	(struct ext2_data *data, char *buf,
-		struct ext4_extent_header *ext_block,
+	(struct ext2_data *data, struct ext4_extent_header *ext_block,
 		uint32_t fileblock, int log2_blksz)
 {
 	struct ext4_extent_idx *index;
 	unsigned long long block;
-	struct ext_filesystem *fs = get_fs();
+	lbaint_t blkno;
+	int blksz = EXT2_BLOCK_SIZE(data);
+	int level = 0;
 	int i;
 
 	while (1) {
@@ -1427,27 +1472,110 @@ static struct ext4_extent_header *ext4fs_get_extent_block
 
 		if (ext_block->eh_depth == 0)
 			return ext_block;
+		if (level >= EXT4_EXT_MAX_DEPTH)
+			return 0;
 		i = -1;
 		do {
 			i++;
 			if (i >= le16_to_cpu(ext_block->eh_entries))
 				break;
-		} while (fileblock > le32_to_cpu(index[i].ei_block));
+		} while (fileblock >= le32_to_cpu(index[i].ei_block));
 
 		if (--i < 0)
 			return 0;
 
 		block = le16_to_cpu(index[i].ei_leaf_hi);
 		block = (block << 32) + le32_to_cpu(index[i].ei_leaf_lo);
+		blkno = (lbaint_t)block << log2_blksz;
 
-		if (ext4fs_devread((lbaint_t)block << log2_blksz, 0, fs->blksz,
-				   buf))
-			ext_block = (struct ext4_extent_header *)buf;
-		else
-			return 0;
+		if (ext4fs_ext_block[level] == NULL) {
+			ext4fs_ext_block[level] = zalloc(blksz);
+			if (ext4fs_ext_block[level] == NULL)
+				return 0;
+		}
+		if (ext4fs_ext_blkno[level] != blkno) {
+			ext4fs_ext_blkno[level] = 0;
+			if (!ext4fs_devread(blkno, 0, blksz,
+					    ext4fs_ext_block[level]))
+				return 0;
+			ext4fs_ext_blkno[level] = blkno;
+		}
+		ext_block = (struct ext4_extent_header *)
+				ext4fs_ext_block[level];
+		level++;
 	}
 }
 
+/*
+ * Look up file block 'fileblock' of an extent mapped inode. On success
+ * *first and *len describe the run of file blocks around it that map
+ * to consecutive filesystem blocks starting at *start, or that are all
+ * a hole (*start is 0 then).
+ */
+static int ext4fs_find_extent(struct ext2_inode *inode, uint32_t fileblock,
+			      uint32_t *first, uint32_t *len, uint64_t *start)
+{
+	struct ext4_extent_header *root, *ext_block;
+	struct ext4_extent *extent;
+	uint32_t ee_block, ee_len;
+	int log2_blksz;
+	int entries;
+	int i = -1;
+
+	log2_blksz = LOG2_BLOCK_SIZE(ext4fs_root)
+		- get_fs()->dev_desc->log2blksz;
+	root = (struct ext4_extent_header *)inode->b.blocks.dir_blocks;
+
+	ext_block = ext4fs_get_extent_block(ext4fs_root, root, fileblock,
+					    log2_blksz);
+	if (!ext_block) {
+		printf("invalid extent block\n");
+		return -EINVAL;
+	}
+
+	extent = (struct ext4_extent *)(ext_block + 1);
+	entries = le16_to_cpu(ext_block->eh_entries);
+
+	do {
+		i++;
+		if (i >= entries)
+			break;
+	} while (fileblock >= le32_to_cpu(extent[i].ee_block));
+
+	/* hole up to the next extent, or the end of the file */
+	*first = fileblock;
+	*start = 0;
+	if (i < entries)
+		*len = le32_to_cpu(extent[i].ee_block) - fileblock;
+	else if (root->eh_depth == 0)
+		*len = ~0U - fileblock;
+	else
+		*len = 1;	/* the next extent may be in another leaf */
+
+	if (--i < 0)
+		return 0;
+
+	ee_block = le32_to_cpu(extent[i].ee_block);
+	ee_len = le16_to_cpu(extent[i].ee_len);
+	if (ee_len > EXT4_EXT_INIT_MAX_LEN) {
+		/* preallocated but not written, reads as zeroes */
+		ee_len -= EXT4_EXT_INIT_MAX_LEN;
+		if (fileblock - ee_block < ee_len) {
+			*first = ee_block;
+			*len = ee_len;
+		}
+		return 0;
+	}
+	if (fileblock - ee_block >= ee_len)
+		return 0;
+
+	*first = ee_block;
+	*len = ee_len;
+	*start = le16_to_cpu(extent[i].ee_start_hi);
+	*start = (*start << 32) + le32_to_cpu(extent[i].ee_start_lo);
+	return 0;
+}
+
 static int ext4fs_blockgroup
 	(struct ext2_data *data, int group, struct ext2_block_group *blkgrp)
 {
@@ -1517,47 +1645,13 @@ long int read_allocated_block(struct ext2_inode *inode, int fileblock)
 		- get_fs()->dev_desc->log2blksz;
 
 	if (le32_to_cpu(inode->flags) & EXT4_EXTENTS_FL) {
-		char *buf = zalloc(blksz);
-		if (!buf)
-			return -ENOMEM;
-		struct ext4_extent_header *ext_block;
-		struct ext4_extent *extent;
-		int i = -1;
-		ext_block =
-			ext4fs_get_extent_block(ext4fs_root, buf,
-						(struct ext4_extent_header *)
-						inode->b.blocks.dir_blocks,
-						fileblock, log2_blksz);
-		if (!ext_block) {
-			printf("invalid extent block\n");
-			free(buf);
-			return -EINVAL;
-		}
-
-		extent = (struct ext4_extent *)(ext_block + 1);
-
-		do {
-			i++;
-			if (i >= le16_to_cpu(ext_block->eh_entries))
-				break;
-		} while (fileblock >= le32_to_cpu(extent[i].ee_block));
-		if (--i >= 0) {
-			fileblock -= le32_to_cpu(extent[i].ee_block);
-			if (fileblock >= le16_to_cpu(extent[i].ee_len)) {
-				free(buf);
-				return 0;
-			}
+		uint32_t first, len;
 
-			start = le16_to_cpu(extent[i].ee_start_hi);
-			start = (start << 32) +
-					le32_to_cpu(extent[i].ee_start_lo);
-			free(buf);
-			return fileblock + start;
-		}
-
-		printf("Extent Error\n");
-		free(buf);
-		return -1;
+		if (ext4fs_find_extent(inode, fileblock, &first, &len, &start))
+			return -1;
+		if (!start)
+			return 0;
+		return start + (fileblock - first);
 	}
 
 	/* Direct blocks. */
@@ -1845,6 +1939,39 @@ long int read_allocated_block(struct ext2_inode *inode, int fileblock)
 	return blknr;
 }
 
+/*
+ * Map file block 'fileblock' of a node like read_allocated_block(), and
+ * return in *count how many blocks from there on map to consecutive
+ * filesystem blocks (or are all a hole). The extent found is kept in the
+ * node, so that a sequential read looks up each extent only once.
+ */
+long int ext4fs_map_blocks(struct ext2fs_node *node, uint32_t fileblock,
+			   uint32_t *count)
+{
+	struct ext2_inode *inode = &node->inode;
+	uint32_t offset;
+
+	if (!(le32_to_cpu(inode->flags) & EXT4_EXTENTS_FL)) {
+		*count = 1;
+		return read_allocated_block(inode, fileblock);
+	}
+
+	offset = fileblock - node->ext_first;
+	if (fileblock < node->ext_first || offset >= node->ext_len) {
+		if (ext4fs_find_extent(inode, fileblock, &node->ext_first,
+				       &node->ext_len, &node->ext_start)) {
+			node->ext_len = 0;
+			return -1;
+		}
+		offset = fileblock - node->ext_first;
+	}
+
+	*count = node->ext_len - offset;
+	if (!node->ext_start)
+		return 0;
+	return node->ext_start + offset;
+}
+
 void ext4fs_close(void)
 {
 	if ((ext4fs_file != NULL) && (ext4fs_root != NULL)) {
@@ -1873,13 +2000,205 @@ void ext4fs_close(void)
 		ext4fs_indir3_size = 0;
 		ext4fs_indir3_blkno = -1;
 	}
+	ext4fs_ext_cache_free();
+#ifdef CONFIG_FS_DIRCACHE
+	dircache_flush(&ext4fs_dircache);
+#endif
+}
+
+/*
+ * Allocate the node for inode 'ino', found in directory 'diro' with
+ * directory entry file type 'filetype', and work out its type from
+ * that or else from the inode. Returns NULL on error.
+ */
+static struct ext2fs_node *ext4fs_dirent_node(struct ext2fs_node *diro,
+					      uint32_t ino, int filetype,
+					      int *ftype)
+{
+	struct ext2fs_node *fdiro;
+	int type = FILETYPE_UNKNOWN;
+	int status;
+
+	fdiro = zalloc(sizeof(struct ext2fs_node));
+	if (!fdiro)
+		return NULL;
+
+	fdiro->data = diro->data;
+	fdiro->ino = ino;
+
+	if (filetype != FILETYPE_UNKNOWN) {
+		fdiro->inode_read = 0;
+
+		if (filetype == FILETYPE_DIRECTORY)
+			type = FILETYPE_DIRECTORY;
+		else if (filetype == FILETYPE_SYMLINK)
+			type = FILETYPE_SYMLINK;
+		else if (filetype == FILETYPE_REG)
+			type = FILETYPE_REG;
+	} else {
+		status = ext4fs_read_inode(diro->data, ino, &fdiro->inode);
+		if (status == 0) {
+			free(fdiro);
+			return NULL;
+		}
+		fdiro->inode_read = 1;
+
+		if ((__le16_to_cpu(fdiro->inode.mode) &
+		     FILETYPE_INO_MASK) == FILETYPE_INO_DIRECTORY)
+			type = FILETYPE_DIRECTORY;
+		else if ((__le16_to_cpu(fdiro->inode.mode) &
+			  FILETYPE_INO_MASK) == FILETYPE_INO_SYMLINK)
+			type = FILETYPE_SYMLINK;
+		else if ((__le16_to_cpu(fdiro->inode.mode) &
+			  FILETYPE_INO_MASK) == FILETYPE_INO_REG)
+			type = FILETYPE_REG;
+	}
+
+	*ftype = type;
+	return fdiro;
+}
+
+/* What a directory entry names, as kept in the name cache */
+struct ext4fs_dirrec {
+	uint32_t ino;
+	int filetype;
+};
+
+#ifdef CONFIG_FS_DIRCACHE
+/*
+ * Read the whole of directory 'diro' and add its names to
+ * ext4fs_dircache. Returns 0 on success, -1 otherwise.
+ */
+static int ext4fs_dircache_fill(struct ext2fs_node *diro)
+{
+	unsigned int size = __le32_to_cpu(diro->inode.size);
+	struct ext2_dirent *dirent;
+	struct ext4fs_dirrec rec;
+	unsigned int pos, len;
+	char *buf;
+	int ret = -1;
+
+	if (size == 0 || size > CONFIG_FS_DIRCACHE_SIZE)
+		return -1;
+	buf = zalloc(size);
+	if (!buf)
+		return -1;
+	if (ext4fs_read_file(diro, 0, size, buf) != size)
+		goto out;
+
+	for (pos = 0; pos + sizeof(*dirent) <= size; pos += len) {
+		dirent = (struct ext2_dirent *)(buf + pos);
+		len = __le16_to_cpu(dirent->direntlen);
+		if (len < sizeof(*dirent) || pos + len > size ||
+		    dirent->namelen > len - sizeof(*dirent))
+			goto out;
+		if (!dirent->inode || !dirent->namelen)
+			continue;
+
+		rec.ino = __le32_to_cpu(dirent->inode);
+		rec.filetype = dirent->filetype;
+		if (dircache_add(&ext4fs_dircache, diro->ino,
+				 (char *)(dirent + 1), dirent->namelen,
+				 &rec, sizeof(rec)))
+			goto out;
+	}
+	ret = dircache_done(&ext4fs_dircache, diro->ino);
+out:
+	free(buf);
+	return ret;
+}
+#endif
+
+/*
+ * Look 'name' up in directory 'diro' without going through it entry
+ * by entry: in the name cache, through the htree index or by reading
+ * the whole directory into the cache. Returns 1 and sets *fnode and
+ * *ftype if it was found, 0 if it does not exist and -1 if the
+ * directory has to be searched the slow way.
+ */
+static int ext4fs_lookup(struct ext2fs_node *diro, const char *name,
+			 struct ext2fs_node **fnode, int *ftype)
+{
+	struct ext4fs_dirrec rec;
+	int ret;
+
+#ifdef CONFIG_FS_DIRCACHE
+	ret = dircache_lookup(&ext4fs_dircache, diro->ino, name, &rec,
+			      sizeof(rec));
+	if (ret < 0) {
+		ret = ext4fs_htree_lookup(diro, name, &rec.ino,
+					  &rec.filetype);
+		if (ret >= 0)
+			dircache_add(&ext4fs_dircache, diro->ino, name,
+				     strlen(name), ret ? &rec : NULL,
+				     sizeof(rec));
+		else if (dircache_room(&ext4fs_dircache) &&
+			 ext4fs_dircache_fill(diro) == 0)
+			ret = dircache_lookup(&ext4fs_dircache, diro->ino,
+					      name, &rec, sizeof(rec));
+	}
+#else
+	ret = ext4fs_htree_lookup(diro, name, &rec.ino, &rec.filetype);
+#endif
+	if (ret <= 0)
+		return ret;
+
+	*fnode = ext4fs_dirent_node(diro, rec.ino, rec.filetype, ftype);
+	return *fnode ? 1 : 0;
+}
+
+/* Print one entry of a directory listing or hand it to ext4fs_readdir() */
+static void ext4fs_ls_entry(struct ext2fs_node *fdiro, const char *name,
+			    int type)
+{
+	struct fs_dirent dent;
+
+	if (ext4fs_readdir_func) {
+		dent.name = name;
+		switch (type) {
+		case FILETYPE_DIRECTORY:
+			dent.type = FS_DT_DIR;
+			break;
+		case FILETYPE_SYMLINK:
+			dent.type = FS_DT_LNK;
+			break;
+		case FILETYPE_REG:
+			dent.type = FS_DT_REG;
+			break;
+		default:
+			dent.type = FS_DT_UNKNOWN;
+			break;
+		}
+		dent.size = __le32_to_cpu(fdiro->inode.size);
+		dent.mtime = __le32_to_cpu(fdiro->inode.mtime);
+		ext4fs_readdir_func(ext4fs_readdir_priv, &dent);
+		return;
+	}
+
+	switch (type) {
+	case FILETYPE_DIRECTORY:
+		printf("<DIR> ");
+		break;
+	case FILETYPE_SYMLINK:
+		printf("<SYM> ");
+		break;
+	case FILETYPE_REG:
+		printf("      ");
+		break;
+	default:
+		printf("< ? > ");
+		break;
+	}
+	printf("%10d %s\n", __le32_to_cpu(fdiro->inode.size), name);
 }
 
 int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
 				struct ext2fs_node **fnode, int *ftype)
 {
 	unsigned int fpos = 0;
-	int status;
+	unsigned int blksz, blkpos, blklen = 0;
+	int status, ret = 0;
+	char *block;
 	struct ext2fs_node *diro = (struct ext2fs_node *) dir;
 
 #ifdef DEBUG
@@ -1891,71 +2210,56 @@ int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
 		if (status == 0)
 			return 0;
 	}
+	if ((name != NULL) && (fnode != NULL) && (ftype != NULL)) {
+		status = ext4fs_lookup(diro, name, fnode, ftype);
+		if (status >= 0)
+			return status;
+	}
+
+	/*
+	 * Directory entries never cross a block, so read the directory a
+	 * block at a time rather than each entry and name on its own.
+	 */
+	blksz = EXT2_BLOCK_SIZE(diro->data);
+	block = malloc(blksz);
+	if (!block)
+		return 0;
+	blkpos = blksz;
+
 	/* Search the file.  */
 	while (fpos < __le32_to_cpu(diro->inode.size)) {
-		struct ext2_dirent dirent;
+		struct ext2_dirent *dirent;
+		unsigned int off = fpos % blksz;
+
+		if (fpos - off != blkpos) {
+			blkpos = fpos - off;
+			blklen = min(blksz,
+				     __le32_to_cpu(diro->inode.size) - blkpos);
+			status = ext4fs_read_file(diro, blkpos, blklen, block);
+			if (status < 1)
+				goto out;
+		}
 
-		status = ext4fs_read_file(diro, fpos,
-					   sizeof(struct ext2_dirent),
-					   (char *) &dirent);
-		if (status < 1)
-			return 0;
+		dirent = (struct ext2_dirent *)(block + off);
+		if (off + sizeof(struct ext2_dirent) > blklen ||
+		    __le16_to_cpu(dirent->direntlen) == 0 ||
+		    off + sizeof(struct ext2_dirent) + dirent->namelen > blklen)
+			goto out;
 
-		if (dirent.namelen != 0) {
-			char filename[dirent.namelen + 1];
+		if (dirent->namelen != 0) {
+			char filename[dirent->namelen + 1];
 			struct ext2fs_node *fdiro;
-			int type = FILETYPE_UNKNOWN;
+			int type;
 
-			status = ext4fs_read_file(diro,
-						  fpos +
-						  sizeof(struct ext2_dirent),
-						  dirent.namelen, filename);
-			if (status < 1)
-				return 0;
+			memcpy(filename, dirent + 1, dirent->namelen);
 
-			fdiro = zalloc(sizeof(struct ext2fs_node));
+			fdiro = ext4fs_dirent_node(diro,
+						   __le32_to_cpu(dirent->inode),
+						   dirent->filetype, &type);
 			if (!fdiro)
-				return 0;
-
-			fdiro->data = diro->data;
-			fdiro->ino = __le32_to_cpu(dirent.inode);
-
-			filename[dirent.namelen] = '\0';
+				goto out;
 
-			if (dirent.filetype != FILETYPE_UNKNOWN) {
-				fdiro->inode_read = 0;
-
-				if (dirent.filetype == FILETYPE_DIRECTORY)
-					type = FILETYPE_DIRECTORY;
-				else if (dirent.filetype == FILETYPE_SYMLINK)
-					type = FILETYPE_SYMLINK;
-				else if (dirent.filetype == FILETYPE_REG)
-					type = FILETYPE_REG;
-			} else {
-				status = ext4fs_read_inode(diro->data,
-							   __le32_to_cpu
-							   (dirent.inode),
-							   &fdiro->inode);
-				if (status == 0) {
-					free(fdiro);
-					return 0;
-				}
-				fdiro->inode_read = 1;
-
-				if ((__le16_to_cpu(fdiro->inode.mode) &
-				     FILETYPE_INO_MASK) ==
-				    FILETYPE_INO_DIRECTORY) {
-					type = FILETYPE_DIRECTORY;
-				} else if ((__le16_to_cpu(fdiro->inode.mode)
-					    & FILETYPE_INO_MASK) ==
-					   FILETYPE_INO_SYMLINK) {
-					type = FILETYPE_SYMLINK;
-				} else if ((__le16_to_cpu(fdiro->inode.mode)
-					    & FILETYPE_INO_MASK) ==
-					   FILETYPE_INO_REG) {
-					type = FILETYPE_REG;
-				}
-			}
+			filename[dirent->namelen] = '\0';
 #ifdef DEBUG
 			printf("iterate >%s<\n", filename);
 #endif /* of DEBUG */
@@ -1964,43 +2268,30 @@ int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
 				if (strcmp(filename, name) == 0) {
 					*ftype = type;
 					*fnode = fdiro;
-					return 1;
+					ret = 1;
+					goto out;
 				}
 			} else {
 				if (fdiro->inode_read == 0) {
 					status = ext4fs_read_inode(diro->data,
 								 __le32_to_cpu(
-								 dirent.inode),
+								 dirent->inode),
 								 &fdiro->inode);
 					if (status == 0) {
 						free(fdiro);
-						return 0;
+						goto out;
 					}
 					fdiro->inode_read = 1;
 				}
-				switch (type) {
-				case FILETYPE_DIRECTORY:
-					printf("<DIR> ");
-					break;
-				case FILETYPE_SYMLINK:
-					printf("<SYM> ");
-					break;
-				case FILETYPE_REG:
-					printf("      ");
-					break;
-				default:
-					printf("< ? > ");
-					break;
-				}
-				printf("%10d %s\n",
-					__le32_to_cpu(fdiro->inode.size),
-					filename);
+				ext4fs_ls_entry(fdiro, filename, type);
 			}
 			free(fdiro);
 		}
-		fpos += __le16_to_cpu(dirent.direntlen);
+		fpos += __le16_to_cpu(dirent->direntlen);
 	}
-	return 0;
+out:
+	free(block);
+	return ret;
 }
 
 static char *ext4fs_read_symlink(struct ext2fs_node *node)
@@ -2167,7 +2458,10 @@ int ext4fs_open(const char *filename)
 	if (ext4fs_root == NULL)
 		return -1;
 
-	ext4fs_file = NULL;
+	if (ext4fs_file != NULL) {
+		ext4fs_free_node(ext4fs_file, &ext4fs_root->diropen);
+		ext4fs_file = NULL;
+	}
 	status = ext4fs_find_file(filename, &ext4fs_root->diropen, &fdiro,
 				  FILETYPE_REG);
 	if (status == 0)
@@ -2198,6 +2492,11 @@ int ext4fs_mount(unsigned part_length)
 	if (!data)
 		return 0;
 
+	ext4fs_ext_cache_free();
+#ifdef CONFIG_FS_DIRCACHE
+	dircache_flush(&ext4fs_dircache);
+#endif
+
 	/* Read the superblock. */
 	status = ext4_read_superblock((char *)&data->sblock);
 
@@ -0,0 +1,411 @@
+/*
+ * Name lookup through the htree index of ext3/ext4 directories
+ *
+ * The directory hash functions are taken from fs/ext4/hash.c in Linux,
+ * Copyright (C) 2002 by Theodore Ts'o.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <ext_common.h>
+#include <ext4fs.h>
+#include <malloc.h>
+#include <asm/byteorder.h>
+#include "ext4_common.h"
+
+#define DX_HASH_LEGACY		0
+#define DX_HASH_HALF_MD4	1
+#define DX_HASH_TEA		2
+
+#define EXT2_FLAGS_UNSIGNED_HASH	0x0002
+
+#define DX_MAX_LEVELS		3
+#define DX_ROOT_INFO_OFFSET	24	/* after the "." and ".." entries */
+#define DX_NODE_OFFSET		8	/* after an empty directory entry */
+
+struct dx_root_info {
+	uint32_t reserved_zero;
+	uint8_t hash_version;
+	uint8_t info_length;
+	uint8_t indirect_levels;
+	uint8_t unused_flags;
+};
+
+/* The first entry holds the limit and count instead of a hash */
+struct dx_entry {
+	uint32_t hash;
+	uint32_t block;
+};
+
+struct dx_countlimit {
+	uint16_t limit;
+	uint16_t count;
+};
+
+#define DELTA 0x9E3779B9
+
+static void tea_transform(uint32_t buf[4], uint32_t const in[])
+{
+	uint32_t sum = 0;
+	uint32_t b0 = buf[0], b1 = buf[1];
+	uint32_t a = in[0], b = in[1], c = in[2], d = in[3];
+	int n = 16;
+
+	do {
+		sum += DELTA;
+		b0 += ((b1 << 4) + a) ^ (b1 + sum) ^ ((b1 >> 5) + b);
+		b1 += ((b0 << 4) + c) ^ (b0 + sum) ^ ((b0 >> 5) + d);
+	} while (--n);
+
+	buf[0] += b0;
+	buf[1] += b1;
+}
+
+#define F(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))
+#define G(x, y, z) (((x) & (y)) + (((x) ^ (y)) & (z)))
+#define H(x, y, z) ((x) ^ (y) ^ (z))
+
+#define ROUND(f, a, b, c, d, x, s) \
+	(a += f(b, c, d) + x, a = (a << s) | (a >> (32 - s)))
+#define K1 0
+#define K2 013240474631UL
+#define K3 015666365641UL
+
+static void half_md4_transform(uint32_t buf[4], uint32_t const in[8])
+{
+	uint32_t a = buf[0], b = buf[1], c = buf[2], d = buf[3];
+
+	/* Round 1 */
+	ROUND(F, a, b, c, d, in[0] + K1,  3);
+	ROUND(F, d, a, b, c, in[1] + K1,  7);
+	ROUND(F, c, d, a, b, in[2] + K1, 11);
+	ROUND(F, b, c, d, a, in[3] + K1, 19);
+	ROUND(F, a, b, c, d, in[4] + K1,  3);
+	ROUND(F, d, a, b, c, in[5] + K1,  7);
+	ROUND(F, c, d, a, b, in[6] + K1, 11);
+	ROUND(F, b, c, d, a, in[7] + K1, 19);
+
+	/* Round 2 */
+	ROUND(G, a, b, c, d, in[1] + K2,  3);
+	ROUND(G, d, a, b, c, in[3] + K2,  5);
+	ROUND(G, c, d, a, b, in[5] + K2,  9);
+	ROUND(G, b, c, d, a, in[7] + K2, 13);
+	ROUND(G, a, b, c, d, in[0] + K2,  3);
+	ROUND(G, d, a, b, c, in[2] + K2,  5);
+	ROUND(G, c, d, a, b, in[4] + K2,  9);
+	ROUND(G, b, c, d, a, in[6] + K2, 13);
+
+	/* Round 3 */
+	ROUND(H, a, b, c, d, in[3] + K3,  3);
+	ROUND(H, d, a, b, c, in[7] + K3,  9);
+	ROUND(H, c, d, a, b, in[2] + K3, 11);
+	ROUND(H, b, c, d, a, in[6] + K3, 15);
+	ROUND(H, a, b, c, d, in[1] + K3,  3);
+	ROUND(H, d, a, b, c, in[5] + K3,  9);
+	ROUND(H, c, d, a, b, in[0] + K3, 11);
+	ROUND(H, b, c, d, a, in[4] + K3, 15);
+
+	buf[0] += a;
+	buf[1] += b;
+	buf[2] += c;
+	buf[3] += d;
+}
+
+static uint32_t dx_hack_hash(const char *name, int len, int unsigned_char)
+{
+	uint32_t hash, hash0 = 0x12a3fe2d, hash1 = 0x37abe8f9;
+	int c;
+
+	while (len--) {
+		c = unsigned_char ? (unsigned char)*name : (signed char)*name;
+		name++;
+		hash = hash1 + (hash0 ^ (c * 7152373));
+
+		if (hash & 0x80000000)
+			hash -= 0x7fffffff;
+		hash1 = hash0;
+		hash0 = hash;
+	}
+	return hash0 << 1;
+}
+
+static void str2hashbuf(const char *msg, int len, uint32_t *buf, int num,
+			int unsigned_char)
+{
+	uint32_t pad, val;
+	int i, c;
+
+	pad = (uint32_t)len | ((uint32_t)len << 8);
+	pad |= pad << 16;
+
+	val = pad;
+	if (len > num * 4)
+		len = num * 4;
+	for (i = 0; i < len; i++) {
+		c = unsigned_char ? (unsigned char)msg[i] : (signed char)msg[i];
+		val = c + (val << 8);
+		if ((i % 4) == 3) {
+			*buf++ = val;
+			val = pad;
+			num--;
+		}
+	}
+	if (--num >= 0)
+		*buf++ = val;
+	while (--num >= 0)
+		*buf++ = pad;
+}
+
+/*
+ * Compute the major hash of name as used in the index into *hashp.
+ * Returns 0 on success, -1 for an unknown hash version.
+ */
+static int ext4fs_dx_hash(struct ext2_sblock *sb, int version,
+			  const char *name, int len, uint32_t *hashp)
+{
+	uint32_t buf[4], in[8];
+	uint32_t hash;
+	int unsigned_char = 0;
+	int i;
+
+	buf[0] = 0x67452301;
+	buf[1] = 0xefcdab89;
+	buf[2] = 0x98badcfe;
+	buf[3] = 0x10325476;
+
+	for (i = 0; i < 4; i++) {
+		if (sb->hash_seed[i]) {
+			for (i = 0; i < 4; i++)
+				buf[i] = __le32_to_cpu(sb->hash_seed[i]);
+			break;
+		}
+	}
+
+	if (__le32_to_cpu(sb->flags) & EXT2_FLAGS_UNSIGNED_HASH)
+		unsigned_char = 1;
+
+	switch (version) {
+	case DX_HASH_LEGACY:
+		hash = dx_hack_hash(name, len, unsigned_char);
+		break;
+	case DX_HASH_HALF_MD4:
+		for (; len > 0; len -= 32, name += 32) {
+			str2hashbuf(name, len, in, 8, unsigned_char);
+			half_md4_transform(buf, in);
+		}
+		hash = buf[1];
+		break;
+	case DX_HASH_TEA:
+		for (; len > 0; len -= 16, name += 16) {
+			str2hashbuf(name, len, in, 4, unsigned_char);
+			tea_transform(buf, in);
+		}
+		hash = buf[0];
+		break;
+	default:
+		return -1;
+	}
+
+	hash &= ~1;
+	if (hash == (0x7fffffff << 1))
+		hash = (0x7fffffff - 1) << 1;
+	*hashp = hash;
+	return 0;
+}
+
+/*
+ * Search one leaf block for name. Returns 1 and fills in *ino and
+ * *filetype if it is there, 0 otherwise.
+ */
+static int ext4fs_dx_search_leaf(char *block, int blksz, const char *name,
+				 int namelen, uint32_t *ino, int *filetype)
+{
+	struct ext2_dirent *dirent;
+	int pos, len;
+
+	for (pos = 0; pos + sizeof(*dirent) <= blksz; pos += len) {
+		dirent = (struct ext2_dirent *)(block + pos);
+		len = __le16_to_cpu(dirent->direntlen);
+		if (len < sizeof(*dirent) || pos + len > blksz)
+			break;
+		if (dirent->inode && dirent->namelen == namelen &&
+		    !memcmp(dirent + 1, name, namelen)) {
+			*ino = __le32_to_cpu(dirent->inode);
+			*filetype = dirent->filetype;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Check the entry count of the index entries at 'entries' in the block
+ * at 'buf'. Returns the entries, or NULL if they are unusable.
+ */
+static struct dx_entry *ext4fs_dx_check(struct dx_entry *entries, char *buf,
+					int blksz, int *count)
+{
+	struct dx_countlimit *cl = (struct dx_countlimit *)entries;
+
+	*count = __le16_to_cpu(cl->count);
+	if (*count == 0 || *count > __le16_to_cpu(cl->limit) ||
+	    (char *)(entries + *count) > buf + blksz)
+		return NULL;
+	return entries;
+}
+
+/* Where the lookup is in one index block */
+struct dx_frame {
+	struct dx_entry *entries;
+	struct dx_entry *at;
+	int count;
+};
+
+/*
+ * Read index block 'block' of dir into buf and check its entry count.
+ * Returns the entries, or NULL if the block is unusable.
+ */
+static struct dx_entry *ext4fs_dx_read_node(struct ext2fs_node *dir,
+					    uint32_t block, char *buf,
+					    int blksz, int *count)
+{
+	struct dx_entry *entries = (struct dx_entry *)(buf + DX_NODE_OFFSET);
+
+	if (ext4fs_read_file(dir, block * blksz, blksz, buf) != blksz)
+		return NULL;
+	return ext4fs_dx_check(entries, buf, blksz, count);
+}
+
+/*
+ * Look name up in directory dir through its htree index, reading only
+ * the index blocks on the way and the leaf blocks the name hashes to.
+ * Returns 1 and fills in the inode number and the directory entry file
+ * type if the name is found, 0 if it does not exist and -1 if the
+ * directory is not indexed or the index cannot be used; the directory
+ * has to be scanned then.
+ */
+int ext4fs_htree_lookup(struct ext2fs_node *dir, const char *name,
+			uint32_t *ino, int *filetype)
+{
+	struct ext2_sblock *sb = &dir->data->sblock;
+	int blksz = EXT2_BLOCK_SIZE(dir->data);
+	uint32_t nblocks = __le32_to_cpu(dir->inode.size) / blksz;
+	int namelen = strlen(name);
+	struct dx_frame frames[DX_MAX_LEVELS], *frame;
+	struct dx_root_info *info;
+	struct dx_entry *entries;
+	uint32_t hash, block;
+	int count, levels, level, lo, hi, mid;
+	char *buf, *leaf;
+	int ret = -1;
+
+	if (!(__le32_to_cpu(sb->feature_compatibility) &
+	      EXT4_FEATURE_COMPAT_DIR_INDEX) ||
+	    !(__le32_to_cpu(dir->inode.flags) & EXT4_INDEX_FL))
+		return -1;
+
+	/* "." and ".." are in the root block, not in the index */
+	if (!strcmp(name, ".") || !strcmp(name, ".."))
+		return -1;
+
+	/* One block per index level, then the leaf */
+	buf = zalloc((DX_MAX_LEVELS + 1) * blksz);
+	if (!buf)
+		return -1;
+	leaf = buf + DX_MAX_LEVELS * blksz;
+
+	if (ext4fs_read_file(dir, 0, blksz, buf) != blksz)
+		goto out;
+
+	info = (struct dx_root_info *)(buf + DX_ROOT_INFO_OFFSET);
+	if (info->info_length != sizeof(*info) || info->unused_flags & 1 ||
+	    info->indirect_levels >= DX_MAX_LEVELS)
+		goto out;
+	levels = info->indirect_levels;
+
+	if (ext4fs_dx_hash(sb, info->hash_version, name, namelen, &hash)) {
+		debug("%s: unknown hash version %d\n", __func__,
+		      info->hash_version);
+		goto out;
+	}
+
+	entries = ext4fs_dx_check((struct dx_entry *)(info + 1), buf, blksz,
+				  &count);
+	for (level = 0; ; level++) {
+		if (!entries)
+			goto out;
+
+		/* Last entry whose hash is not above ours; the first has 0 */
+		lo = 1;
+		hi = count - 1;
+		while (lo <= hi) {
+			mid = (lo + hi) / 2;
+			if (__le32_to_cpu(entries[mid].hash) > hash)
+				hi = mid - 1;
+			else
+				lo = mid + 1;
+		}
+
+		frame = &frames[level];
+		frame->entries = entries;
+		frame->at = &entries[lo - 1];
+		frame->count = count;
+
+		block = __le32_to_cpu(frame->at->block) & 0x0fffffff;
+		if (block >= nblocks)
+			goto out;
+		if (level == levels)
+			break;
+		entries = ext4fs_dx_read_node(dir, block,
+					      buf + (level + 1) * blksz,
+					      blksz, &count);
+	}
+
+	for (;;) {
+		if (ext4fs_read_file(dir, block * blksz, blksz, leaf) != blksz)
+			goto out;
+		if (ext4fs_dx_search_leaf(leaf, blksz, name, namelen, ino,
+					  filetype)) {
+			ret = 1;
+			break;
+		}
+
+		/*
+		 * Names whose hashes collide may go on in the next leaf,
+		 * whose index entry then has the same hash.
+		 */
+		for (level = levels; level >= 0; level--) {
+			frame = &frames[level];
+			if (++frame->at < frame->entries + frame->count)
+				break;
+		}
+		if (level < 0 ||
+		    (__le32_to_cpu(frames[level].at->hash) & ~1) != hash) {
+			ret = 0;
+			break;
+		}
+
+		/* Down to the leftmost leaf under that entry */
+		for (;;) {
+			block = __le32_to_cpu(frames[level].at->block) &
+				0x0fffffff;
+			if (block >= nblocks)
+				goto out;
+			if (level == levels)
+				break;
+			level++;
+			entries = ext4fs_dx_read_node(dir, block,
+						      buf + level * blksz,
+						      blksz, &count);
+			if (!entries)
+				goto out;
+			frames[level].entries = entries;
+			frames[level].at = entries;
+			frames[level].count = count;
+		}
+	}
+out:
+	free(buf);
+	return ret;
+}
@@ -44,18 +44,21 @@ void ext4fs_free_node(struct ext2fs_node *node, struct ext2fs_node *currroot)
  * Taken from openmoko-kernel mailing list: By Andy green
  * Optimized read file API : collects and defers contiguous sector
  * reads into one potentially more efficient larger sequential read action
+ *
+ * Blocks are mapped a run at a time, so an extent is read with a single
+ * ext4fs_devread() however many blocks it has.
  */
 int ext4fs_read_file(struct ext2fs_node *node, int pos,
 		unsigned int len, char *buf)
 {
 	struct ext_filesystem *fs = get_fs();
-	int i;
+	lbaint_t i;
 	lbaint_t blockcnt;
+	uint32_t run;
 	int log2blksz = fs->dev_desc->log2blksz;
 	int log2_fs_blocksize = LOG2_BLOCK_SIZE(node->data) - log2blksz;
 	int blocksize = (1 << (log2_fs_blocksize + log2blksz));
 	unsigned int filesize = __le32_to_cpu(node->inode.size);
-	lbaint_t previous_block_number = -1;
 	lbaint_t delayed_start = 0;
 	lbaint_t delayed_extent = 0;
 	lbaint_t delayed_skipfirst = 0;
@@ -69,64 +72,55 @@ int ext4fs_read_file(struct ext2fs_node *node, int pos,
 
 	blockcnt = ((len + pos) + blocksize - 1) / blocksize;
 
-	for (i = pos / blocksize; i < blockcnt; i++) {
+	for (i = pos / blocksize; i < blockcnt; i += run) {
 		lbaint_t blknr;
-		int blockoff = pos % blocksize;
-		int blockend = blocksize;
+		unsigned int bytes;
 		int skipfirst = 0;
-		blknr = read_allocated_block(&(node->inode), i);
+		int blockend;
+
+		blknr = ext4fs_map_blocks(node, i, &run);
 		if (blknr < 0)
 			return -1;
+		if (run > blockcnt - i)
+			run = blockcnt - i;
 
-		blknr = blknr << log2_fs_blocksize;
-
-		/* Last block.  */
-		if (i == blockcnt - 1) {
-			blockend = (len + pos) % blocksize;
-
-			/* The last portion is exactly blocksize. */
-			if (!blockend)
-				blockend = blocksize;
-		}
+		bytes = run * blocksize;
 
 		/* First block. */
 		if (i == pos / blocksize) {
-			skipfirst = blockoff;
-			blockend -= skipfirst;
+			skipfirst = pos % blocksize;
+			bytes -= skipfirst;
+		}
+
+		/* Last block. */
+		if (i + run == blockcnt) {
+			blockend = (len + pos) % blocksize;
+			if (blockend)
+				bytes -= blocksize - blockend;
 		}
+
 		if (blknr) {
-			int status;
+			blknr = blknr << log2_fs_blocksize;
 
-			if (previous_block_number != -1) {
-				if (delayed_next == blknr) {
-					delayed_extent += blockend;
-					delayed_next += blockend >> log2blksz;
-				} else {	/* spill */
+			if (delayed_extent && delayed_next == blknr) {
+				delayed_extent += bytes;
+			} else {
+				if (delayed_extent) {	/* spill */
 					status = ext4fs_devread(delayed_start,
 							delayed_skipfirst,
 							delayed_extent,
 							delayed_buf);
 					if (status == 0)
 						return -1;
-					previous_block_number = blknr;
-					delayed_start = blknr;
-					delayed_extent = blockend;
-					delayed_skipfirst = skipfirst;
-					delayed_buf = buf;
-					delayed_next = blknr +
-						(blockend >> log2blksz);
 				}
-			} else {
-				previous_block_number = blknr;
 				delayed_start = blknr;
-				delayed_extent = blockend;
+				delayed_extent = bytes;
 				delayed_skipfirst = skipfirst;
 				delayed_buf = buf;
-				delayed_next = blknr +
-					(blockend >> log2blksz);
 			}
+			delayed_next = blknr + (run << log2_fs_blocksize);
 		} else {
-			if (previous_block_number != -1) {
+			if (delayed_extent) {
 				/* spill */
 				status = ext4fs_devread(delayed_start,
 							delayed_skipfirst,
@@ -134,20 +128,19 @@ int ext4fs_read_file(struct ext2fs_node *node, int pos,
 							delayed_buf);
 				if (status == 0)
 					return -1;
-				previous_block_number = -1;
+				delayed_extent = 0;
 			}
-			memset(buf, 0, blocksize - skipfirst);
+			memset(buf, 0, bytes);
 		}
-		buf += blocksize - skipfirst;
+		buf += bytes;
 	}
-	if (previous_block_number != -1) {
+	if (delayed_extent) {
 		/* spill */
 		status = ext4fs_devread(delayed_start,
 					delayed_skipfirst, delayed_extent,
 					delayed_buf);
 		if (status == 0)
 			return -1;
-		previous_block_number = -1;
 	}
 
 	return len;
@@ -174,6 +167,32 @@ int ext4fs_ls(const char *dirname)
 	return 0;
 }
 
+/*
+ * Call 'func' for each entry of directory 'dirname' instead of printing
+ * it. Return 0 on success, -1 otherwise.
+ */
+int ext4fs_readdir(const char *dirname, fs_dir_func *func, void *priv)
+{
+	struct ext2fs_node *dirnode;
+	int status;
+
+	if (ext4fs_root == NULL)
+		return -1;
+
+	status = ext4fs_find_file(dirname, &ext4fs_root->diropen, &dirnode,
+				  FILETYPE_DIRECTORY);
+	if (status != 1)
+		return -1;
+
+	ext4fs_readdir_func = func;
+	ext4fs_readdir_priv = priv;
+	ext4fs_iterate_dir(dirnode, NULL, NULL, NULL);
+	ext4fs_readdir_func = NULL;
+	ext4fs_free_node(dirnode, &ext4fs_root->diropen);
+
+	return 0;
+}
+
 int ext4fs_read(char *buf, unsigned len)
 {
 	if (ext4fs_root == NULL || ext4fs_file == NULL)
@@ -200,21 +219,81 @@ int ext4_read_file(const char *filename, void *buf, int offset, int len)
 	int file_len;
 	int len_read;
 
-	if (offset != 0) {
-		printf("** Cannot support non-zero offset **\n");
-		return -1;
-	}
-
 	file_len = ext4fs_open(filename);
 	if (file_len < 0) {
 		printf("** File not found %s **\n", filename);
 		return -1;
 	}
 
-	if (len == 0)
-		len = file_len;
+	if (offset >= file_len)
+		return 0;
+	if (len == 0 || len > file_len - offset)
+		len = file_len - offset;
 
-	len_read = ext4fs_read(buf, len);
+	len_read = ext4fs_read_file(ext4fs_file, offset, len, buf);
 
 	return len_read;
 }
+
+int ext4_open_file(const char *filename)
+{
+	int file_len;
+
+	file_len = ext4fs_open(filename);
+	if (file_len < 0)
+		printf("** File not found %s **\n", filename);
+
+	return file_len;
+}
+
+/*
+ * Find where byte 'offset' of the file opened by ext4_open_file() is
+ * stored: *sect is set to the device block and *len to the number of
+ * bytes from there on, at most 'maxlen', that are stored contiguously.
+ * Returns 1 for data, 0 if the range is a hole and -1 on error. *len is
+ * 0 at the end of the file.
+ */
+int ext4_map_file(ulong offset, ulong maxlen, lbaint_t *sect, ulong *len)
+{
+	struct ext2fs_node *node = ext4fs_file;
+	struct ext_filesystem *fs = get_fs();
+	int log2blksz = fs->dev_desc->log2blksz;
+	int log2_fs_blocksize;
+	ulong blocksize, filesize, skip;
+	long int blknr;
+	uint32_t run;
+
+	*len = 0;
+	if (ext4fs_root == NULL || node == NULL)
+		return -1;
+
+	filesize = __le32_to_cpu(node->inode.size);
+	if (offset >= filesize)
+		return 1;
+	if (maxlen > filesize - offset)
+		maxlen = filesize - offset;
+
+	log2_fs_blocksize = LOG2_BLOCK_SIZE(node->data) - log2blksz;
+	blocksize = 1 << (log2_fs_blocksize + log2blksz);
+	skip = offset % blocksize;
+
+	blknr = ext4fs_map_blocks(node, offset / blocksize, &run);
+	if (blknr < 0)
+		return -1;
+
+	*len = min((ulong)run * blocksize - skip, maxlen);
+	if (!blknr)
+		return 0;
+
+	*sect = part_offset + ((lbaint_t)blknr << log2_fs_blocksize) +
+		(skip >> log2blksz);
+	return 1;
+}
+
+void ext4_release_file(void)
+{
+	if (ext4fs_file != NULL && ext4fs_root != NULL) {
+		ext4fs_free_node(ext4fs_file, &ext4fs_root->diropen);
+		ext4fs_file = NULL;
+	}
+}
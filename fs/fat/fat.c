@@ -18,6 +18,7 @@
 #include <malloc.h>
 #include <linux/compiler.h>
 #include <linux/ctype.h>
+#include <dircache.h>
 
 #ifdef CONFIG_SUPPORT_VFAT
 static const int vfat_enabled = 1;
@@ -38,6 +39,28 @@ static void downcase(char *str)
 
 static block_dev_desc_t *cur_dev;
 static disk_partition_t cur_part_info;
+#ifdef CONFIG_FS_DIRCACHE
+/* Names looked up since fat_set_blk_dev(), keyed by directory cluster */
+static struct dircache fat_dircache;
+#endif
+#ifdef CONFIG_FAT_CACHE_SIZE
+/* The FAT read since fat_set_blk_dev(), shared by all reads and writes */
+static struct {
+	__u8 *buf;
+	__u8 *valid;		/* Flag per FAT_CACHE_BLOCKS sectors read */
+	__u32 fat_sect;
+	__u32 size;
+	int warned;
+} fat_cache;
+
+static void fat_cache_drop(void)
+{
+	free(fat_cache.buf);
+	free(fat_cache.valid);
+	fat_cache.buf = NULL;
+	fat_cache.valid = NULL;
+}
+#endif
 
 #define DOS_BOOT_MAGIC_OFFSET	0x1fe
 #define DOS_FS_TYPE_OFFSET	0x36
@@ -58,6 +81,13 @@ int fat_set_blk_dev(block_dev_desc_t *dev_desc, disk_partition_t *info)
 
 	cur_dev = dev_desc;
 	cur_part_info = *info;
+#ifdef CONFIG_FS_DIRCACHE
+	dircache_flush(&fat_dircache);
+#endif
+#ifdef CONFIG_FAT_CACHE_SIZE
+	fat_cache_drop();
+	fat_cache.warned = 0;
+#endif
 
 	/* Make sure it has a valid FAT header */
 	if (disk_read(0, 1, buffer) != 1) {
@@ -154,6 +184,118 @@ static void get_name(dir_entry *dirent, char *s_name)
 	downcase(s_name);
 }
 
+#ifdef CONFIG_FAT_CACHE_SIZE
+/*
+ * Keep the whole FAT in memory if it is no larger than
+ * CONFIG_FAT_CACHE_SIZE. Nothing is read until entries are looked up,
+ * and what has been read is reused until the next fat_set_blk_dev().
+ */
+static void fat_cache_init(fsdata *mydata)
+{
+	__u32 size = mydata->fatlength * mydata->sect_size;
+
+	mydata->fatcache_dirty = NULL;
+	if (fat_cache.buf && (fat_cache.fat_sect != mydata->fat_sect ||
+			      fat_cache.size != size))
+		fat_cache_drop();
+
+	if (!fat_cache.buf && size <= CONFIG_FAT_CACHE_SIZE) {
+		fat_cache.buf = memalign(ARCH_DMA_MINALIGN, size);
+		fat_cache.valid = calloc(DIV_ROUND_UP(mydata->fatlength,
+						      FAT_CACHE_BLOCKS), 1);
+		fat_cache.fat_sect = mydata->fat_sect;
+		fat_cache.size = size;
+		if (!fat_cache.buf || !fat_cache.valid) {
+			if (!fat_cache.warned)
+				printf("FAT cache: no memory for %u bytes, "
+				       "reading the FAT in pieces\n", size);
+			fat_cache.warned = 1;
+			fat_cache_drop();
+		}
+	}
+
+	mydata->fatcache = fat_cache.buf;
+	mydata->fatcache_valid = fat_cache.valid;
+}
+
+/* Stop using the cache for this operation; it stays for the next one */
+static void fat_cache_put(fsdata *mydata)
+{
+	free(mydata->fatcache_dirty);
+	mydata->fatcache = NULL;
+	mydata->fatcache_valid = NULL;
+	mydata->fatcache_dirty = NULL;
+}
+
+/*
+ * Make sure 'len' bytes of the FAT at byte offset 'off' are in the
+ * cache. Return 0 on success, -1 otherwise.
+ */
+static int fat_cache_fill(fsdata *mydata, __u32 off, __u32 len)
+{
+	__u32 chunksize = FAT_CACHE_BLOCKS * mydata->sect_size;
+	__u32 chunk, last, start, count;
+
+	for (chunk = off / chunksize, last = (off + len - 1) / chunksize;
+	     chunk <= last; chunk++) {
+		if (mydata->fatcache_valid[chunk])
+			continue;
+
+		start = chunk * FAT_CACHE_BLOCKS;
+		count = min(mydata->fatlength - start,
+			    (__u32)FAT_CACHE_BLOCKS);
+		if (disk_read(mydata->fat_sect + start, count,
+			      mydata->fatcache + start * mydata->sect_size)
+		    != count) {
+			debug("Error reading FAT blocks\n");
+			return -1;
+		}
+		mydata->fatcache_valid[chunk] = 1;
+	}
+	return 0;
+}
+
+static __u32 get_fatent_cached(fsdata *mydata, __u32 entry)
+{
+	__u32 off, len;
+	__u8 *p;
+
+	switch (mydata->fatsize) {
+	case 32:
+		off = entry * 4;
+		len = 4;
+		break;
+	case 16:
+		off = entry * 2;
+		len = 2;
+		break;
+	case 12:
+		off = entry + entry / 2;
+		len = 2;
+		break;
+	default:
+		/* Unsupported FAT size */
+		return 0x00;
+	}
+
+	if (off + len > mydata->fatlength * mydata->sect_size ||
+	    fat_cache_fill(mydata, off, len))
+		return 0x00;
+
+	p = mydata->fatcache + off;
+	switch (mydata->fatsize) {
+	case 32:
+		return FAT2CPU32(*(__u32 *)p);
+	case 16:
+		return FAT2CPU16(*(__u16 *)p);
+	default:
+		if (entry & 1)
+			return (p[0] >> 4) | (p[1] << 4);
+		return p[0] | ((p[1] & 0x0f) << 8);
+	}
+}
+#endif
+
 /*
  * Get the entry at index 'entry' in a FAT (12/16/32) table.
  * On failure 0x00 is returned.
@@ -165,6 +307,11 @@ static __u32 get_fatent(fsdata *mydata, __u32 entry)
 	__u32 ret = 0x00;
 	__u16 val1, val2;
 
+#ifdef CONFIG_FAT_CACHE_SIZE
+	if (mydata->fatcache)
+		return get_fatent_cached(mydata, entry);
+#endif
+
 	switch (mydata->fatsize) {
 	case 32:
 		bufnum = entry / FAT32BUFSIZE;
@@ -251,6 +398,12 @@ static __u32 get_fatent(fsdata *mydata, __u32 entry)
 	return ret;
 }
 
+/*
+ * Staging area for reads into buffers the controller cannot DMA to
+ */
+static __u8 get_cluster_bounce_block[FAT_BOUNCE_SIZE]
+	__aligned(ARCH_DMA_MINALIGN);
+
 /*
  * Read at most 'size' bytes from the specified cluster into 'buffer'.
  * Return 0 on success, -1 otherwise.
@@ -272,20 +425,29 @@ get_cluster(fsdata *mydata, __u32 clustnum, __u8 *buffer, unsigned long size)
 	debug("gc - clustnum: %d, startsect: %d\n", clustnum, startsect);
 
 	if ((unsigned long)buffer & (ARCH_DMA_MINALIGN - 1)) {
-		ALLOC_CACHE_ALIGN_BUFFER(__u8, tmpbuf, mydata->sect_size);
-
-		printf("FAT: Misaligned buffer address (%p)\n", buffer);
+		/*
+		 * Every sector of a misaligned buffer is misaligned too, so
+		 * read through the staging area, as many sectors at a time
+		 * as fit.
+		 */
+		debug("FAT: Misaligned buffer address (%p)\n", buffer);
 
 		while (size >= mydata->sect_size) {
-			ret = disk_read(startsect++, 1, tmpbuf);
-			if (ret != 1) {
+			idx = min(size / mydata->sect_size,
+				  (unsigned long)(FAT_BOUNCE_SIZE /
+						  mydata->sect_size));
+			ret = disk_read(startsect, idx,
+					get_cluster_bounce_block);
+			if (ret != idx) {
 				debug("Error reading data (got %d)\n", ret);
 				return -1;
 			}
 
-			memcpy(buffer, tmpbuf, mydata->sect_size);
-			buffer += mydata->sect_size;
-			size -= mydata->sect_size;
+			startsect += idx;
+			idx *= mydata->sect_size;
+			memcpy(buffer, get_cluster_bounce_block, idx);
+			buffer += idx;
+			size -= idx;
 		}
 	} else {
 		idx = size / mydata->sect_size;
@@ -567,13 +729,147 @@ static __u8 mkcksum(const char name[8], const char ext[3])
 	return ret;
 }
 
+/* Set while fat_readdir() lists a directory instead of printing it */
+static fs_dir_func *fat_readdir_func;
+static void *fat_readdir_priv;
+
+/* Print one entry of a directory listing or hand it to fat_readdir() */
+static void fat_ls_entry(dir_entry *dentptr, const char *name)
+{
+	struct fs_dirent dent;
+
+	if (fat_readdir_func) {
+		dent.name = name;
+		dent.type = (dentptr->attr & ATTR_DIR) ? FS_DT_DIR : FS_DT_REG;
+		dent.size = FAT2CPU32(dentptr->size);
+		dent.mtime = FAT2CPU16(dentptr->date) << 16 |
+			     FAT2CPU16(dentptr->time);
+		fat_readdir_func(fat_readdir_priv, &dent);
+	} else if (dentptr->attr & ATTR_DIR) {
+		printf("            %s/\n", name);
+	} else {
+		printf(" %8ld   %s \n", (long)FAT2CPU32(dentptr->size), name);
+	}
+}
+
+static void fat_ls_total(int files, int dirs)
+{
+	if (!fat_readdir_func)
+		printf("\n%d file(s), %d dir(s)\n\n", files, dirs);
+}
+
+__u8 get_dentfromdir_block[MAX_CLUSTSIZE]
+	__aligned(ARCH_DMA_MINALIGN);
+
+#ifdef CONFIG_FS_DIRCACHE
+static int fat_dircache_add(__u32 dirclust, const char *name,
+			    dir_entry *dentptr)
+{
+	if (*name == '\0')
+		return 0;
+	return dircache_add(&fat_dircache, dirclust, name, strlen(name),
+			    dentptr, sizeof(dir_entry));
+}
+
+/*
+ * Add the short and long name of every entry of the directory starting
+ * at cluster 'dirclust' to fat_dircache, 0 being the FAT12/16 root
+ * directory. Return 0 on success, -1 otherwise.
+ */
+static int fat_dircache_fill(fsdata *mydata, __u32 dirclust)
+{
+	__u32 curclust = dirclust;
+	__u32 cursect = mydata->rootdir_sect;
+	__u32 rootdir_end = mydata->data_begin + mydata->clust_size * 2;
+	int i, n;
+
+	if (dirclust == 0 && mydata->fatsize == 32)
+		return -1;
+
+	while (1) {
+		dir_entry *dentptr = (dir_entry *)get_dentfromdir_block;
+
+		if (dirclust == 0) {
+			if (cursect >= rootdir_end)
+				break;
+			n = min(rootdir_end - cursect, (__u32)PREFETCH_BLOCKS);
+			if (disk_read(cursect, PREFETCH_BLOCKS,
+				      get_dentfromdir_block) < 0)
+				return -1;
+			cursect += n;
+			n *= DIRENTSPERBLOCK;
+		} else {
+			if (get_cluster(mydata, curclust, get_dentfromdir_block,
+					mydata->clust_size *
+					mydata->sect_size) != 0)
+				return -1;
+			n = DIRENTSPERCLUST;
+		}
+
+		for (i = 0; i < n; i++, dentptr++) {
+			char s_name[14], l_name[VFAT_MAXLEN_BYTES];
+
+			if (dentptr->name[0] == 0)
+				goto done;
+			if (dentptr->name[0] == DELETED_FLAG)
+				continue;
+
+			l_name[0] = '\0';
+			if (dentptr->attr & ATTR_VOLUME) {
+				/* Volume label, or part of a long name */
+				if (!vfat_enabled ||
+				    (dentptr->attr & ATTR_VFAT) != ATTR_VFAT ||
+				    !(dentptr->name[0] & LAST_LONG_ENTRY_MASK))
+					continue;
+				if (get_vfatname(mydata, curclust,
+						 get_dentfromdir_block,
+						 dentptr, l_name))
+					continue;
+			}
+
+			get_name(dentptr, s_name);
+			if (fat_dircache_add(dirclust, s_name, dentptr) ||
+			    fat_dircache_add(dirclust, l_name, dentptr))
+				return -1;
+		}
+
+		if (dirclust != 0) {
+			curclust = get_fatent(mydata, curclust);
+			if (CHECK_CLUST(curclust, mydata->fatsize))
+				break;
+		}
+	}
+done:
+	return dircache_done(&fat_dircache, dirclust);
+}
+
+/*
+ * Look 'filename' up in the directory starting at cluster 'dirclust',
+ * reading the whole directory into fat_dircache the first time. Return
+ * 1 and copy the entry into 'retdent' if it was found, 0 if it does not
+ * exist and -1 if the directory has to be searched on disk.
+ */
+static int fat_dircache_find(fsdata *mydata, __u32 dirclust,
+			     const char *filename, dir_entry *retdent)
+{
+	int ret;
+
+	ret = dircache_lookup(&fat_dircache, dirclust, filename, retdent,
+			      sizeof(dir_entry));
+	if (ret >= 0 || !dircache_room(&fat_dircache))
+		return ret;
+
+	if (fat_dircache_fill(mydata, dirclust))
+		return -1;
+	return dircache_lookup(&fat_dircache, dirclust, filename, retdent,
+			       sizeof(dir_entry));
+}
+#endif
+
 /*
  * Get the directory entry associated with 'filename' from the directory
  * starting at 'startsect'
  */
-__u8 get_dentfromdir_block[MAX_CLUSTSIZE]
-	__aligned(ARCH_DMA_MINALIGN);
-
 static dir_entry *get_dentfromdir(fsdata *mydata, int startsect,
 				  char *filename, dir_entry *retdent,
 				  int dols)
@@ -584,6 +880,23 @@ static dir_entry *get_dentfromdir(fsdata *mydata, int startsect,
 
 	debug("get_dentfromdir: %s\n", filename);
 
+#ifdef CONFIG_FS_DIRCACHE
+	/*
+	 * Listing a directory first looks up an empty name, which has to
+	 * find its "." entry on disk.
+	 */
+	if (!dols && *filename) {
+		switch (fat_dircache_find(mydata, curclust, filename,
+					  retdent)) {
+		case 1:
+			return retdent;
+		case 0:
+			debug("%s not found\n", filename);
+			return NULL;
+		}
+	}
+#endif
+
 	while (1) {
 		dir_entry *dentptr;
 
@@ -615,34 +928,21 @@ static dir_entry *get_dentfromdir(fsdata *mydata, int startsect,
 						     dentptr, l_name);
 					if (dols) {
 						int isdir;
-						char dirc;
 						int doit = 0;
 
 						isdir = (dentptr->attr & ATTR_DIR);
 
 						if (isdir) {
 							dirs++;
-							dirc = '/';
 							doit = 1;
 						} else {
-							dirc = ' ';
 							if (l_name[0] != 0) {
 								files++;
 								doit = 1;
 							}
 						}
-						if (doit) {
-							if (dirc == ' ') {
-								printf(" %8ld   %s%c\n",
-									(long)FAT2CPU32(dentptr->size),
-									l_name,
-									dirc);
-							} else {
-								printf("            %s%c\n",
-									l_name,
-									dirc);
-							}
-						}
+						if (doit)
+							fat_ls_entry(dentptr, l_name);
 						dentptr++;
 						continue;
 					}
@@ -654,10 +954,8 @@ static dir_entry *get_dentfromdir(fsdata *mydata, int startsect,
 				}
 			}
 			if (dentptr->name[0] == 0) {
-				if (dols) {
-					printf("\n%d file(s), %d dir(s)\n\n",
-						files, dirs);
-				}
+				if (dols)
+					fat_ls_total(files, dirs);
 				debug("Dentname == NULL - %d\n", i);
 				return NULL;
 			}
@@ -673,31 +971,20 @@ static dir_entry *get_dentfromdir(fsdata *mydata, int startsect,
 			get_name(dentptr, s_name);
 			if (dols) {
 				int isdir = (dentptr->attr & ATTR_DIR);
-				char dirc;
 				int doit = 0;
 
 				if (isdir) {
 					dirs++;
-					dirc = '/';
 					doit = 1;
 				} else {
-					dirc = ' ';
 					if (s_name[0] != 0) {
 						files++;
 						doit = 1;
 					}
 				}
 
-				if (doit) {
-					if (dirc == ' ') {
-						printf(" %8ld   %s%c\n",
-							(long)FAT2CPU32(dentptr->size),
-							s_name, dirc);
-					} else {
-						printf("            %s%c\n",
-							s_name, dirc);
-					}
-				}
+				if (doit)
+					fat_ls_entry(dentptr, s_name);
 
 				dentptr++;
 				continue;
@@ -803,65 +1090,48 @@ exit:
 	return ret;
 }
 
-__u8 do_fat_read_at_block[MAX_CLUSTSIZE]
-	__aligned(ARCH_DMA_MINALIGN);
-
-long
-do_fat_read_at(const char *filename, unsigned long pos, void *buffer,
-	       unsigned long maxsize, int dols)
+/*
+ * Read the boot sector and set up mydata to read the filesystem with.
+ * *rootdir_size is set to the size of a FAT12/16 root directory in
+ * sectors. Returns 0 on success, -1 otherwise; on success the FAT buffers
+ * have to be released again with fat_umount().
+ */
+static int fat_mount(fsdata *mydata, boot_sector *bs, volume_info *volinfo,
+		     int *rootdir_size)
 {
-	char fnamecopy[2048];
-	boot_sector bs;
-	volume_info volinfo;
-	fsdata datablock;
-	fsdata *mydata = &datablock;
-	dir_entry *dentptr = NULL;
-	__u16 prevcksum = 0xffff;
-	char *subname = "";
-	__u32 cursect;
-	int idx, isdir = 0;
-	int files = 0, dirs = 0;
-	long ret = -1;
-	int firsttime;
-	__u32 root_cluster = 0;
-	int rootdir_size = 0;
-	int j;
-
-	if (read_bootsectandvi(&bs, &volinfo, &mydata->fatsize)) {
+	if (read_bootsectandvi(bs, volinfo, &mydata->fatsize)) {
 		debug("Error: reading boot sector\n");
 		return -1;
 	}
 
-	if (mydata->fatsize == 32) {
-		root_cluster = bs.root_cluster;
-		mydata->fatlength = bs.fat32_length;
-	} else {
-		mydata->fatlength = bs.fat_length;
-	}
+	if (mydata->fatsize == 32)
+		mydata->fatlength = bs->fat32_length;
+	else
+		mydata->fatlength = bs->fat_length;
 
-	mydata->fat_sect = bs.reserved;
+	mydata->fat_sect = bs->reserved;
 
-	cursect = mydata->rootdir_sect
-		= mydata->fat_sect + mydata->fatlength * bs.fats;
+	mydata->rootdir_sect = mydata->fat_sect + mydata->fatlength * bs->fats;
 
-	mydata->sect_size = (bs.sector_size[1] << 8) + bs.sector_size[0];
-	mydata->clust_size = bs.cluster_size;
+	mydata->sect_size = (bs->sector_size[1] << 8) + bs->sector_size[0];
+	mydata->clust_size = bs->cluster_size;
 	if (mydata->sect_size != cur_part_info.blksz) {
 		printf("Error: FAT sector size mismatch (fs=%hu, dev=%lu)\n",
 				mydata->sect_size, cur_part_info.blksz);
 		return -1;
 	}
 
+	*rootdir_size = 0;
 	if (mydata->fatsize == 32) {
 		mydata->data_begin = mydata->rootdir_sect -
 					(mydata->clust_size * 2);
 	} else {
-		rootdir_size = ((bs.dir_entries[1]  * (int)256 +
-				 bs.dir_entries[0]) *
-				 sizeof(dir_entry)) /
-				 mydata->sect_size;
+		*rootdir_size = ((bs->dir_entries[1]  * (int)256 +
+				  bs->dir_entries[0]) *
+				  sizeof(dir_entry)) /
+				  mydata->sect_size;
 		mydata->data_begin = mydata->rootdir_sect +
-					rootdir_size -
+					*rootdir_size -
 					(mydata->clust_size * 2);
 	}
 
@@ -871,6 +1141,55 @@ do_fat_read_at(const char *filename, unsigned long pos, void *buffer,
 		debug("Error: allocating memory\n");
 		return -1;
 	}
+#ifdef CONFIG_FAT_CACHE_SIZE
+	fat_cache_init(mydata);
+#endif
+	return 0;
+}
+
+static void fat_umount(fsdata *mydata)
+{
+	free(mydata->fatbuf);
+	mydata->fatbuf = NULL;
+#ifdef CONFIG_FAT_CACHE_SIZE
+	fat_cache_put(mydata);
+#endif
+}
+
+/* Set by fat_open_file(): do_fat_read_at() stores the entry found here */
+static dir_entry *fat_lookup_dent;
+
+__u8 do_fat_read_at_block[MAX_CLUSTSIZE]
+	__aligned(ARCH_DMA_MINALIGN);
+
+long
+do_fat_read_at(const char *filename, unsigned long pos, void *buffer,
+	       unsigned long maxsize, int dols)
+{
+	char fnamecopy[2048];
+	boot_sector bs;
+	volume_info volinfo;
+	fsdata datablock;
+	fsdata *mydata = &datablock;
+	dir_entry *dentptr = NULL;
+	__u16 prevcksum = 0xffff;
+	char *subname = "";
+	__u32 cursect;
+	int idx, isdir = 0;
+	int files = 0, dirs = 0;
+	long ret = -1;
+	int firsttime;
+	__u32 root_cluster = 0;
+	int rootdir_size = 0;
+	int j;
+	dir_entry dent;
+
+	if (fat_mount(mydata, &bs, &volinfo, &rootdir_size))
+		return -1;
+
+	if (mydata->fatsize == 32)
+		root_cluster = bs.root_cluster;
+	cursect = mydata->rootdir_sect;
 
 	if (vfat_enabled)
 		debug("VFAT Support enabled\n");
@@ -910,6 +1229,21 @@ do_fat_read_at(const char *filename, unsigned long pos, void *buffer,
 		isdir = 1;
 	}
 
+#ifdef CONFIG_FS_DIRCACHE
+	if (!dols) {
+		switch (fat_dircache_find(mydata, root_cluster, fnamecopy,
+					  &dent)) {
+		case 1:
+			dentptr = &dent;
+			if (isdir && !(dentptr->attr & ATTR_DIR))
+				goto exit;
+			goto rootdir_done;
+		case 0:
+			goto exit;
+		}
+	}
+#endif
+
 	j = 0;
 	while (1) {
 		int i;
@@ -956,34 +1290,21 @@ do_fat_read_at(const char *filename, unsigned long pos, void *buffer,
 						     dentptr, l_name);
 
 					if (dols == LS_ROOT) {
-						char dirc;
 						int doit = 0;
 						int isdir =
 							(dentptr->attr & ATTR_DIR);
 
 						if (isdir) {
 							dirs++;
-							dirc = '/';
 							doit = 1;
 						} else {
-							dirc = ' ';
 							if (l_name[0] != 0) {
 								files++;
 								doit = 1;
 							}
 						}
-						if (doit) {
-							if (dirc == ' ') {
-								printf(" %8ld   %s%c\n",
-									(long)FAT2CPU32(dentptr->size),
-									l_name,
-									dirc);
-							} else {
-								printf("            %s%c\n",
-									l_name,
-									dirc);
-							}
-						}
+						if (doit)
+							fat_ls_entry(dentptr, l_name);
 						dentptr++;
 						continue;
 					}
@@ -997,8 +1318,7 @@ do_fat_read_at(const char *filename, unsigned long pos, void *buffer,
 			} else if (dentptr->name[0] == 0) {
 				debug("RootDentname == NULL - %d\n", i);
 				if (dols == LS_ROOT) {
-					printf("\n%d file(s), %d dir(s)\n\n",
-						files, dirs);
+					fat_ls_total(files, dirs);
 					ret = 0;
 				}
 				goto exit;
@@ -1014,32 +1334,21 @@ do_fat_read_at(const char *filename, unsigned long pos, void *buffer,
 
 			if (dols == LS_ROOT) {
 				int isdir = (dentptr->attr & ATTR_DIR);
-				char dirc;
 				int doit = 0;
 
 				if (isdir) {
-					dirc = '/';
 					if (s_name[0] != 0) {
 						dirs++;
 						doit = 1;
 					}
 				} else {
-					dirc = ' ';
 					if (s_name[0] != 0) {
 						files++;
 						doit = 1;
 					}
 				}
-				if (doit) {
-					if (dirc == ' ') {
-						printf(" %8ld   %s%c\n",
-							(long)FAT2CPU32(dentptr->size),
-							s_name, dirc);
-					} else {
-						printf("            %s%c\n",
-							s_name, dirc);
-					}
-				}
+				if (doit)
+					fat_ls_entry(dentptr, s_name);
 				dentptr++;
 				continue;
 			}
@@ -1100,8 +1409,7 @@ do_fat_read_at(const char *filename, unsigned long pos, void *buffer,
 		/* If end of rootdir reached */
 		if (rootdir_end) {
 			if (dols == LS_ROOT) {
-				printf("\n%d file(s), %d dir(s)\n\n",
-				       files, dirs);
+				fat_ls_total(files, dirs);
 				ret = 0;
 			}
 			goto exit;
@@ -1114,7 +1422,6 @@ rootdir_done:
 	while (isdir) {
 		int startsect = mydata->data_begin
 			+ START(dentptr) * mydata->clust_size;
-		dir_entry dent;
 		char *nextname = NULL;
 
 		dent = *dentptr;
@@ -1152,11 +1459,17 @@ rootdir_done:
 			subname = nextname;
 	}
 
+	if (fat_lookup_dent) {
+		*fat_lookup_dent = *dentptr;
+		ret = 0;
+		goto exit;
+	}
+
 	ret = get_contents(mydata, dentptr, pos, buffer, maxsize);
 	debug("Size: %d, got: %ld\n", FAT2CPU32(dentptr->size), ret);
 
 exit:
-	free(mydata->fatbuf);
+	fat_umount(mydata);
 	return ret;
 }
 
@@ -1233,6 +1546,22 @@ int file_fat_ls(const char *dir)
 	return do_fat_read(dir, NULL, 0, LS_YES);
 }
 
+/*
+ * Call 'func' for each entry of directory 'dirname' instead of printing
+ * it. Return 0 on success, -1 otherwise.
+ */
+int fat_readdir(const char *dirname, fs_dir_func *func, void *priv)
+{
+	long ret;
+
+	fat_readdir_func = func;
+	fat_readdir_priv = priv;
+	ret = do_fat_read(dirname, NULL, 0, LS_YES);
+	fat_readdir_func = NULL;
+
+	return ret;
+}
+
 long file_fat_read_at(const char *filename, unsigned long pos, void *buffer,
 		      unsigned long maxsize)
 {
@@ -1249,7 +1578,10 @@ int fat_read_file(const char *filename, void *buf, int offset, int len)
 {
 	int len_read;
 
-	len_read = file_fat_read_at(filename, offset, buf, len);
+	/* Streamed reads come back here for every piece, only say it once */
+	if (!offset)
+		printf("reading %s\n", filename);
+	len_read = do_fat_read_at(filename, offset, buf, len, LS_NO);
 	if (len_read == -1) {
 		printf("** Unable to read file %s **\n", filename);
 		return -1;
@@ -1258,8 +1590,120 @@ int fat_read_file(const char *filename, void *buf, int offset, int len)
 	return len_read;
 }
 
+/*
+ * The file opened by fat_open_file(), and the cluster holding byte
+ * 'pos' of it, where fat_map_file() continues.
+ */
+static struct {
+	fsdata data;
+	__u32 start;
+	__u32 size;
+	__u32 clust;
+	__u32 pos;
+} fat_file;
+
+/*
+ * Look up 'filename' and keep it open for fat_map_file(). Returns its
+ * size, or -1 if it cannot be found.
+ */
+int fat_open_file(const char *filename)
+{
+	fsdata *mydata = &fat_file.data;
+	boot_sector bs;
+	volume_info volinfo;
+	dir_entry dent;
+	int rootdir_size;
+	long ret;
+
+	fat_release_file();
+
+	fat_lookup_dent = &dent;
+	ret = do_fat_read_at(filename, 0, NULL, 0, LS_NO);
+	fat_lookup_dent = NULL;
+	if (ret < 0 || (dent.attr & ATTR_DIR)) {
+		printf("** Unable to read file %s **\n", filename);
+		return -1;
+	}
+
+	if (fat_mount(mydata, &bs, &volinfo, &rootdir_size))
+		return -1;
+
+	printf("reading %s\n", filename);
+	fat_file.start = START(&dent);
+	fat_file.size = FAT2CPU32(dent.size);
+	fat_file.clust = fat_file.start;
+	fat_file.pos = 0;
+	return fat_file.size;
+}
+
+/*
+ * Find where byte 'offset' of the open file is: *sect is set to the
+ * device block and *len to the number of bytes from there on, at most
+ * 'maxlen', that are stored in consecutive clusters. Returns 1 with
+ * *len = 0 at the end of the file, -1 on a broken cluster chain.
+ */
+int fat_map_file(ulong offset, ulong maxlen, lbaint_t *sect, ulong *len)
+{
+	fsdata *mydata = &fat_file.data;
+	ulong bytesperclust = mydata->clust_size * mydata->sect_size;
+	__u32 clust, next;
+	ulong skip, run;
+
+	*len = 0;
+	if (!mydata->fatbuf)
+		return -1;
+	if (offset >= fat_file.size)
+		return 1;
+	if (maxlen > fat_file.size - offset)
+		maxlen = fat_file.size - offset;
+
+	if (offset < fat_file.pos) {
+		fat_file.clust = fat_file.start;
+		fat_file.pos = 0;
+	}
+	while (offset - fat_file.pos >= bytesperclust) {
+		fat_file.clust = get_fatent(mydata, fat_file.clust);
+		if (CHECK_CLUST(fat_file.clust, mydata->fatsize))
+			goto broken;
+		fat_file.pos += bytesperclust;
+	}
+
+	skip = offset - fat_file.pos;
+	*sect = cur_part_info.start + mydata->data_begin +
+		fat_file.clust * mydata->clust_size + skip / mydata->sect_size;
+
+	/* Extend the run over following clusters that are consecutive */
+	clust = fat_file.clust;
+	run = bytesperclust - skip;
+	while (run < maxlen) {
+		next = get_fatent(mydata, clust);
+		if (next != clust + 1)
+			break;
+		if (CHECK_CLUST(next, mydata->fatsize))
+			goto broken;
+		clust = next;
+		run += bytesperclust;
+	}
+	*len = min(run, maxlen);
+	return 1;
+
+broken:
+	printf("Invalid FAT entry\n");
+	return -1;
+}
+
+void fat_release_file(void)
+{
+	if (fat_file.data.fatbuf)
+		fat_umount(&fat_file.data);
+}
+
 void fat_close(void)
 {
+	fat_release_file();
+#ifdef CONFIG_FAT_CACHE_SIZE
+	fat_cache_drop();
+#endif
 }
 
 /*
@@ -94,8 +94,76 @@ static void set_name(dir_entry *dirent, const char *filename)
 }
 
 static __u8 num_of_fats;
+
+#ifdef CONFIG_FAT_CACHE_SIZE
+/*
+ * Write the changed sectors of the FAT cache into every FAT copy, a run
+ * of consecutive sectors at a time.
+ */
+static int flush_fat_cache(fsdata *mydata)
+{
+	__u32 start, end, copy;
+
+	for (start = 0; start < mydata->fatlength; start = end) {
+		end = start + 1;
+		if (!mydata->fatcache_dirty[start])
+			continue;
+
+		while (end < mydata->fatlength && mydata->fatcache_dirty[end])
+			end++;
+
+		for (copy = 0; copy < num_of_fats; copy++) {
+			if (disk_write(mydata->fat_sect +
+				       copy * mydata->fatlength + start,
+				       end - start, mydata->fatcache +
+				       start * mydata->sect_size) < 0) {
+				debug("error: writing FAT blocks\n");
+				return -1;
+			}
+		}
+		memset(mydata->fatcache_dirty + start, 0, end - start);
+	}
+
+	return 0;
+}
+
 /*
- * Write fat buffer into block device
+ * Set the entry at index 'entry' in the FAT cache.
+ */
+static int set_fatent_cached(fsdata *mydata, __u32 entry, __u32 entry_value)
+{
+	__u32 off, len;
+
+	switch (mydata->fatsize) {
+	case 32:
+		off = entry * 4;
+		len = 4;
+		break;
+	case 16:
+		off = entry * 2;
+		len = 2;
+		break;
+	default:
+		/* Unsupported FAT size */
+		return -1;
+	}
+
+	if (off + len > mydata->fatlength * mydata->sect_size ||
+	    fat_cache_fill(mydata, off, len))
+		return -1;
+
+	if (mydata->fatsize == 32)
+		*(__u32 *)(mydata->fatcache + off) = cpu_to_le32(entry_value);
+	else
+		*(__u16 *)(mydata->fatcache + off) = cpu_to_le16(entry_value);
+	mydata->fatcache_dirty[off / mydata->sect_size] = 1;
+
+	return 0;
+}
+#endif
+
+/*
+ * Write fat buffer into block device, if it was changed
  */
 static int flush_fat_buffer(fsdata *mydata)
 {
@@ -104,6 +172,13 @@ static int flush_fat_buffer(fsdata *mydata)
 	__u8 *bufptr = mydata->fatbuf;
 	__u32 startblock = mydata->fatbufnum * FATBUFBLOCKS;
 
+#ifdef CONFIG_FAT_CACHE_SIZE
+	if (mydata->fatcache)
+		return flush_fat_cache(mydata);
+#endif
+	if (!mydata->fatbufdirty)
+		return 0;
+
 	startblock += mydata->fat_sect;
 
 	if (getsize > fatlength)
@@ -123,6 +198,7 @@ static int flush_fat_buffer(fsdata *mydata)
 			return -1;
 		}
 	}
+	mydata->fatbufdirty = 0;
 
 	return 0;
 }
@@ -139,6 +215,11 @@ static __u32 get_fatent_value(fsdata *mydata, __u32 entry)
 	__u32 ret = 0x00;
 	__u16 val1, val2;
 
+#ifdef CONFIG_FAT_CACHE_SIZE
+	if (mydata->fatcache)
+		return get_fatent_cached(mydata, entry);
+#endif
+
 	switch (mydata->fatsize) {
 	case 32:
 		bufnum = entry / FAT32BUFSIZE;
@@ -458,6 +539,11 @@ static int set_fatent_value(fsdata *mydata, __u32 entry, __u32 entry_value)
 {
 	__u32 bufnum, offset;
 
+#ifdef CONFIG_FAT_CACHE_SIZE
+	if (mydata->fatcache)
+		return set_fatent_cached(mydata, entry, entry_value);
+#endif
+
 	switch (mydata->fatsize) {
 	case 32:
 		bufnum = entry / FAT32BUFSIZE;
@@ -508,6 +594,7 @@ static int set_fatent_value(fsdata *mydata, __u32 entry, __u32 entry_value)
 	default:
 		return -1;
 	}
+	mydata->fatbufdirty = 1;
 
 	return 0;
 }
@@ -594,6 +681,35 @@ static int find_empty_cluster(fsdata *mydata)
 	return entry;
 }
 
+/*
+ * Find the first run of 'count' empty clusters, so that a new file can
+ * be written in one piece. Without the FAT cache the table is read
+ * through the FATBUFBLOCKS window, in order, until a run is found.
+ * Falls back to the first empty cluster if there is no such run.
+ */
+static int find_empty_run(fsdata *mydata, __u32 count)
+{
+	__u32 first, max_clust, entry, start = 0, len = 0;
+
+	first = find_empty_cluster(mydata);
+	if (count <= 1)
+		return first;
+
+	max_clust = (total_sector - mydata->data_begin) / mydata->clust_size;
+	for (entry = first; entry < max_clust; entry++) {
+		if (get_fatent_value(mydata, entry) != 0) {
+			len = 0;
+			continue;
+		}
+		if (len++ == 0)
+			start = entry;
+		if (len == count)
+			return start;
+	}
+
+	return first;
+}
+
 /*
  * Write directory entries in 'get_dentfromdir_block' to block device
  */
@@ -616,9 +732,6 @@ static void flush_dir_table(fsdata *mydata, dir_entry **dentptr)
 
 	dir_curclust = dir_newclust;
 
-	if (flush_fat_buffer(mydata) < 0)
-		return;
-
 	memset(get_dentfromdir_block, 0x00,
 		mydata->clust_size * mydata->sect_size);
 
@@ -645,10 +758,6 @@ static int clear_fatent(fsdata *mydata, __u32 entry)
 		entry = fat_val;
 	}
 
-	/* Flush fat buffer */
-	if (flush_fat_buffer(mydata) < 0)
-		return -1;
-
 	return 0;
 }
 
@@ -957,6 +1066,22 @@ static int do_fat_write(const char *filename, void *buffer,
 		debug("Error: allocating memory\n");
 		return -1;
 	}
+	mydata->fatbufdirty = 0;
+
+	/*
+	 * With the FAT cached, changes to it are collected and written
+	 * once, after the file data.
+	 */
+#ifdef CONFIG_FAT_CACHE_SIZE
+	fat_cache_init(mydata);
+	if (mydata->fatcache) {
+		mydata->fatcache_dirty = calloc(mydata->fatlength, 1);
+		if (!mydata->fatcache_dirty)
+			fat_cache_put(mydata);
+	}
+#else
+	mydata->fatcache = NULL;
+#endif
 
 	if (disk_read(cursect,
 		(mydata->fatsize == 32) ?
@@ -1026,7 +1151,9 @@ static int do_fat_write(const char *filename, void *buffer,
 		set_name(empty_dentptr, filename);
 		fill_dir_slot(mydata, &empty_dentptr, filename);
 
-		ret = start_cluster = find_empty_cluster(mydata);
+		ret = start_cluster = find_empty_run(mydata,
+				DIV_ROUND_UP(size, mydata->clust_size *
+						   mydata->sect_size));
 		if (ret < 0) {
 			printf("Error: finding empty cluster\n");
 			goto exit;
@@ -1069,6 +1196,18 @@ static int do_fat_write(const char *filename, void *buffer,
 
 exit:
 	free(mydata->fatbuf);
+#ifdef CONFIG_FAT_CACHE_SIZE
+	/*
+	 * A write that went around the cache, or stopped half way, may
+	 * have left it different from the disk.
+	 */
+	if (ret || !mydata->fatcache)
+		fat_cache_drop();
+	fat_cache_put(mydata);
+#endif
+#ifdef CONFIG_FS_DIRCACHE
+	dircache_flush(&fat_dircache);
+#endif
 	return ret < 0 ? ret : write_size;
 }
 
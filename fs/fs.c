@@ -16,6 +16,9 @@
 
 #include <config.h>
 #include <common.h>
+#include <decomp.h>
+#include <image.h>
+#include <malloc.h>
 #include <part.h>
 #include <ext4fs.h>
 #include <fat.h>
@@ -65,6 +68,13 @@ struct fstype_info {
 	int (*read)(const char *filename, void *buf, int offset, int len);
 	int (*write)(const char *filename, void *buf, int offset, int len);
 	void (*close)(void);
+	/*
+	 * Optional, for fs_read_stream(): open returns the file size, map
+	 * finds where an offset of the open file is on the device.
+	 */
+	int (*open)(const char *filename);
+	int (*map)(ulong offset, ulong maxlen, lbaint_t *sect, ulong *len);
+	void (*release)(void);
 };
 
 static struct fstype_info fstypes[] = {
@@ -75,6 +85,9 @@ static struct fstype_info fstypes[] = {
 		.close = fat_close,
 		.ls = file_fat_ls,
 		.read = fat_read_file,
+		.open = fat_open_file,
+		.map = fat_map_file,
+		.release = fat_release_file,
 	},
 #endif
 #ifdef CONFIG_FS_EXT4
@@ -84,6 +97,9 @@ static struct fstype_info fstypes[] = {
 		.close = ext4fs_close,
 		.ls = ext4fs_ls,
 		.read = ext4_read_file,
+		.open = ext4_open_file,
+		.map = ext4_map_file,
+		.release = ext4_release_file,
 	},
 #endif
 #ifdef CONFIG_SANDBOX
@@ -135,6 +151,11 @@ int fs_set_blk_dev(const char *ifname, const char *dev_part_str, int fstype)
 			info->ls += gd->reloc_off;
 			info->read += gd->reloc_off;
 			info->write += gd->reloc_off;
+			if (info->open) {
+				info->open += gd->reloc_off;
+				info->map += gd->reloc_off;
+				info->release += gd->reloc_off;
+			}
 		}
 		relocated = 1;
 	}
@@ -206,6 +227,146 @@ int fs_read(const char *filename, ulong addr, int offset, int len)
 	return ret;
 }
 
+/* Read a whole file through info->read, one piece at a time */
+static int fs_read_pieces(struct fstype_info *info, const char *filename,
+			  void *buf, int chunk, fs_stream_func *func,
+			  void *priv)
+{
+	int offset = 0;
+	int len, ret;
+
+	for (;;) {
+		len = info->read(filename, buf, offset, chunk);
+		if (len <= 0)
+			return len < 0 ? -1 : offset;
+
+		ret = func(priv, buf, len);
+		if (ret < 0)
+			return ret;
+
+		offset += len;
+		if (ret > 0 || len < chunk)
+			return offset;
+	}
+}
+
+/*
+ * Fill buf with 'len' bytes from 'offset' of the open file. The last
+ * extent is only started if the device can do that; fs_stream_wait()
+ * has to be called before the data is used.
+ */
+static int fs_stream_fill(struct fstype_info *info, ulong offset, ulong len,
+			  uchar *buf)
+{
+	block_dev_desc_t *dev = fs_dev_desc;
+	lbaint_t sect, blkcnt;
+	ulong done, n;
+	int ret;
+
+	for (done = 0; done < len; done += n) {
+		ret = info->map(offset + done, len - done, &sect, &n);
+		if (ret < 0 || !n)
+			return -1;
+		if (!ret) {
+			memset(buf + done, 0, n);
+			continue;
+		}
+
+		blkcnt = DIV_ROUND_UP(n, dev->blksz);
+		if (done + n == len && dev->block_read_start) {
+			if (dev->block_read_start(dev->dev, sect, blkcnt,
+						  buf + done))
+				return -1;
+		} else if (dev->block_read(dev->dev, sect, blkcnt,
+					   buf + done) != blkcnt) {
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static int fs_stream_wait(void)
+{
+	if (!fs_dev_desc->block_xfer_done)
+		return 0;
+
+	return fs_dev_desc->block_xfer_done(fs_dev_desc->dev, 1) ? -1 : 0;
+}
+
+int fs_read_stream(const char *filename, int chunk, fs_stream_func *func,
+		   void *priv)
+{
+	struct fstype_info *info = fs_get_info(fs_type);
+	void *buf[2];
+	ulong size, offset, len, next;
+	int cur = 0;
+	int ret;
+
+	buf[0] = memalign(ARCH_DMA_MINALIGN, chunk);
+	buf[1] = memalign(ARCH_DMA_MINALIGN, chunk);
+	if (!buf[0] || !buf[1]) {
+		puts("** Out of memory **\n");
+		ret = -1;
+		goto out;
+	}
+
+	if (!info->open) {
+		ret = fs_read_pieces(info, filename, buf[0], chunk, func, priv);
+		goto out;
+	}
+
+	ret = info->open(filename);
+	if (ret < 0)
+		goto out;
+	size = ret;
+
+	/*
+	 * The file is opened once and each piece is read straight from the
+	 * device into one buffer while func() works on the other.
+	 */
+	offset = 0;
+	len = min(size, (ulong)chunk);
+	if (len && fs_stream_fill(info, 0, len, buf[0]))
+		goto err;
+
+	while (len) {
+		if (fs_stream_wait())
+			goto err;
+
+		next = min(size - offset - len, (ulong)chunk);
+		if (next && fs_stream_fill(info, offset + len, next,
+					   buf[cur ^ 1]))
+			goto err;
+
+		ret = func(priv, buf[cur], len);
+		if (ret < 0)
+			goto err;
+
+		offset += len;
+		if (ret > 0)
+			break;
+		len = next;
+		cur ^= 1;
+	}
+	ret = offset;
+	goto done;
+
+err:
+	printf("** Unable to read file %s **\n", filename);
+	ret = -1;
+done:
+	/* Don't free a buffer the device may still be reading into */
+	fs_stream_wait();
+	info->release();
+out:
+	free(buf[0]);
+	free(buf[1]);
+	fs_close();
+
+	return ret;
+}
+
 int fs_write(const char *filename, ulong addr, int offset, int len)
 {
 	struct fstype_info *info = fs_get_info(fs_type);
@@ -295,6 +456,194 @@ int do_load(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[],
 	return 0;
 }
 
+#ifdef CONFIG_DECOMP_STREAM
+/*
+ * Each piece is inflated right after it has been read, while it is
+ * still in the cache and the next piece is being read, instead of
+ * loading the whole compressed file first. The piece size is a multiple
+ * of any FAT cluster or ext4 block so that every read starts on one.
+ */
+#define LOADZ_CHUNK	(128 << 10)
+
+struct loadz_state {
+	struct decomp_stream *ds;
+	int comp;
+	uchar *dst;
+	ulong dstlen;
+	image_header_t *hdr;	/* legacy image being uncompressed */
+	ulong remain;		/* compressed image data still to come */
+	uint32_t dcrc;		/* of the compressed image data */
+	uint32_t ucrc;		/* of the uncompressed image data */
+	ulong crclen;		/* uncompressed bytes covered by ucrc */
+};
+
+static int loadz_chunk(void *priv, const void *buf, int len)
+{
+	struct loadz_state *st = priv;
+	const uchar *p = buf;
+	image_header_t *hdr = (image_header_t *)buf;
+	ulong outlen;
+	int ret;
+
+	if (!st->ds) {
+		if (len >= image_get_header_size() && image_check_magic(hdr) &&
+		    image_check_hcrc(hdr)) {
+			if (st->dstlen < image_get_header_size())
+				return -1;
+			/* Keep the header, its payload goes right behind */
+			memcpy(st->dst, hdr, image_get_header_size());
+			st->hdr = (image_header_t *)st->dst;
+			st->comp = image_get_comp(hdr);
+			st->remain = image_get_data_size(hdr);
+			st->dst += image_get_header_size();
+			st->dstlen -= image_get_header_size();
+			p += image_get_header_size();
+			len -= image_get_header_size();
+			if (st->comp == IH_COMP_NONE) {
+				puts("** Image is not compressed, use load **\n");
+				return -1;
+			}
+		} else if (st->comp == IH_COMP_NONE) {
+			st->comp = decomp_detect(buf, len);
+			if (st->comp == IH_COMP_NONE) {
+				puts("** Unknown compression, use load **\n");
+				return -1;
+			}
+		}
+
+		st->ds = decomp_start(st->comp, st->dst, st->dstlen);
+		if (!st->ds)
+			return -1;
+	}
+
+	if (!st->hdr)
+		return decomp_feed(st->ds, p, len);
+
+	/*
+	 * The image data CRC is checked on the compressed data as it goes
+	 * by, and recomputed on the output while it is still in the cache.
+	 */
+	if (len > st->remain)
+		len = st->remain;
+	st->dcrc = crc32(st->dcrc, p, len);
+	st->remain -= len;
+
+	ret = decomp_feed(st->ds, p, len);
+	if (ret < 0)
+		return ret;
+
+	outlen = decomp_outlen(st->ds);
+	st->ucrc = crc32(st->ucrc, st->dst + st->crclen, outlen - st->crclen);
+	st->crclen = outlen;
+
+	return st->remain ? 0 : 1;
+}
+
+int do_loadz(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[],
+		int fstype)
+{
+	struct loadz_state st;
+	unsigned long addr;
+	const char *addr_str;
+	const char *filename;
+	unsigned long bytes;
+	void *dst;
+	int len_read;
+	long len;
+	unsigned long time;
+
+	if (argc < 2)
+		return CMD_RET_USAGE;
+	if (argc > 7)
+		return CMD_RET_USAGE;
+
+	memset(&st, 0, sizeof(st));
+	st.comp = IH_COMP_NONE;
+	if (argc >= 7) {
+		st.comp = genimg_get_comp_id(argv[6]);
+		if (st.comp < 0) {
+			printf("** Unknown compression %s **\n", argv[6]);
+			return 1;
+		}
+	}
+
+	if (fs_set_blk_dev(argv[1], (argc >= 3) ? argv[2] : NULL, fstype))
+		return 1;
+
+	if (argc >= 4) {
+		addr = simple_strtoul(argv[3], NULL, 16);
+	} else {
+		addr_str = getenv("loadaddr");
+		if (addr_str != NULL)
+			addr = simple_strtoul(addr_str, NULL, 16);
+		else
+			addr = CONFIG_SYS_LOAD_ADDR;
+	}
+	if (argc >= 5) {
+		filename = argv[4];
+	} else {
+		filename = getenv("bootfile");
+		if (!filename) {
+			puts("** No boot file defined **\n");
+			return 1;
+		}
+	}
+	/* Without a limit keep to what bootm would unpack, not all of RAM */
+	if (argc >= 6 && simple_strtoul(argv[5], NULL, 16))
+		bytes = simple_strtoul(argv[5], NULL, 16);
+	else
+		bytes = CONFIG_SYS_BOOTM_LEN;
+
+	dst = map_sysmem(addr, bytes);
+	st.dst = dst;
+	st.dstlen = bytes;
+
+	time = get_timer(0);
+	len_read = fs_read_stream(filename, LOADZ_CHUNK, loadz_chunk, &st);
+	len = st.ds ? decomp_end(st.ds) : -1;
+	time = get_timer(time);
+
+	if (len_read >= 0 && len < 0)
+		puts("** Compressed data truncated **\n");
+	if (len_read < 0 || len < 0)
+		goto err;
+
+	if (st.hdr) {
+		if (st.dcrc != image_get_dcrc(st.hdr)) {
+			puts("** Bad Data CRC **\n");
+			goto err;
+		}
+
+		/* Turn it into an uncompressed image bootm can run in place */
+		image_set_comp(st.hdr, IH_COMP_NONE);
+		image_set_size(st.hdr, len);
+		image_set_dcrc(st.hdr, st.ucrc);
+		image_set_hcrc(st.hdr, 0);
+		image_set_hcrc(st.hdr, crc32(0, (uchar *)st.hdr,
+					     image_get_header_size()));
+		len += image_get_header_size();
+	}
+	unmap_sysmem(dst);
+
+	printf("%d bytes read, %ld bytes uncompressed in %lu ms",
+	       len_read, len, time);
+	if (time > 0) {
+		puts(" (");
+		print_size(len / time * 1000, "/s");
+		puts(")");
+	}
+	puts("\n");
+
+	setenv_hex("filesize", len);
+
+	return 0;
+
+err:
+	unmap_sysmem(dst);
+	return 1;
+}
+#endif /* CONFIG_DECOMP_STREAM */
+
 int do_ls(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[],
 	int fstype)
 {
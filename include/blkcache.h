@@ -0,0 +1,98 @@
+/*
+ * Block device read cache
+ *
+ * See file CREDITS for list of people who contributed to this
+ * project.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ */
+#ifndef __BLKCACHE_H
+#define __BLKCACHE_H
+
+/* Largest read (in blocks) that is kept in the cache */
+#ifndef CONFIG_BLOCK_CACHE_MAX_BLOCKS
+#define CONFIG_BLOCK_CACHE_MAX_BLOCKS	8
+#endif
+
+/* Number of reads kept in the cache */
+#ifndef CONFIG_BLOCK_CACHE_MAX_ENTRIES
+#define CONFIG_BLOCK_CACHE_MAX_ENTRIES	32
+#endif
+
+struct block_cache_stats {
+	unsigned hits;
+	unsigned misses;
+	unsigned entries;		/* current entry count */
+	unsigned max_blocks_per_entry;
+	unsigned max_entries;
+};
+
+#ifdef CONFIG_BLOCK_CACHE
+/**
+ * blkcache_read() - attempt to read a set of blocks from the cache
+ *
+ * @iftype:	IF_TYPE_x of the block device
+ * @dev:	device number
+ * @start:	first block
+ * @blkcnt:	number of blocks
+ * @blksz:	block size in bytes
+ * @buffer:	destination
+ *
+ * Returns 1 if the blocks were copied from the cache, 0 otherwise.
+ */
+int blkcache_read(int iftype, int dev, lbaint_t start, lbaint_t blkcnt,
+		  unsigned long blksz, void *buffer);
+
+/**
+ * blkcache_fill() - remember the result of a successful device read
+ *
+ * Reads larger than the configured entry size are not cached. The least
+ * recently used entry is recycled once the cache is full.
+ */
+void blkcache_fill(int iftype, int dev, lbaint_t start, lbaint_t blkcnt,
+		   unsigned long blksz, const void *buffer);
+
+/**
+ * blkcache_invalidate() - drop all cached blocks of a device
+ *
+ * Must be called by the driver on every write and whenever the device
+ * is (re)initialized or its addressable area changes.
+ */
+void blkcache_invalidate(int iftype, int dev);
+
+/**
+ * blkcache_configure() - resize the cache, dropping its current contents
+ */
+void blkcache_configure(unsigned blocks, unsigned entries);
+
+/**
+ * blkcache_stats() - return hit/miss counters and resize parameters
+ *
+ * The counters are reset after reading them.
+ */
+void blkcache_stats(struct block_cache_stats *stats);
+#else
+static inline int blkcache_read(int iftype, int dev, lbaint_t start,
+				lbaint_t blkcnt, unsigned long blksz,
+				void *buffer)
+{ return 0; }
+static inline void blkcache_fill(int iftype, int dev, lbaint_t start,
+				 lbaint_t blkcnt, unsigned long blksz,
+				 const void *buffer) {}
+static inline void blkcache_invalidate(int iftype, int dev) {}
+#endif
+
+#endif /* __BLKCACHE_H */
@@ -158,8 +158,11 @@
 /*
  * Size of malloc() pool
  * 1MB = 0x100000, 0x100000 = 1024 * 1024
+ * plus room for the FAT cache. The pool sits just below U-Boot, so this
+ * leaves about 24MB for an initrd at CONFIG_BOOTSCAN_INITRD_LOAD_ADDR.
  */
-#define CONFIG_SYS_MALLOC_LEN		(CONFIG_ENV_SIZE + (1 << 20))
+#define CONFIG_SYS_MALLOC_LEN		(CONFIG_ENV_SIZE + (1 << 20) + \
+					 CONFIG_FAT_CACHE_SIZE)
 						/* initial data */
 /*
  * select serial console configuration
@@ -182,8 +185,28 @@
 #define CONFIG_SYS_USB_EHCI_MAX_ROOT_PORTS	10
 
 #define CONFIG_USB_STORAGE
+#define CONFIG_USB_STOR_READAHEAD	(128 << 10)
 #define CONFIG_PARTITIONS
 #define HAVE_BLOCK_DEVICE
+#define CONFIG_BLOCK_CACHE
+#define CONFIG_CMD_BLOCK_CACHE
+
+#define CONFIG_USE_ARCH_MEMCPY
+#define CONFIG_USE_ARCH_MEMCPY_NEON
+#define CONFIG_USE_ARCH_MEMSET
+#define CONFIG_CRC32_SLICE8
+#define CONFIG_CMD_MEMBENCH
+
+#define CONFIG_HASH
+#define CONFIG_ACE_HASH
+#define CONFIG_MD5
+#define CONFIG_SHA1
+#define CONFIG_SHA256
+#define CONFIG_CMD_HASH
+
+#define CONFIG_FIT
+#define CONFIG_SMP
+#define CONFIG_SMP_NR_CPUS	4
 
 /* allow to overwrite serial and ethaddr */
 #define CONFIG_ENV_OVERWRITE
@@ -266,10 +289,15 @@
 #define CONFIG_FS_EXT4
 #define CONFIG_CMD_EXT4
 #define CONFIG_FS_FAT
+#define CONFIG_FAT_CACHE_SIZE	(4 << 20)
+#define CONFIG_FS_DIRCACHE
 #define CONFIG_CMD_FAT
 #define CONFIG_CMD_FS_GENERIC
+#define CONFIG_LZ4
+#define CONFIG_DECOMP_STREAM
 
 #define CONFIG_CMD_BOOTSCAN
+#define CONFIG_BOOTSCAN_INVENTORY
 #define CONFIG_MENU
 #define CONFIG_MENU_SHOW
 
@@ -540,6 +568,7 @@
 #define CONFIG_CMD_NET
 #define CONFIG_USB_HOST_ETHER
 #define CONFIG_USB_ETHER_SMSC95XX
+#define CONFIG_TFTP_WINDOWSIZE		16
 
 /* GPIO */
 #define GPIO_BASE			0x11000000
@@ -0,0 +1,57 @@
+/*
+ * Incremental decompression of gzip, lzop, lzma and lz4 streams
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#ifndef _DECOMP_H
+#define _DECOMP_H
+
+/*
+ * The compressed stream is handed over in pieces of any size as it
+ * arrives, typically straight from a storage read, and the output is
+ * written to the destination buffer as soon as it can be decoded. Only
+ * headers or lzop blocks that are split between two pieces are copied
+ * aside, so the compressed image never has to be staged in full.
+ */
+struct decomp_stream;
+
+/*
+ * Guess the compression of a stream from its first bytes. Returns
+ * IH_COMP_GZIP, IH_COMP_LZO or IH_COMP_LZ4, or IH_COMP_NONE if no magic
+ * matches.
+ * Raw lzma streams have no magic and are never detected.
+ */
+int decomp_detect(const void *src, ulong len);
+
+/*
+ * Start decompressing a stream of type "comp" (IH_COMP_*) to "dst",
+ * writing at most "dstlen" bytes. Returns NULL if the type is not
+ * supported or out of memory.
+ */
+struct decomp_stream *decomp_start(int comp, void *dst, ulong dstlen);
+
+/*
+ * Feed the next "len" bytes of the stream. Returns 0 if more input is
+ * needed, 1 once the end of the stream has been decoded (any further
+ * input is ignored) and < 0 on a corrupt stream or output overrun.
+ */
+int decomp_feed(struct decomp_stream *ds, const void *src, ulong len);
+
+/* Number of bytes written to the destination so far */
+ulong decomp_outlen(const struct decomp_stream *ds);
+
+/*
+ * Free the stream. Returns the number of bytes written to the
+ * destination if the end of the stream was reached, -1 otherwise.
+ */
+long decomp_end(struct decomp_stream *ds);
+
+#endif /* _DECOMP_H */
@@ -38,7 +38,57 @@ typedef struct _ext4_chunk_header {
 #define EXT4_CHUNK_TYPE_RAW			0xCAC1
 #define EXT4_CHUNK_TYPE_FILL		0xCAC2
 #define EXT4_CHUNK_TYPE_NONE		0xCAC3
+#define EXT4_CHUNK_TYPE_CRC32		0xCAC4
+
+/*
+ * Staging buffer of the streaming writer. It gathers small RAW pieces
+ * into large block writes and holds the replicated FILL pattern.
+ */
+#ifndef CONFIG_EXT4_SPARSE_BUF_SIZE
+#define CONFIG_EXT4_SPARSE_BUF_SIZE	(256 * 1024)
+#endif
+
+/* streaming writer states */
+enum {
+	EXT4_SPARSE_FILE_HDR,
+	EXT4_SPARSE_CHUNK_HDR,
+	EXT4_SPARSE_RAW,
+	EXT4_SPARSE_FILL,
+	EXT4_SPARSE_SKIP,
+	EXT4_SPARSE_DONE,
+	EXT4_SPARSE_ERROR,
+};
+
+struct ext4_sparse_ctx {
+	block_dev_desc_t *dev;
+	lbaint_t sector_base;		/* first sector of the target */
+	lbaint_t sector_limit;		/* target size in sectors, 0: unchecked */
+	lbaint_t sector;		/* next sector, relative to sector_base */
+	int state;
+
+	ext4_file_header file_header;
+	ext4_chunk_header chunk_header;
+	unsigned char hdr[32];		/* header bytes gathered so far */
+	unsigned int hdr_len;
+	unsigned int hdr_want;
+
+	unsigned int chunks_left;
+	unsigned int chunk_left;	/* payload bytes left in this chunk */
+	lbaint_t chunk_sectors;		/* sectors covered by this chunk */
+
+	unsigned char *buf;		/* CONFIG_EXT4_SPARSE_BUF_SIZE bytes */
+	unsigned int buf_len;
+	unsigned char *bufs[2];		/* buf alternates between these */
+	int inflight;			/* a block_write_start is pending */
+	int inflight_user;		/* ... on the caller's buffer */
+	unsigned int fill;
+};
 
 int write_compressed_ext4(char* img_base, unsigned int sector_base);
 int check_compress_ext4(char *img_base, unsigned long long parti_size);
 
+int ext4_sparse_init(struct ext4_sparse_ctx *ctx, block_dev_desc_t *dev,
+		     lbaint_t sector_base, lbaint_t sector_limit);
+int ext4_sparse_write(struct ext4_sparse_ctx *ctx, const void *data,
+		      unsigned int len);
+int ext4_sparse_finish(struct ext4_sparse_ctx *ctx);
@@ -0,0 +1,68 @@
+/*
+ * Directory name cache for the filesystem drivers
+ *
+ * See file CREDITS for list of people who contributed to this
+ * project.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ */
+
+#ifndef _DIRCACHE_H_
+#define _DIRCACHE_H_
+
+#ifndef CONFIG_FS_DIRCACHE_SIZE
+#define CONFIG_FS_DIRCACHE_SIZE	(128 << 10)
+#endif
+
+#define DIRCACHE_HASH_SIZE	256	/* power of two */
+#define DIRCACHE_MAX_DIRS	32
+
+struct dircache_ent;
+
+/*
+ * Names looked up on one mounted filesystem. An entry maps a name in
+ * a directory, both identified by the driver, to a driver specific
+ * record such as a FAT directory entry or an ext4 inode number, or
+ * records that the name does not exist.
+ *
+ * A driver that has added every name of a directory marks it done;
+ * names missing from it do not exist. Once the size limit is reached
+ * 'full' is set and nothing more is added until dircache_flush(),
+ * which must be called whenever the filesystem is mounted, unmounted
+ * or written to. A zeroed struct dircache is empty.
+ */
+struct dircache {
+	struct dircache_ent *hash[DIRCACHE_HASH_SIZE];
+	ulong done[DIRCACHE_MAX_DIRS];
+	int ndone;
+	int full;
+	unsigned int size;	/* bytes allocated */
+};
+
+void dircache_flush(struct dircache *dc);
+int dircache_add(struct dircache *dc, ulong dir, const char *name,
+		 int namelen, const void *rec, int len);
+int dircache_done(struct dircache *dc, ulong dir);
+int dircache_lookup(struct dircache *dc, ulong dir, const char *name,
+		    void *rec, int len);
+
+/* Whether another complete directory can be added */
+static inline int dircache_room(struct dircache *dc)
+{
+	return !dc->full && dc->ndone < DIRCACHE_MAX_DIRS;
+}
+
+#endif /* _DIRCACHE_H_ */
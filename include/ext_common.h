@@ -101,6 +101,27 @@ struct ext2_sblock {
 	char volume_name[16];
 	char last_mounted_on[64];
 	uint32_t compression_info;
+	uint8_t prealloc_blocks;
+	uint8_t prealloc_dir_blocks;
+	uint16_t reserved_gdt_blocks;
+	uint8_t journal_uuid[16];
+	uint32_t journal_inode;
+	uint32_t journal_dev;
+	uint32_t last_orphan;
+	uint32_t hash_seed[4];
+	uint8_t default_hash_version;
+	uint8_t journal_backup_type;
+	uint16_t descriptor_size;
+	uint32_t default_mount_options;
+	uint32_t first_meta_block_group;
+	uint32_t mkfs_time;
+	uint32_t journal_blocks[17];
+	uint32_t total_blocks_high;
+	uint32_t reserved_blocks_high;
+	uint32_t free_blocks_high;
+	uint16_t min_extra_inode_size;
+	uint16_t want_extra_inode_size;
+	uint32_t flags;
 };
 
 struct ext2_block_group {
@@ -159,6 +180,10 @@ struct ext2fs_node {
 	struct ext2_inode inode;
 	int ino;
 	int inode_read;
+	/* extent looked up last, see ext4fs_map_blocks() */
+	uint32_t ext_first;	/* first file block */
+	uint32_t ext_len;	/* 0 if nothing cached */
+	uint64_t ext_start;	/* first filesystem block, 0 for a hole */
 };
 
 /* Information about a "mounted" ext2 filesystem. */
@@ -149,6 +149,14 @@ struct cmd_fastboot_interface
 	   Set by board	*/ 
 	unsigned int transfer_buffer_size;
 
+	/* Receive the next size bytes of a download by DMA straight
+	   into buffer instead of packet by packet. rx_handler is then
+	   called with pieces of buffer itself as they complete.
+	   Returns 0 if the transfer was set up. Optional.
+
+	   Set by board */
+	int (*rx_dma)(unsigned char *buffer, unsigned int size);
+
 };
 
 /* Android-style flash naming */
@@ -11,6 +11,7 @@
 #define _FAT_H_
 
 #include <asm/byteorder.h>
+#include <fs.h>
 
 #define CONFIG_SUPPORT_VFAT
 /* Maximum Long File Name length supported here is 128 UTF-16 code units */
@@ -29,6 +30,18 @@
 #define FAT16BUFSIZE	(FATBUFSIZE/2)
 #define FAT32BUFSIZE	(FATBUFSIZE/4)
 
+/*
+ * With CONFIG_FAT_CACHE_SIZE a FAT of up to that many bytes is kept in
+ * RAM from fat_set_blk_dev() to fat_close(), filled FAT_CACHE_BLOCKS
+ * sectors at a time as entries are needed. Larger FATs, or a FAT that
+ * does not fit in the malloc pool, are read through the FATBUFBLOCKS
+ * window.
+ */
+#define FAT_CACHE_BLOCKS	64
+
+/* Bytes read at a time into buffers that are not DMA aligned */
+#define FAT_BOUNCE_SIZE		(128 * 1024)
+
 #define SECTOR_SIZE     512
 #define BYTE_PER_SEC    512
 #define RESERVED_CNT    32
@@ -254,6 +267,10 @@ typedef struct {
 	__u16	clust_size;	/* Size of clusters in sectors */
 	int	data_begin;	/* The sector of the first cluster, can be negative */
 	int	fatbufnum;	/* Used by get_fatent, init to -1 */
+	int	fatbufdirty;	/* fatbuf changed, written back on switch */
+	__u8	*fatcache;	/* Whole FAT or NULL, see CONFIG_FAT_CACHE_SIZE */
+	__u8	*fatcache_valid; /* Flag per FAT_CACHE_BLOCKS sectors read */
+	__u8	*fatcache_dirty; /* Flag per sector changed, write only */
 } fsdata;
 
 typedef int	(file_detectfs_func)(void);
@@ -277,6 +294,7 @@ file_read_func		file_fat_read;
 int file_cd(const char *path);
 int file_fat_detectfs(void);
 int file_fat_ls(const char *dir);
+int fat_readdir(const char *dirname, fs_dir_func *func, void *priv);
 long file_fat_read_at(const char *filename, unsigned long pos, void *buffer,
 		      unsigned long maxsize);
 long file_fat_read(const char *filename, void *buffer, unsigned long maxsize);
@@ -286,5 +304,8 @@ int fat_register_device(block_dev_desc_t *dev_desc, int part_no);
 
 int file_fat_write(const char *filename, void *buffer, unsigned long maxsize);
 int fat_read_file(const char *filename, void *buf, int offset, int len);
+int fat_open_file(const char *filename);
+int fat_map_file(ulong offset, ulong maxlen, lbaint_t *sect, ulong *len);
+void fat_release_file(void);
 void fat_close(void);
 #endif /* _FAT_H_ */
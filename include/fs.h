@@ -23,6 +23,26 @@
 #define FS_TYPE_EXT	2
 #define FS_TYPE_SANDBOX	3
 
+#define FS_DT_UNKNOWN	0
+#define FS_DT_REG	1
+#define FS_DT_DIR	2
+#define FS_DT_LNK	3
+
+/*
+ * A directory entry as passed to the callback of fat_readdir() and
+ * ext4fs_readdir(). The name is only valid during the call. mtime is
+ * in the filesystem's own encoding and only good for telling whether
+ * the entry has changed.
+ */
+struct fs_dirent {
+	const char *name;
+	int type;		/* FS_DT_* */
+	unsigned long size;
+	unsigned long mtime;
+};
+
+typedef void (fs_dir_func)(void *priv, const struct fs_dirent *dent);
+
 /*
  * Tell the fs layer which block device an partition to use for future
  * commands. This also internally identifies the filesystem that is present
@@ -54,12 +74,33 @@ int fs_ls(const char *dirname);
  */
 int fs_read(const char *filename, ulong addr, int offset, int len);
 
+/*
+ * Read file "filename" from the partition previously set by fs_set_blk_dev()
+ * a piece of "chunk" bytes at a time, handing each piece to "func" as soon
+ * as it has been read. Reading stops early when "func" returns 1, and with
+ * an error when it returns < 0. "chunk" must be a multiple of the device
+ * block size.
+ *
+ * Filesystems that can map a file to device blocks keep it open for the
+ * whole read and read the next piece while "func" runs, if the device can
+ * start a read without waiting for it. Others read each piece with an
+ * offset, for which the filesystem must support offset!=0.
+ *
+ * Returns number of bytes read on success. Returns < 0 on error.
+ */
+typedef int (fs_stream_func)(void *priv, const void *buf, int len);
+
+int fs_read_stream(const char *filename, int chunk, fs_stream_func *func,
+		   void *priv);
+
 /*
  * Common implementation for various filesystem commands, optionally limited
  * to a specific filesystem type via the fstype parameter.
  */
 int do_load(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[],
 		int fstype);
+int do_loadz(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[],
+		int fstype);
 int do_ls(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[],
 		int fstype);
 int do_save(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[],
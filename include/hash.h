@@ -0,0 +1,53 @@
+/*
+ * Hash algorithm registry
+ *
+ * See file CREDITS for list of people who contributed to this
+ * project.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ */
+
+#ifndef _HASH_H_
+#define _HASH_H_
+
+#define HASH_MAX_DIGEST_SIZE	32	/* sha256 */
+
+/*
+ * A hash implementation. The software versions are built in; drivers
+ * for crypto hardware register their own entries with hash_register()
+ * and are preferred over the software ones of the same name.
+ *
+ * hash_func_ws() hashes a whole buffer, calling WATCHDOG_RESET at
+ * least every chunk_sz bytes. A driver may return non-zero for a
+ * buffer it cannot handle, the software version is used instead.
+ */
+struct hash_algo {
+	const char *name;		/* "crc32", "md5", "sha1", ... */
+	int digest_size;		/* bytes */
+	unsigned int chunk_size;	/* watchdog chunk size */
+	int (*hash_func_ws)(const unsigned char *input, unsigned int ilen,
+			unsigned char *output, unsigned int chunk_sz);
+	struct hash_algo *next;
+};
+
+void hash_init(void);
+int hash_register(struct hash_algo *algo);
+struct hash_algo *hash_lookup_algo(const char *name);
+int hash_has_driver(const char *name);
+int hash_block(const char *name, const void *data, unsigned int len,
+		unsigned char *output, int *output_size);
+
+#endif /* _HASH_H_ */
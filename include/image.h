@@ -56,6 +56,7 @@
 #include <fdt_support.h>
 #define CONFIG_MD5		/* FIT images need MD5 support */
 #define CONFIG_SHA1		/* and SHA1 */
+#define CONFIG_SHA256		/* and SHA256 */
 #endif
 
 /*
@@ -166,6 +167,11 @@
 #define IH_COMP_BZIP2		2	/* bzip2 Compression Used	*/
 #define IH_COMP_LZMA		3	/* lzma  Compression Used	*/
 #define IH_COMP_LZO		4	/* lzo   Compression Used	*/
+#define IH_COMP_LZ4		5	/* lz4   Compression Used	*/
+
+#ifndef CONFIG_SYS_BOOTM_LEN
+#define CONFIG_SYS_BOOTM_LEN	0x800000	/* use 8MByte as default max gunzip size */
+#endif
 
 #define IH_MAGIC	0x27051956	/* Image Magic Number		*/
 #define IH_NMLEN		32	/* Image Name Length		*/
@@ -282,6 +288,10 @@ typedef struct bootm_headers {
 #define CHUNKSZ_SHA1 (64 * 1024)
 #endif
 
+#ifndef CHUNKSZ_SHA256
+#define CHUNKSZ_SHA256 (64 * 1024)
+#endif
+
 #define uimage_to_cpu(x)		be32_to_cpu(x)
 #define cpu_to_uimage(x)		cpu_to_be32(x)
 
@@ -543,7 +553,7 @@ static inline int image_check_target_arch (const image_header_t *hdr)
 #define FIT_FDT_PROP		"fdt"
 #define FIT_DEFAULT_PROP	"default"
 
-#define FIT_MAX_HASH_LEN	20	/* max(crc32_len(4), sha1_len(20)) */
+#define FIT_MAX_HASH_LEN	32	/* max(crc32_len(4), sha256_len(32)) */
 
 /* cmdline argument format parsing */
 inline int fit_parse_conf (const char *spec, ulong addr_curr,
@@ -618,6 +628,11 @@ int fit_image_hash_set_value (void *fit, int noffset, uint8_t *value,
 
 int fit_image_check_hashes (const void *fit, int noffset);
 int fit_all_image_check_hashes (const void *fit);
+#ifdef CONFIG_SMP
+void fit_image_hash_start (const void *fit, int image_noffset);
+void fit_conf_hash_start (const void *fit, int noffset);
+void fit_image_hash_discard (void);
+#endif
 int fit_image_check_os (const void *fit, int noffset, uint8_t os);
 int fit_image_check_arch (const void *fit, int noffset, uint8_t arch);
 int fit_image_check_type (const void *fit, int noffset, uint8_t type);
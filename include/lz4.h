@@ -0,0 +1,73 @@
+#ifndef __LZ4_H__
+#define __LZ4_H__
+/*
+ * LZ4 decompression, frame and legacy formats
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ */
+
+#define LZ4_FRAME_MAGIC		0x184d2204
+#define LZ4_LEGACY_MAGIC	0x184c2102
+
+/*
+ * Incremental decoder state. The whole output stays in the destination
+ * buffer, which is also where matches are copied from, so no history
+ * is kept here.
+ */
+struct lz4_stream {
+	unsigned char *dst;
+	size_t dstlen;
+	size_t outlen;
+	int state;		/* where in the frame */
+	int seq;		/* where in the current sequence */
+	int legacy;
+	unsigned int flags;	/* frame descriptor FLG byte */
+	unsigned long long content_size;
+	unsigned char hdr[20];	/* header or size field split between feeds */
+	size_t have;
+	size_t need;
+	size_t block;		/* compressed bytes left in the current block */
+	int raw;		/* current block is stored uncompressed */
+	unsigned int token;
+	size_t lit;
+	size_t mlen;
+	unsigned int off;
+};
+
+/* Start decoding a frame or legacy stream to dst, at most dstlen bytes */
+void lz4_stream_init(struct lz4_stream *s, unsigned char *dst, size_t dstlen);
+
+/*
+ * Decode the next len bytes of the stream. Returns 0 if more input is
+ * needed, 1 at the end of a frame and < 0 on error. Legacy streams have
+ * no end marker, so they never return 1.
+ */
+int lz4_stream_feed(struct lz4_stream *s, const unsigned char *src,
+		    size_t len);
+
+/* True if the stream ended, or a legacy stream may end, at this point */
+int lz4_stream_done(const struct lz4_stream *s);
+
+/* decode one block, back references may reach down to base */
+int lz4_decompress_block(const unsigned char *src, size_t src_len,
+			 unsigned char *dst, size_t *dst_len,
+			 const unsigned char *base);
+
+/* decompress lz4 frame or legacy format */
+int lz4_decompress(const unsigned char *src, size_t src_len,
+		   unsigned char *dst, size_t *dst_len);
+
+/*
+ * Return values (< 0 = Error)
+ */
+#define LZ4_E_OK			0
+#define LZ4_E_ERROR			(-1)
+#define LZ4_E_INPUT_OVERRUN		(-4)
+#define LZ4_E_OUTPUT_OVERRUN		(-5)
+#define LZ4_E_LOOKBEHIND_OVERRUN	(-6)
+#define LZ4_E_NOT_SUPPORTED		(-9)
+
+#endif
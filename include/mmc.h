@@ -42,11 +42,19 @@
 
 
 #define SD_DATA_4BIT	(0x1<<18)
+#define SD_DATA_CMD23	(0x1<<1)	/* SCR: SET_BLOCK_COUNT supported */
 
 #define IS_SD(x) (x->version & SD_VERSION_SD)
 
 #define MMC_DATA_READ		1
 #define MMC_DATA_WRITE		2
+#define MMC_DATA_SBC		4	/* block count preset, no auto stop */
+#define MMC_DATA_ASYNC		8	/* return once the data phase runs */
+
+/* largest transfer a single command may move, unless the host sets b_max */
+#ifndef CONFIG_SYS_MMC_MAX_BLK_COUNT
+#define CONFIG_SYS_MMC_MAX_BLK_COUNT	65535
+#endif
 
 #define NO_CARD_ERR		-16 /* No SD/MMC card inserted */
 #define UNUSABLE_ERR		-17 /* Unusable Card */
@@ -68,6 +76,7 @@
 #define MMC_CMD_SET_BLOCKLEN		16
 #define MMC_CMD_READ_SINGLE_BLOCK	17
 #define MMC_CMD_READ_MULTIPLE_BLOCK	18
+#define MMC_CMD_SET_BLOCK_COUNT		23
 #define MMC_CMD_WRITE_SINGLE_BLOCK	24
 #define MMC_CMD_WRITE_MULTIPLE_BLOCK	25
 #define MMC_CMD_APP_CMD			55
@@ -174,6 +183,8 @@
 #define MMC_MODE_4BIT_DDR	0x400
 #define MMC_MODE_8BIT_DDR	0x800
 
+#define MMC_MODE_SBC		0x1000	/* SET_BLOCK_COUNT (CMD23) transfers */
+
 #define R1_ILLEGAL_COMMAND		(1 << 22)
 #define R1_APP_CMD			(1 << 5)
 
@@ -301,6 +312,20 @@ struct mmc_data {
 #define __iomem
 #endif
 
+/* state of a transfer started with mmc_bread_start/mmc_bwrite_start */
+struct mmc_async {
+	int active;		/* started, not yet reaped */
+	int inflight;		/* host data phase running */
+	int err;		/* result of the last data phase */
+	int write;
+	ulong start;
+	lbaint_t left;
+	lbaint_t cur;		/* blocks of the running chunk */
+	char *buf;
+	struct mmc_cmd cmd;
+	struct mmc_data data;
+};
+
 struct mmc {
 	struct list_head link;
 	char name[32];
@@ -322,14 +347,18 @@ struct mmc {
 	uint tran_speed;
 	uint read_bl_len;
 	uint write_bl_len;
+	uint b_max;		/* max blocks per transfer, 0: default */
 	u32 capacity;
 	void __iomem *		ioaddr;		/* Mapped address */
 	struct mmc_ext_csd	ext_csd;	/* mmc v4 extended card specific */
 	block_dev_desc_t block_dev;
 	int (*send_cmd)(struct mmc *mmc,
 			struct mmc_cmd *cmd, struct mmc_data *data);
+	/* reap an MMC_DATA_ASYNC transfer, 1 while still running */
+	int (*data_done)(struct mmc *mmc, int wait);
 	void (*set_ios)(struct mmc *mmc);
 	int (*init)(struct mmc *mmc);
+	struct mmc_async async;
 };
 
 int mmc_register(struct mmc *mmc);
@@ -340,6 +369,10 @@ struct mmc *find_mmc_device(int dev_num);
 void print_mmc_devices(char separator);
 int board_mmc_getcd(u8 *cd, struct mmc *mmc);
 int mmc_erase(struct mmc *mmc, int part, u32 start, u32 block);
+int mmc_bread_start(int dev_num, lbaint_t start, lbaint_t blkcnt, void *dst);
+int mmc_bwrite_start(int dev_num, lbaint_t start, lbaint_t blkcnt,
+		     const void *src);
+int mmc_xfer_done(int dev_num, int wait);
 
 int emmc_boot_open(struct mmc *host);
 int emmc_boot_close(struct mmc *host);
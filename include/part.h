@@ -37,6 +37,19 @@ typedef struct block_dev_desc {
 	unsigned long   (*block_erase)(int dev,
 				       lbaint_t start,
 				       lbaint_t blkcnt);
+	/*
+	 * Optional split transfers: *_start returns once the transfer is
+	 * queued, block_xfer_done reaps it (0 done, 1 busy, <0 error).
+	 */
+	int		(*block_read_start)(int dev,
+					    lbaint_t start,
+					    lbaint_t blkcnt,
+					    void *buffer);
+	int		(*block_write_start)(int dev,
+					     lbaint_t start,
+					     lbaint_t blkcnt,
+					     const void *buffer);
+	int		(*block_xfer_done)(int dev, int wait);
 	void		*priv;		/* driver private struct pointer */
 }block_dev_desc_t;
 
@@ -349,6 +349,13 @@ struct mshci_idmac {
 #define MSHCI_IDMAC_FS          (1<<3)
 #define MSHCI_IDMAC_LD          (1<<2)
 #define MSHCI_IDMAC_DIC         (1<<1)
+/* des1: buffer sizes, 13 bits each */
+#define MSHCI_IDMAC_BS1(x)      ((x) & 0x1fff)
+#define MSHCI_IDMAC_BS2(x)      (((x) & 0x1fff) << 13)
+/* largest page aligned buffer that fits the 13 bit size field */
+#define MSHCI_IDMAC_BUF_SIZE    0x1000
+/* CMD23 block count is 16 bits */
+#define MSHCI_MAX_BLK_COUNT     65535
 #define INTMSK_IDMAC_ALL        (0x337)
 #define INTMSK_IDMAC_ERROR      (0x214)        
 };
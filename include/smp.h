@@ -0,0 +1,74 @@
+/*
+ * Run jobs on secondary cores
+ *
+ * See file CREDITS for list of people who contributed to this
+ * project.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ */
+
+#ifndef _SMP_H_
+#define _SMP_H_
+
+#ifndef CONFIG_SMP_NR_CPUS
+#define CONFIG_SMP_NR_CPUS	4
+#endif
+
+#ifndef CONFIG_SMP_STACK_SIZE
+#define CONFIG_SMP_STACK_SIZE	(16 << 10)
+#endif
+
+#define SMP_JOB_IDLE		0
+#define SMP_JOB_QUEUED		1	/* waiting for a core */
+#define SMP_JOB_RUNNING		2
+#define SMP_JOB_DONE		3
+
+/*
+ * A unit of work. func() runs on whichever core is free, or on the boot
+ * core from smp_job_wait() if none is, so it must not print, allocate
+ * memory or touch devices the boot core may be using: plain
+ * computation on memory handed in through arg only.
+ */
+struct smp_job {
+	int (*func)(void *arg);
+	void *arg;
+	volatile int ret;
+	volatile int state;
+	int cpu;			/* core that ran it, 0 = boot core */
+	struct smp_job *next;		/* queue link, dispatcher private */
+};
+
+int smp_job_start(struct smp_job *job);
+int smp_job_wait(struct smp_job *job);
+void smp_job_cancel(struct smp_job *job);
+int smp_cpus_online(void);
+void smp_shutdown(void);
+
+/*
+ * Provided by the SoC code. smp_arch_start() brings up secondary core
+ * 'cpu' so that it calls smp_secondary_loop(cpu) on stack 'sp' with gd
+ * set up; smp_arch_park() is called on the secondary itself before the
+ * OS is started and does not return.
+ */
+int smp_arch_start(int cpu, ulong sp);
+void smp_arch_park(int cpu);
+void smp_arch_barrier(void);
+void smp_arch_wait_event(void);
+void smp_arch_send_event(void);
+
+void smp_secondary_loop(int cpu);
+
+#endif /* _SMP_H_ */
@@ -29,5 +29,6 @@
 uint32_t crc32 (uint32_t, const unsigned char *, uint);
 uint32_t crc32_wd (uint32_t, const unsigned char *, uint, uint);
 uint32_t crc32_no_comp (uint32_t, const unsigned char *, uint);
+uint32_t crc32_combine (uint32_t, uint32_t, uint);
 
 #endif /* _UBOOT_CRC_H */
@@ -150,6 +150,17 @@ int submit_control_msg(struct usb_device *dev, unsigned long pipe, void *buffer,
 int submit_int_msg(struct usb_device *dev, unsigned long pipe, void *buffer,
 			int transfer_len, int interval);
 
+#ifdef CONFIG_USB_EHCI
+/* Several bulk in transfers kept queued on one endpoint */
+struct bulk_queue;
+struct bulk_queue *create_bulk_queue(struct usb_device *dev,
+			unsigned long pipe, int queuesize, int elementsize,
+			void *buffer);
+void *poll_bulk_queue(struct usb_device *dev, struct bulk_queue *queue,
+			int *len);
+int destroy_bulk_queue(struct usb_device *dev, struct bulk_queue *queue);
+#endif
+
 /* Defines */
 #define USB_UHCI_VEND_ID	0x8086
 #define USB_UHCI_DEV_ID		0x7112
@@ -35,10 +35,29 @@ struct ueth_data {
 	unsigned char	protocol;		/* .............. */
 	unsigned char	irqinterval;	/* Intervall for IRQ Pipe */
 
+	/* receive buffers, see usb_ether_rx() */
+	unsigned char *rx_buf;
+	int rx_size;					/* bytes per transfer */
+	int rx_count;					/* transfers queued */
+	struct bulk_queue *rx_queue;
+	int rx_held;					/* rx_buf handed out */
+
 	/* driver private */
 	void *dev_priv;
 };
 
+/*
+ * Receiving for the drivers. usb_ether_rx_start() sets up count transfers of
+ * size bytes on the bulk in endpoint, kept queued on the controller where it
+ * supports it. usb_ether_rx() hands out the data of the next completed
+ * transfer, which stays valid until the following call. It returns NULL
+ * once nothing more has arrived; without a queue, every other call returns
+ * NULL, so that a receive loop does one blocking transfer per poll.
+ */
+int usb_ether_rx_start(struct ueth_data *ueth, int size, int count);
+unsigned char *usb_ether_rx(struct ueth_data *ueth, int *len);
+void usb_ether_rx_stop(struct ueth_data *ueth);
+
 /*
  * Function definitions for each USB ethernet driver go here, bracketed by
  * #ifdef CONFIG_USB_ETHER_xxx...#endif
@@ -0,0 +1,512 @@
+/*
+ * Incremental decompression of gzip, lzop, lzma and lz4 streams
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <common.h>
+#include <watchdog.h>
+#include <image.h>
+#include <malloc.h>
+#include <decomp.h>
+#include <asm/unaligned.h>
+#ifdef CONFIG_GZIP
+#include <u-boot/zlib.h>
+#endif
+#ifdef CONFIG_LZO
+#include <linux/lzo.h>
+#endif
+#ifdef CONFIG_LZMA
+#include <lzma/LzmaTypes.h>
+#include <lzma/LzmaDec.h>
+#endif
+#ifdef CONFIG_LZ4
+#include <lz4.h>
+#endif
+
+#define DECOMP_STAGE_SIZE	512	/* enough for any header */
+
+#define LZOP_HEADER		0
+#define LZOP_BLOCK		1
+#define LZOP_DATA		2
+
+#define LZOP_HAS_FILTER		0x00000800
+
+static const uchar lzop_magic[] = {
+	0x89, 0x4c, 0x5a, 0x4f, 0x00, 0x0d, 0x0a, 0x1a, 0x0a
+};
+
+struct decomp_stream {
+	int comp;
+	uchar *dst;
+	ulong dstlen;
+	ulong outlen;
+	int done;
+	/* Header or block split between two feeds */
+	uchar *stage;
+	ulong staged;
+	ulong stagesize;
+#ifdef CONFIG_GZIP
+	z_stream zs;
+#endif
+#ifdef CONFIG_LZO
+	int lzo_state;
+	u32 lzo_dlen;
+	u32 lzo_slen;
+#endif
+#ifdef CONFIG_LZMA
+	CLzmaDec lzma;
+	ulong lzma_size;
+	int lzma_known;
+	int lzma_init;
+#endif
+#ifdef CONFIG_LZ4
+	struct lz4_stream lz4;
+#endif
+};
+
+/*
+ * Collect the first "need" bytes of a header or block in the stage
+ * buffer, taking them from the input. Returns 1 once they are all
+ * there, 0 if the input ran out first and -1 if out of memory.
+ */
+static int decomp_stage(struct decomp_stream *ds, const uchar **src,
+			ulong *len, ulong need)
+{
+	ulong n;
+
+	if (need > ds->stagesize) {
+		uchar *p = realloc(ds->stage, need);
+
+		if (!p) {
+			puts("Error: out of memory\n");
+			return -1;
+		}
+		ds->stage = p;
+		ds->stagesize = need;
+	}
+
+	if (ds->staged < need) {
+		n = min(need - ds->staged, *len);
+		memcpy(ds->stage + ds->staged, *src, n);
+		ds->staged += n;
+		*src += n;
+		*len -= n;
+	}
+
+	return ds->staged >= need;
+}
+
+#ifdef CONFIG_GZIP
+void *zalloc(void *, unsigned, unsigned);
+void zfree(void *, void *, unsigned);
+
+static int gzip_start(struct decomp_stream *ds)
+{
+	int r;
+
+	ds->zs.zalloc = zalloc;
+	ds->zs.zfree = zfree;
+	ds->zs.next_in = Z_NULL;
+	ds->zs.avail_in = 0;
+
+	/* zlib parses the gzip header and checks the trailer itself */
+	r = inflateInit2(&ds->zs, 16 + MAX_WBITS);
+	if (r != Z_OK) {
+		printf("Error: inflateInit2() returned %d\n", r);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int gzip_feed(struct decomp_stream *ds, const uchar *src, ulong len)
+{
+	int r;
+
+	ds->zs.next_in = (uchar *)src;
+	ds->zs.avail_in = len;
+	ds->zs.next_out = ds->dst + ds->outlen;
+	ds->zs.avail_out = ds->dstlen - ds->outlen;
+
+	r = inflate(&ds->zs, Z_NO_FLUSH);
+	ds->outlen = ds->zs.next_out - ds->dst;
+
+	if (r == Z_STREAM_END)
+		return 1;
+	if (r != Z_OK && r != Z_BUF_ERROR) {
+		printf("Error: inflate() returned %d\n", r);
+		return -1;
+	}
+	if (!ds->zs.avail_out && (ds->zs.avail_in || r == Z_BUF_ERROR)) {
+		puts("Error: uncompressed data too large\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+static void gzip_end(struct decomp_stream *ds)
+{
+	inflateEnd(&ds->zs);
+}
+#endif /* CONFIG_GZIP */
+
+#ifdef CONFIG_LZO
+/*
+ * The lzop header has the same layout that lzop_decompress() expects.
+ * Its length depends on the version and flags and on the name stored
+ * in it, so it is collected a field at a time.
+ */
+static int lzop_header(struct decomp_stream *ds, const uchar **src,
+		       ulong *len)
+{
+	ulong need;
+	u16 version;
+	int r;
+
+	need = sizeof(lzop_magic) + 7;
+	r = decomp_stage(ds, src, len, need);
+	if (r <= 0)
+		return r;
+	if (memcmp(ds->stage, lzop_magic, sizeof(lzop_magic))) {
+		puts("Error: bad lzop header\n");
+		return -1;
+	}
+	version = get_unaligned_be16(ds->stage + sizeof(lzop_magic));
+	if (version >= 0x0940)
+		need++;			/* level */
+
+	/* flags, followed by filter, mode and mtime */
+	r = decomp_stage(ds, src, len, need + 4);
+	if (r <= 0)
+		return r;
+	if (get_unaligned_be32(ds->stage + need) & LZOP_HAS_FILTER)
+		need += 4;
+	need += 12;
+	if (version >= 0x0940)
+		need += 4;		/* mtime_high */
+
+	/* name length, name and header checksum */
+	r = decomp_stage(ds, src, len, need + 1);
+	if (r <= 0)
+		return r;
+	need += 1 + ds->stage[need] + 4;
+
+	return decomp_stage(ds, src, len, need);
+}
+
+static int lzo_feed(struct decomp_stream *ds, const uchar *src, ulong len)
+{
+	const uchar *p;
+	size_t n;
+	int r;
+
+	while (len) {
+		switch (ds->lzo_state) {
+		case LZOP_HEADER:
+			r = lzop_header(ds, &src, &len);
+			if (r <= 0)
+				return r;
+			ds->staged = 0;
+			ds->lzo_state = LZOP_BLOCK;
+			break;
+
+		case LZOP_BLOCK:
+			/* uncompressed size, 0 for the end marker */
+			r = decomp_stage(ds, &src, &len, 4);
+			if (r <= 0)
+				return r;
+			ds->lzo_dlen = get_unaligned_be32(ds->stage);
+			if (!ds->lzo_dlen)
+				return 1;
+
+			/* compressed size and checksum */
+			r = decomp_stage(ds, &src, &len, 12);
+			if (r <= 0)
+				return r;
+			ds->lzo_slen = get_unaligned_be32(ds->stage + 4);
+			if (!ds->lzo_slen || ds->lzo_slen > ds->lzo_dlen) {
+				puts("Error: bad lzop block\n");
+				return -1;
+			}
+			if (ds->lzo_dlen > ds->dstlen - ds->outlen) {
+				puts("Error: uncompressed data too large\n");
+				return -1;
+			}
+			ds->staged = 0;
+			ds->lzo_state = LZOP_DATA;
+			break;
+
+		case LZOP_DATA:
+			/* Decompress in place unless the block is split */
+			if (!ds->staged && len >= ds->lzo_slen) {
+				p = src;
+				src += ds->lzo_slen;
+				len -= ds->lzo_slen;
+			} else {
+				r = decomp_stage(ds, &src, &len, ds->lzo_slen);
+				if (r <= 0)
+					return r;
+				p = ds->stage;
+			}
+
+			if (ds->lzo_slen == ds->lzo_dlen) {
+				/* stored uncompressed */
+				memcpy(ds->dst + ds->outlen, p, ds->lzo_dlen);
+			} else {
+				n = ds->lzo_dlen;
+				r = lzo1x_decompress_safe(p, ds->lzo_slen,
+						ds->dst + ds->outlen, &n);
+				if (r != LZO_E_OK || n != ds->lzo_dlen) {
+					printf("Error: lzo1x_decompress_safe() "
+					       "returned %d\n", r);
+					return -1;
+				}
+			}
+			ds->outlen += ds->lzo_dlen;
+			ds->staged = 0;
+			ds->lzo_state = LZOP_BLOCK;
+			break;
+		}
+	}
+
+	return 0;
+}
+#endif /* CONFIG_LZO */
+
+#ifdef CONFIG_LZMA
+static void *lzma_alloc(void *p, size_t size)
+{
+	return malloc(size);
+}
+
+static void lzma_free(void *p, void *address)
+{
+	free(address);
+}
+
+static ISzAlloc lzma_allocator = { lzma_alloc, lzma_free };
+
+static int lzma_feed(struct decomp_stream *ds, const uchar *src, ulong len)
+{
+	ELzmaStatus status;
+	SizeT inlen;
+	u32 size, size_high;
+	SRes res;
+	int r;
+
+	if (!ds->lzma_init) {
+		/* properties and 64 bit uncompressed size */
+		r = decomp_stage(ds, &src, &len, LZMA_PROPS_SIZE + 8);
+		if (r <= 0)
+			return r;
+
+		size = get_unaligned_le32(ds->stage + LZMA_PROPS_SIZE);
+		size_high = get_unaligned_le32(ds->stage + LZMA_PROPS_SIZE + 4);
+		if (size == ~0U && size_high == ~0U) {
+			/* unknown, the stream has an end marker */
+			ds->lzma_size = ds->dstlen;
+		} else if (size_high || size > ds->dstlen) {
+			puts("Error: uncompressed data too large\n");
+			return -1;
+		} else {
+			ds->lzma_size = size;
+			ds->lzma_known = 1;
+		}
+
+		LzmaDec_Construct(&ds->lzma);
+		res = LzmaDec_AllocateProbs(&ds->lzma, ds->stage,
+					    LZMA_PROPS_SIZE, &lzma_allocator);
+		if (res != SZ_OK) {
+			printf("Error: LZMA properties returned %d\n", res);
+			return -1;
+		}
+		/* The destination is the dictionary, as in LzmaDecode() */
+		ds->lzma.dic = ds->dst;
+		ds->lzma.dicBufSize = ds->dstlen;
+		LzmaDec_Init(&ds->lzma);
+		ds->lzma_init = 1;
+	}
+
+	inlen = len;
+	res = LzmaDec_DecodeToDic(&ds->lzma, ds->lzma_size, src, &inlen,
+				  LZMA_FINISH_ANY, &status);
+	ds->outlen = ds->lzma.dicPos;
+	if (res != SZ_OK) {
+		printf("Error: LZMA decode returned %d\n", res);
+		return -1;
+	}
+	if (status == LZMA_STATUS_FINISHED_WITH_MARK)
+		return 1;
+	if (ds->outlen == ds->lzma_size) {
+		if (ds->lzma_known)
+			return 1;
+		puts("Error: uncompressed data too large\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+static void lzma_end(struct decomp_stream *ds)
+{
+	if (ds->lzma_init)
+		LzmaDec_FreeProbs(&ds->lzma, &lzma_allocator);
+}
+#endif /* CONFIG_LZMA */
+
+#ifdef CONFIG_LZ4
+static int lz4_feed(struct decomp_stream *ds, const uchar *src, ulong len)
+{
+	int r;
+
+	r = lz4_stream_feed(&ds->lz4, src, len);
+	ds->outlen = ds->lz4.outlen;
+	if (r < 0)
+		printf("Error: lz4 decode returned %d\n", r);
+
+	return r;
+}
+#endif /* CONFIG_LZ4 */
+
+int decomp_detect(const void *src, ulong len)
+{
+	const uchar *p = src;
+
+	if (len >= 2 && p[0] == 0x1f && p[1] == 0x8b)
+		return IH_COMP_GZIP;
+	if (len >= sizeof(lzop_magic) &&
+	    !memcmp(p, lzop_magic, sizeof(lzop_magic)))
+		return IH_COMP_LZO;
+	if (len >= 4 && (get_unaligned_le32(p) == LZ4_FRAME_MAGIC ||
+			 get_unaligned_le32(p) == LZ4_LEGACY_MAGIC))
+		return IH_COMP_LZ4;
+
+	return IH_COMP_NONE;
+}
+
+struct decomp_stream *decomp_start(int comp, void *dst, ulong dstlen)
+{
+	struct decomp_stream *ds;
+
+	switch (comp) {
+#ifdef CONFIG_GZIP
+	case IH_COMP_GZIP:
+#endif
+#ifdef CONFIG_LZO
+	case IH_COMP_LZO:
+#endif
+#ifdef CONFIG_LZMA
+	case IH_COMP_LZMA:
+#endif
+#ifdef CONFIG_LZ4
+	case IH_COMP_LZ4:
+#endif
+		break;
+	default:
+		printf("Error: %s decompression not supported\n",
+		       genimg_get_comp_name(comp));
+		return NULL;
+	}
+
+	ds = calloc(1, sizeof(*ds));
+	if (!ds)
+		return NULL;
+	ds->stage = malloc(DECOMP_STAGE_SIZE);
+	if (!ds->stage) {
+		free(ds);
+		return NULL;
+	}
+	ds->stagesize = DECOMP_STAGE_SIZE;
+	ds->comp = comp;
+	ds->dst = dst;
+	ds->dstlen = dstlen;
+
+#ifdef CONFIG_GZIP
+	if (comp == IH_COMP_GZIP && gzip_start(ds)) {
+		free(ds->stage);
+		free(ds);
+		return NULL;
+	}
+#endif
+#ifdef CONFIG_LZ4
+	if (comp == IH_COMP_LZ4)
+		lz4_stream_init(&ds->lz4, dst, dstlen);
+#endif
+
+	return ds;
+}
+
+int decomp_feed(struct decomp_stream *ds, const void *src, ulong len)
+{
+	int r = -1;
+
+	if (ds->done)
+		return 1;
+
+	switch (ds->comp) {
+#ifdef CONFIG_GZIP
+	case IH_COMP_GZIP:
+		r = gzip_feed(ds, src, len);
+		break;
+#endif
+#ifdef CONFIG_LZO
+	case IH_COMP_LZO:
+		r = lzo_feed(ds, src, len);
+		break;
+#endif
+#ifdef CONFIG_LZMA
+	case IH_COMP_LZMA:
+		r = lzma_feed(ds, src, len);
+		break;
+#endif
+#ifdef CONFIG_LZ4
+	case IH_COMP_LZ4:
+		r = lz4_feed(ds, src, len);
+		break;
+#endif
+	}
+	WATCHDOG_RESET();
+
+	if (r == 1)
+		ds->done = 1;
+
+	return r;
+}
+
+ulong decomp_outlen(const struct decomp_stream *ds)
+{
+	return ds->outlen;
+}
+
+long decomp_end(struct decomp_stream *ds)
+{
+	long ret = ds->done ? ds->outlen : -1;
+
+#ifdef CONFIG_LZ4
+	/* legacy lz4 streams have no end mark, they stop after a block */
+	if (ds->comp == IH_COMP_LZ4 && lz4_stream_done(&ds->lz4))
+		ret = ds->outlen;
+#endif
+#ifdef CONFIG_GZIP
+	if (ds->comp == IH_COMP_GZIP)
+		gzip_end(ds);
+#endif
+#ifdef CONFIG_LZMA
+	if (ds->comp == IH_COMP_LZMA)
+		lzma_end(ds);
+#endif
+	free(ds->stage);
+	free(ds);
+
+	return ret;
+}
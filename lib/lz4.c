@@ -0,0 +1,494 @@
+/*
+ * LZ4 decompression, frame and legacy formats
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * Block and frame checksums are skipped, images carry their own CRC.
+ * The frame header checksum is checked.
+ */
+
+#include <common.h>
+#include <watchdog.h>
+#include <lz4.h>
+#include <asm/unaligned.h>
+
+#define LZ4_MIN_MATCH		4
+#define LZ4_SHORT_COPY		16
+
+/* Frame states */
+#define LZ4S_MAGIC		0
+#define LZ4S_HEADER		1
+#define LZ4S_BSIZE		2
+#define LZ4S_BLOCK		3
+#define LZ4S_BCHECK		4
+#define LZ4S_CCHECK		5
+#define LZ4S_DONE		6
+
+/* Sequence states */
+#define LZ4Q_TOKEN		0
+#define LZ4Q_LITLEN		1
+#define LZ4Q_LIT		2
+#define LZ4Q_OFF0		3
+#define LZ4Q_OFF1		4
+#define LZ4Q_MLEN		5
+
+/* Frame descriptor FLG bits */
+#define LZ4F_VERSION_MASK	0xc0
+#define LZ4F_VERSION		0x40
+#define LZ4F_RESERVED		0x02
+#define LZ4F_BLOCK_CHECKSUM	0x10
+#define LZ4F_CONTENT_SIZE	0x08
+#define LZ4F_CONTENT_CHECKSUM	0x04
+#define LZ4F_DICT_ID		0x01
+#define LZ4F_BD_RESERVED	0x8f
+
+#define LZ4_BLOCK_RAW		0x80000000
+
+#define PRIME32_1		2654435761U
+#define PRIME32_2		2246822519U
+#define PRIME32_3		3266489917U
+#define PRIME32_4		668265263U
+#define PRIME32_5		374761393U
+
+/*
+ * U-Boot runs with alignment checking enabled, so short runs are copied
+ * a byte at a time and longer ones go through memcpy(), which aligns.
+ */
+static inline void lz4_copy(unsigned char *op, const unsigned char *ip,
+			    size_t len)
+{
+	if (len >= LZ4_SHORT_COPY) {
+		memcpy(op, ip, len);
+		return;
+	}
+	while (len--)
+		*op++ = *ip++;
+}
+
+static inline void lz4_copy_match(unsigned char *op, unsigned int off,
+				  size_t len)
+{
+	const unsigned char *m = op - off;
+
+	if (off >= len) {
+		lz4_copy(op, m, len);
+		return;
+	}
+	/* overlapping, this repeats the last off bytes */
+	while (len--)
+		*op++ = *m++;
+}
+
+int lz4_decompress_block(const unsigned char *src, size_t src_len,
+			 unsigned char *dst, size_t *dst_len,
+			 const unsigned char *base)
+{
+	const unsigned char *ip = src;
+	const unsigned char *iend = src + src_len;
+	unsigned char *op = dst;
+	unsigned char *oend = dst + *dst_len;
+	unsigned int token, off, b;
+	size_t len;
+
+	*dst_len = 0;
+
+	while (ip < iend) {
+		token = *ip++;
+
+		len = token >> 4;
+		if (len == 15) {
+			do {
+				if (ip == iend)
+					return LZ4_E_INPUT_OVERRUN;
+				b = *ip++;
+				len += b;
+			} while (b == 255);
+		}
+		if (len > (size_t)(iend - ip))
+			return LZ4_E_INPUT_OVERRUN;
+		if (len > (size_t)(oend - op))
+			return LZ4_E_OUTPUT_OVERRUN;
+		lz4_copy(op, ip, len);
+		ip += len;
+		op += len;
+
+		/* the last sequence has no match */
+		if (ip == iend)
+			break;
+
+		if (iend - ip < 2)
+			return LZ4_E_INPUT_OVERRUN;
+		off = ip[0] | ip[1] << 8;
+		ip += 2;
+		if (!off || off > (size_t)(op - base))
+			return LZ4_E_LOOKBEHIND_OVERRUN;
+
+		len = token & 15;
+		if (len == 15) {
+			do {
+				if (ip == iend)
+					return LZ4_E_INPUT_OVERRUN;
+				b = *ip++;
+				len += b;
+			} while (b == 255);
+		}
+		len += LZ4_MIN_MATCH;
+		if (len > (size_t)(oend - op))
+			return LZ4_E_OUTPUT_OVERRUN;
+		lz4_copy_match(op, off, len);
+		op += len;
+	}
+
+	*dst_len = op - dst;
+
+	return LZ4_E_OK;
+}
+
+static inline u32 lz4_rotl(u32 x, int r)
+{
+	return (x << r) | (x >> (32 - r));
+}
+
+/* xxHash32 with seed 0 of the few bytes of a frame descriptor */
+static u32 lz4_xxh32(const unsigned char *p, size_t len)
+{
+	u32 h = PRIME32_5 + len;
+
+	for (; len >= 4; p += 4, len -= 4) {
+		h += get_unaligned_le32(p) * PRIME32_3;
+		h = lz4_rotl(h, 17) * PRIME32_4;
+	}
+	for (; len; p++, len--) {
+		h += *p * PRIME32_5;
+		h = lz4_rotl(h, 11) * PRIME32_1;
+	}
+
+	h ^= h >> 15;
+	h *= PRIME32_2;
+	h ^= h >> 13;
+	h *= PRIME32_3;
+	h ^= h >> 16;
+
+	return h;
+}
+
+static void lz4_expect(struct lz4_stream *s, int state, size_t need)
+{
+	s->state = state;
+	s->have = 0;
+	s->need = need;
+}
+
+/* Collect s->need bytes in s->hdr. Returns 1 once they are all there. */
+static int lz4_collect(struct lz4_stream *s, const unsigned char **src,
+		       size_t *len)
+{
+	size_t n = min(s->need - s->have, *len);
+
+	memcpy(s->hdr + s->have, *src, n);
+	s->have += n;
+	*src += n;
+	*len -= n;
+
+	return s->have == s->need;
+}
+
+/*
+ * Check the frame descriptor in s->hdr. Returns 0 if it is complete and
+ * valid, 1 if more bytes are needed (s->need is updated) and < 0 on error.
+ */
+static int lz4_header(struct lz4_stream *s)
+{
+	unsigned int flg = s->hdr[0];
+	unsigned int bd = s->hdr[1];
+	size_t len = 3;
+
+	if (flg & LZ4F_CONTENT_SIZE)
+		len += 8;
+	if (flg & LZ4F_DICT_ID)
+		len += 4;
+	if (s->need < len) {
+		s->need = len;
+		return 1;
+	}
+
+	if ((flg & LZ4F_VERSION_MASK) != LZ4F_VERSION ||
+	    (flg & LZ4F_RESERVED) || (bd & LZ4F_BD_RESERVED))
+		return LZ4_E_ERROR;
+	if (flg & LZ4F_DICT_ID)
+		return LZ4_E_NOT_SUPPORTED;
+	if (((lz4_xxh32(s->hdr, len - 1) >> 8) & 0xff) != s->hdr[len - 1])
+		return LZ4_E_ERROR;
+
+	s->flags = flg;
+	if (flg & LZ4F_CONTENT_SIZE) {
+		s->content_size = get_unaligned_le32(s->hdr + 2) |
+			(unsigned long long)get_unaligned_le32(s->hdr + 6) << 32;
+		if (s->content_size > s->dstlen)
+			return LZ4_E_OUTPUT_OVERRUN;
+	}
+
+	return 0;
+}
+
+static int lz4_end_frame(struct lz4_stream *s)
+{
+	if ((s->flags & LZ4F_CONTENT_SIZE) && s->outlen != s->content_size)
+		return LZ4_E_ERROR;
+
+	s->state = LZ4S_DONE;
+
+	return 0;
+}
+
+/*
+ * Decode the sequences of a block that is split between feeds, keeping
+ * track of where a sequence was interrupted.
+ */
+static int lz4_seq_feed(struct lz4_stream *s, const unsigned char **src,
+			size_t *len)
+{
+	const unsigned char *ip = *src;
+	const unsigned char *iend = ip + min(*len, s->block);
+	unsigned char *op = s->dst + s->outlen;
+	unsigned char *oend = s->dst + s->dstlen;
+	unsigned int b;
+	size_t n;
+	int ret = 0;
+
+	while (ip < iend) {
+		switch (s->seq) {
+		case LZ4Q_TOKEN:
+			s->token = *ip++;
+			s->lit = s->token >> 4;
+			s->seq = s->lit == 15 ? LZ4Q_LITLEN : LZ4Q_LIT;
+			break;
+
+		case LZ4Q_LITLEN:
+			b = *ip++;
+			s->lit += b;
+			if (b != 255)
+				s->seq = LZ4Q_LIT;
+			break;
+
+		case LZ4Q_LIT:
+			n = min(s->lit, (size_t)(iend - ip));
+			if (n > (size_t)(oend - op)) {
+				ret = LZ4_E_OUTPUT_OVERRUN;
+				goto out;
+			}
+			lz4_copy(op, ip, n);
+			op += n;
+			ip += n;
+			s->lit -= n;
+			if (!s->lit)
+				s->seq = LZ4Q_OFF0;
+			break;
+
+		case LZ4Q_OFF0:
+			s->off = *ip++;
+			s->seq = LZ4Q_OFF1;
+			break;
+
+		case LZ4Q_OFF1:
+			s->off |= *ip++ << 8;
+			s->mlen = s->token & 15;
+			if (s->mlen == 15) {
+				s->seq = LZ4Q_MLEN;
+				break;
+			}
+			goto match;
+
+		case LZ4Q_MLEN:
+			b = *ip++;
+			s->mlen += b;
+			if (b == 255)
+				break;
+		match:
+			s->mlen += LZ4_MIN_MATCH;
+			if (!s->off || s->off > (size_t)(op - s->dst)) {
+				ret = LZ4_E_LOOKBEHIND_OVERRUN;
+				goto out;
+			}
+			if (s->mlen > (size_t)(oend - op)) {
+				ret = LZ4_E_OUTPUT_OVERRUN;
+				goto out;
+			}
+			lz4_copy_match(op, s->off, s->mlen);
+			op += s->mlen;
+			s->seq = LZ4Q_TOKEN;
+			break;
+		}
+	}
+
+out:
+	s->block -= ip - *src;
+	*len -= ip - *src;
+	*src = ip;
+	s->outlen = op - s->dst;
+	if (ret || s->block)
+		return ret;
+
+	/* a block ends right after the literals of its last sequence */
+	if (s->seq != LZ4Q_TOKEN && s->seq != LZ4Q_OFF0 &&
+	    !(s->seq == LZ4Q_LIT && !s->lit))
+		return LZ4_E_INPUT_OVERRUN;
+	s->seq = LZ4Q_TOKEN;
+
+	return 0;
+}
+
+void lz4_stream_init(struct lz4_stream *s, unsigned char *dst, size_t dstlen)
+{
+	memset(s, 0, sizeof(*s));
+	s->dst = dst;
+	s->dstlen = dstlen;
+	lz4_expect(s, LZ4S_MAGIC, 4);
+}
+
+int lz4_stream_feed(struct lz4_stream *s, const unsigned char *src,
+		    size_t len)
+{
+	size_t n;
+	u32 v;
+	int ret;
+
+	while (len && s->state != LZ4S_DONE) {
+		switch (s->state) {
+		case LZ4S_MAGIC:
+			if (!lz4_collect(s, &src, &len))
+				return 0;
+			v = get_unaligned_le32(s->hdr);
+			if (v == LZ4_FRAME_MAGIC) {
+				lz4_expect(s, LZ4S_HEADER, 3);
+			} else if (v == LZ4_LEGACY_MAGIC) {
+				s->legacy = 1;
+				lz4_expect(s, LZ4S_BSIZE, 4);
+			} else {
+				return LZ4_E_ERROR;
+			}
+			break;
+
+		case LZ4S_HEADER:
+			if (!lz4_collect(s, &src, &len))
+				return 0;
+			ret = lz4_header(s);
+			if (ret < 0)
+				return ret;
+			if (!ret)
+				lz4_expect(s, LZ4S_BSIZE, 4);
+			break;
+
+		case LZ4S_BSIZE:
+			if (!lz4_collect(s, &src, &len))
+				return 0;
+			v = get_unaligned_le32(s->hdr);
+			if (s->legacy) {
+				/* another legacy stream appended */
+				if (v == LZ4_LEGACY_MAGIC) {
+					lz4_expect(s, LZ4S_BSIZE, 4);
+					break;
+				}
+			} else if (!v) {
+				/* end mark */
+				if (s->flags & LZ4F_CONTENT_CHECKSUM) {
+					lz4_expect(s, LZ4S_CCHECK, 4);
+				} else {
+					ret = lz4_end_frame(s);
+					if (ret)
+						return ret;
+				}
+				break;
+			}
+			s->raw = !s->legacy && (v & LZ4_BLOCK_RAW);
+			s->block = s->legacy ? v : v & ~LZ4_BLOCK_RAW;
+			s->seq = LZ4Q_TOKEN;
+			s->state = LZ4S_BLOCK;
+			break;
+
+		case LZ4S_BLOCK:
+			if (s->raw) {
+				n = min(s->block, len);
+				if (n > s->dstlen - s->outlen)
+					return LZ4_E_OUTPUT_OVERRUN;
+				memcpy(s->dst + s->outlen, src, n);
+				s->outlen += n;
+				s->block -= n;
+				src += n;
+				len -= n;
+			} else if (s->seq == LZ4Q_TOKEN && len >= s->block) {
+				/* the whole block is here */
+				n = s->dstlen - s->outlen;
+				ret = lz4_decompress_block(src, s->block,
+						s->dst + s->outlen, &n, s->dst);
+				if (ret)
+					return ret;
+				s->outlen += n;
+				src += s->block;
+				len -= s->block;
+				s->block = 0;
+			} else {
+				ret = lz4_seq_feed(s, &src, &len);
+				if (ret)
+					return ret;
+			}
+			if (s->block)
+				break;
+
+			WATCHDOG_RESET();
+			if (!s->legacy && (s->flags & LZ4F_BLOCK_CHECKSUM))
+				lz4_expect(s, LZ4S_BCHECK, 4);
+			else
+				lz4_expect(s, LZ4S_BSIZE, 4);
+			break;
+
+		case LZ4S_BCHECK:
+			if (!lz4_collect(s, &src, &len))
+				return 0;
+			lz4_expect(s, LZ4S_BSIZE, 4);
+			break;
+
+		case LZ4S_CCHECK:
+			if (!lz4_collect(s, &src, &len))
+				return 0;
+			ret = lz4_end_frame(s);
+			if (ret)
+				return ret;
+			break;
+		}
+	}
+
+	return s->state == LZ4S_DONE;
+}
+
+int lz4_stream_done(const struct lz4_stream *s)
+{
+	return s->state == LZ4S_DONE ||
+		(s->legacy && s->state == LZ4S_BSIZE && !s->have);
+}
+
+int lz4_decompress(const unsigned char *src, size_t src_len,
+		   unsigned char *dst, size_t *dst_len)
+{
+	struct lz4_stream s;
+	int ret;
+
+	lz4_stream_init(&s, dst, *dst_len);
+	ret = lz4_stream_feed(&s, src, src_len);
+	if (ret < 0)
+		return ret;
+	if (!lz4_stream_done(&s))
+		return LZ4_E_INPUT_OVERRUN;
+
+	*dst_len = s.outlen;
+
+	return LZ4_E_OK;
+}
@@ -26,10 +26,14 @@
 #define ZUTIL_H
 #define ZLIB_INTERNAL
 
+#ifndef USE_HOSTCC
 #include <common.h>
 #include <compiler.h>
 #include <asm/unaligned.h>
 #include <watchdog.h>
+#else
+#include "zlib_test.h"
+#endif
 #include "u-boot/zlib.h"
 #undef	OFF				/* avoid conflicts */
 
@@ -82,7 +86,9 @@ typedef unsigned long ulg;
 
 	 /* functions */
 
+#ifndef USE_HOSTCC
 #include <linux/string.h>
+#endif
 #define zmemcpy memcpy
 #define zmemcmp memcmp
 #define zmemzero(dest, len) memset(dest, 0, len)
@@ -407,6 +413,295 @@ void inflate_fast OF((z_streamp strm, unsigned start));
 #define PUP(a) *++(a)
 #define UP_UNALIGNED(a) get_unaligned(++(a))
 
+#if defined(CONFIG_ZLIB_FAST_INFLATE) && defined(__LITTLE_ENDIAN)
+/*
+   Word oriented variant of inflate_fast(), used while there is plenty of
+   input and output.  U-Boot runs with alignment checking enabled, so all
+   loads and stores are naturally aligned:
+
+   - the bit accumulator is refilled 16 bits at a time with one aligned
+     halfword load instead of two byte loads
+   - matches are copied with aligned word stores, merging misaligned
+     source words from two aligned loads, and short periodic matches
+     (distance 1, 2 or 4) are filled with a replicated word
+
+   An iteration refills at most four times, so it reads at most 8 bytes.
+   The loop goes on only while more than INFLATE_WORD_IN bytes are left,
+   where 8 would be enough; the 4 on top are slack against a miscounted
+   refill, and cost only that the last few bytes of each input buffer go
+   through the byte-wise code.  The byte read to align the input on entry
+   is covered by the INFLATE_WORD_IN + 4 bytes inflate_fast() asks for.
+ */
+#define INFLATE_WORD_IN		12	/* input the loop keeps in reserve */
+#define INFLATE_WORD_OUT	258	/* bytes a loop iteration may write */
+
+typedef unsigned short __attribute__((__may_alias__)) zhalf;
+typedef unsigned int __attribute__((__may_alias__)) zword;
+
+local unsigned char FAR *inflate_copy(unsigned char FAR *out, unsigned dist,
+				      unsigned len)
+{
+    unsigned char FAR *from = out - dist;
+    unsigned char FAR *end = out + len;
+    zword *wout, *wfrom;
+    unsigned int w, next;
+    unsigned sh;
+
+    if (dist < 8 && dist != 1 && dist != 2 && dist != 4)
+        goto bytes;
+
+    /* align the destination */
+    while ((unsigned long)out & 3) {
+        *out++ = *from++;
+        if (out == end)
+            return end;
+    }
+    if (end - out < 4)
+        goto bytes;
+
+    wout = (zword *)out;
+    if (dist >= 8) {
+        /* the source words read are always complete already */
+        sh = ((unsigned long)from & 3) << 3;
+        wfrom = (zword *)((unsigned long)from & ~3UL);
+        if (!sh) {
+            do
+                *wout++ = *wfrom++;
+            while (end - (unsigned char FAR *)wout >= 4);
+        } else {
+            w = *wfrom++;
+            do {
+                next = *wfrom++;
+                *wout++ = (w >> sh) | (next << (32 - sh));
+                w = next;
+            } while (end - (unsigned char FAR *)wout >= 4);
+        }
+    } else {
+        /* the period divides the word size */
+        w = from[0] | from[1 % dist] << 8 | from[2 % dist] << 16 |
+            from[3 % dist] << 24;
+        do
+            *wout++ = w;
+        while (end - (unsigned char FAR *)wout >= 4);
+    }
+    out = (unsigned char FAR *)wout;
+    from = out - dist;
+
+  bytes:
+    while (out < end)
+        *out++ = *from++;
+    return end;
+}
+
+#define REFILL() \
+    do { \
+        if (bits < 16) { \
+            hold += (unsigned long)*(zhalf *)in << bits; \
+            in += 2; \
+            bits += 16; \
+        } \
+    } while (0)
+
+local void inflate_fast_word(z_streamp strm, unsigned start)
+{
+    struct inflate_state FAR *state;
+    unsigned char FAR *in;      /* local strm->next_in */
+    unsigned char FAR *last;    /* while in < last, enough input available */
+    unsigned char FAR *out;     /* local strm->next_out */
+    unsigned char FAR *beg;     /* inflate()'s initial strm->next_out */
+    unsigned char FAR *end;     /* while out < end, enough space available */
+#ifdef INFLATE_STRICT
+    unsigned dmax;              /* maximum distance from zlib header */
+#endif
+    unsigned wsize;             /* window size or zero if not using window */
+    unsigned whave;             /* valid bytes in the window */
+    unsigned write;             /* window write index */
+    unsigned char FAR *window;  /* allocated sliding window, if wsize != 0 */
+    unsigned long hold;         /* local strm->hold */
+    unsigned bits;              /* local strm->bits */
+    code const FAR *lcode;      /* local strm->lencode */
+    code const FAR *dcode;      /* local strm->distcode */
+    unsigned lmask;             /* mask for first level of length codes */
+    unsigned dmask;             /* mask for first level of distance codes */
+    code this;                  /* retrieved table entry */
+    unsigned op;                /* code bits, operation, extra bits, or */
+                                /*  window position, window bytes to copy */
+    unsigned len;               /* match length, unused bytes */
+    unsigned dist;              /* match distance */
+    unsigned char FAR *from;    /* where to copy match from */
+
+    /* copy state to local variables */
+    state = (struct inflate_state FAR *)strm->state;
+    in = strm->next_in;
+    last = in + (strm->avail_in - INFLATE_WORD_IN);
+    out = strm->next_out;
+    beg = out - (start - strm->avail_out);
+    end = out + (strm->avail_out - INFLATE_WORD_OUT);
+#ifdef INFLATE_STRICT
+    dmax = state->dmax;
+#endif
+    wsize = state->wsize;
+    whave = state->whave;
+    write = state->write;
+    window = state->window;
+    hold = state->hold;
+    bits = state->bits;
+    lcode = state->lencode;
+    dcode = state->distcode;
+    lmask = (1U << state->lenbits) - 1;
+    dmask = (1U << state->distbits) - 1;
+
+    /* halfword refills need an even input pointer, bits < 8 on entry */
+    if ((unsigned long)in & 1) {
+        hold += (unsigned long)(*in++) << bits;
+        bits += 8;
+    }
+
+    /*
+     * After a refill there are at least 16 bits, enough for any code
+     * or any extra bits. An iteration refills at most four times.
+     */
+    do {
+        REFILL();
+        this = lcode[hold & lmask];
+      dolen:
+        op = (unsigned)(this.bits);
+        hold >>= op;
+        bits -= op;
+        op = (unsigned)(this.op);
+        if (op == 0) {                          /* literal */
+            *out++ = (unsigned char)(this.val);
+        }
+        else if (op & 16) {                     /* length base */
+            len = (unsigned)(this.val);
+            op &= 15;                           /* number of extra bits */
+            if (op) {
+                REFILL();
+                len += (unsigned)hold & ((1U << op) - 1);
+                hold >>= op;
+                bits -= op;
+            }
+            REFILL();
+            this = dcode[hold & dmask];
+          dodist:
+            op = (unsigned)(this.bits);
+            hold >>= op;
+            bits -= op;
+            op = (unsigned)(this.op);
+            if (op & 16) {                      /* distance base */
+                dist = (unsigned)(this.val);
+                op &= 15;                       /* number of extra bits */
+                REFILL();
+                dist += (unsigned)hold & ((1U << op) - 1);
+#ifdef INFLATE_STRICT
+                if (dist > dmax) {
+                    strm->msg = (char *)"invalid distance too far back";
+                    state->mode = BAD;
+                    break;
+                }
+#endif
+                hold >>= op;
+                bits -= op;
+                op = (unsigned)(out - beg);     /* max distance in output */
+                if (dist > op) {                /* see if copy from window */
+                    op = dist - op;             /* distance back in window */
+                    if (op > whave) {
+                        strm->msg = (char *)"invalid distance too far back";
+                        state->mode = BAD;
+                        break;
+                    }
+                    from = window;
+                    if (write == 0) {           /* very common case */
+                        from += wsize - op;
+                        if (op < len) {         /* some from window */
+                            len -= op;
+                            do {
+                                *out++ = *from++;
+                            } while (--op);
+                            from = out - dist;  /* rest from output */
+                        }
+                    }
+                    else if (write < op) {      /* wrap around window */
+                        from += wsize + write - op;
+                        op -= write;
+                        if (op < len) {         /* some from end of window */
+                            len -= op;
+                            do {
+                                *out++ = *from++;
+                            } while (--op);
+                            from = window;
+                            if (write < len) {  /* some from start of window */
+                                op = write;
+                                len -= op;
+                                do {
+                                    *out++ = *from++;
+                                } while (--op);
+                                from = out - dist;      /* rest from output */
+                            }
+                        }
+                    }
+                    else {                      /* contiguous in window */
+                        from += write - op;
+                        if (op < len) {         /* some from window */
+                            len -= op;
+                            do {
+                                *out++ = *from++;
+                            } while (--op);
+                            from = out - dist;  /* rest from output */
+                        }
+                    }
+                    while (len--)
+                        *out++ = *from++;
+                }
+                else {
+                    out = inflate_copy(out, dist, len);
+                }
+            }
+            else if ((op & 64) == 0) {          /* 2nd level distance code */
+                this = dcode[this.val + (hold & ((1U << op) - 1))];
+                goto dodist;
+            }
+            else {
+                strm->msg = (char *)"invalid distance code";
+                state->mode = BAD;
+                break;
+            }
+        }
+        else if ((op & 64) == 0) {              /* 2nd level length code */
+            this = lcode[this.val + (hold & ((1U << op) - 1))];
+            goto dolen;
+        }
+        else if (op & 32) {                     /* end-of-block */
+            state->mode = TYPE;
+            break;
+        }
+        else {
+            strm->msg = (char *)"invalid literal/length code";
+            state->mode = BAD;
+            break;
+        }
+    } while (in < last && out < end);
+
+    /* return unused bytes */
+    len = bits >> 3;
+    in -= len;
+    bits -= len << 3;
+    hold &= (1U << bits) - 1;
+
+    /* update state and return */
+    strm->next_in = in;
+    strm->next_out = out;
+    strm->avail_in = (unsigned)(in < last ? INFLATE_WORD_IN + (last - in) :
+                                INFLATE_WORD_IN - (in - last));
+    strm->avail_out = (unsigned)(out < end ?
+                                 INFLATE_WORD_OUT + (end - out) :
+                                 INFLATE_WORD_OUT - (out - end));
+    state->hold = hold;
+    state->bits = bits;
+}
+#undef REFILL
+#endif /* CONFIG_ZLIB_FAST_INFLATE && __LITTLE_ENDIAN */
+
 /*
    Decode literal, length, and distance codes and write out the resulting
    literal and match bytes until either not enough input or output is
@@ -472,6 +767,14 @@ unsigned start;         /* inflate()'s starting value for strm->avail_out */
     unsigned dist;              /* match distance */
     unsigned char FAR *from;    /* where to copy match from */
 
+#if defined(CONFIG_ZLIB_FAST_INFLATE) && defined(__LITTLE_ENDIAN)
+    if (strm->avail_in >= INFLATE_WORD_IN + 4 &&
+        strm->avail_out > INFLATE_WORD_OUT) {
+        inflate_fast_word(strm, start);
+        return;
+    }
+#endif
+
     /* copy state to local variables */
     state = (struct inflate_state FAR *)strm->state;
     in = strm->next_in - OFF;
@@ -571,6 +571,8 @@ nfs_read_reply(uchar *pkt, unsigned len)
 		putc('#');
 
 	rlen = ntohl(rpc_pkt.u.reply.data[18]);
+	if (rlen < 0 || sizeof(rpc_pkt.u.reply) + rlen > len)
+		return -9999;
 	if (store_block((uchar *)pkt + sizeof(rpc_pkt.u.reply),
 			nfs_offset, rlen))
 		return -9999;
@@ -121,15 +121,36 @@ static char tftp_filename[MAX_LEN];
  * almost-MTU block sizes.  At least try... fall back to 512 if need be.
  * (but those using CONFIG_IP_DEFRAG may want to set a larger block in cfg file)
  */
+#define TFTP_MTU_MAX_BLOCKSIZE	1468
 #ifdef CONFIG_TFTP_BLOCKSIZE
 #define TFTP_MTU_BLOCKSIZE CONFIG_TFTP_BLOCKSIZE
 #else
-#define TFTP_MTU_BLOCKSIZE 1468
+#define TFTP_MTU_BLOCKSIZE TFTP_MTU_MAX_BLOCKSIZE
 #endif
 
 static unsigned short TftpBlkSize = TFTP_BLOCK_SIZE;
 static unsigned short TftpBlkSizeOption = TFTP_MTU_BLOCKSIZE;
 
+/*
+ * Number of blocks the server sends before waiting for an ACK (RFC 7440).
+ * The blocks of a window are kept track of in a bitmap, hence the limit.
+ */
+#define TFTP_WINDOWSIZE_MAX	32
+#ifdef CONFIG_TFTP_WINDOWSIZE
+#define TFTP_WINDOWSIZE CONFIG_TFTP_WINDOWSIZE
+#else
+#define TFTP_WINDOWSIZE 1
+#endif
+
+static unsigned short TftpWindowSize = 1;
+static unsigned short TftpWindowSizeOption = TFTP_WINDOWSIZE;
+/* bit n set: block TftpLastBlock + 1 + n is stored already */
+static ulong	TftpWindowMap;
+/* last block of the window the server is sending */
+static ushort	TftpNextAck;
+/* number of the short block ending the file once it came in, else -1 */
+static int	TftpWindowFinal;
+
 #ifdef CONFIG_MCAST_TFTP
 #include <malloc.h>
 #define MTFTP_BITMAPSIZE	0x1000
@@ -359,6 +380,9 @@ TftpSend(void)
 		/* try for more effic. blk size */
 		pkt += sprintf((char *)pkt, "blksize%c%d%c",
 				0, TftpBlkSizeOption, 0);
+		if (TftpState == STATE_SEND_RRQ && TftpWindowSizeOption > 1)
+			pkt += sprintf((char *)pkt, "windowsize%c%d%c",
+					0, TftpWindowSizeOption, 0);
 #ifdef CONFIG_MCAST_TFTP
 		/* Check all preconditions before even trying the option */
 		if (!ProhibitMcast) {
@@ -390,6 +414,8 @@ TftpSend(void)
 		s[0] = htons(TFTP_ACK);
 		s[1] = htons(TftpBlock);
 		pkt = (uchar *)(s + 2);
+		/* The server goes on from the block after the one ACKed */
+		TftpNextAck = (ushort)(TftpBlock + TftpWindowSize);
 #ifdef CONFIG_CMD_TFTPPUT
 		if (TftpWriting) {
 			int toload = TftpBlkSize;
@@ -442,6 +468,66 @@ static void icmp_handler(unsigned type, unsigned code, unsigned dest,
 }
 #endif
 
+/*
+ * Receive a data block while the server sends several blocks per ACK.
+ * Blocks are stored where they belong as they come in, so one that is
+ * late or lost within a window only has the blocks after it sent again.
+ * TftpLastBlock is the last block with no gap before it.
+ */
+static void tftp_window_block(unsigned src, uchar *data, unsigned len)
+{
+	ushort block = TftpBlock;
+	ushort diff;
+
+	if (TftpState == STATE_OACK) {
+		/* first block received */
+		TftpState = STATE_DATA;
+		TftpRemotePort = src;
+		new_transfer();
+		TftpWindowMap = 0;
+		TftpWindowFinal = -1;
+	}
+
+	/* Anything not ahead of the gap but within the window is stale */
+	TftpBlock = TftpLastBlock;
+	diff = (ushort)(block - TftpLastBlock);
+	if (diff == 0 || diff > TftpWindowSize)
+		return;
+
+	if (!(TftpWindowMap & (1UL << (diff - 1)))) {
+		store_block(TftpLastBlock + diff - 1, data, len);
+		TftpWindowMap |= 1UL << (diff - 1);
+		if (len < TftpBlkSize)
+			TftpWindowFinal = block;
+	}
+	TftpTimeoutCountMax = TIMEOUT_COUNT;
+	NetSetTimeout(TftpTimeoutMSecs, TftpTimeout);
+
+	while (TftpWindowMap & 1) {
+		/* Timeouts only count while we are stuck */
+		TftpTimeoutCount = 0;
+		TftpWindowMap >>= 1;
+		TftpBlock = (ushort)(TftpLastBlock + 1);
+		TftpLastBlock = TftpBlock;
+		update_block_number();
+	}
+
+	if (TftpWindowFinal == (int)TftpLastBlock) {
+		TftpSend();
+		tftp_complete();
+		return;
+	}
+
+	/*
+	 * ACK once the server is through with its window. If there is a
+	 * gap, the ACK makes it start over from there.
+	 */
+	if ((ushort)(block - TftpNextAck) < 0x8000 ||
+	    (ushort)(TftpLastBlock - TftpNextAck) < 0x8000 ||
+	    TftpWindowFinal == block)
+		TftpSend();
+}
+
 static void
 TftpHandler(uchar *pkt, unsigned dest, IPaddr_t sip, unsigned src,
 	    unsigned len)
@@ -536,9 +622,21 @@ TftpHandler(uchar *pkt, unsigned dest, IPaddr_t sip, unsigned src,
 					 (char *)pkt+i+6, TftpTsize);
 			}
 #endif
+			if (strcmp((char *)pkt+i, "windowsize") == 0) {
+				ulong ws = simple_strtoul((char *)pkt+i+11,
+							  NULL, 10);
+
+				/* The server may only lower what we asked for */
+				if (ws >= 1 && ws <= TftpWindowSizeOption)
+					TftpWindowSize = ws;
+				debug("Windowsize ack: %s, %d\n",
+				      (char *)pkt+i+11, TftpWindowSize);
+			}
 		}
 #ifdef CONFIG_MCAST_TFTP
 		parse_multicast_oack((char *)pkt, len-1);
+		if (Multicast)
+			TftpWindowSize = 1;
 		if ((Multicast) && (!MasterClient))
 			TftpState = STATE_DATA;	/* passive.. */
 		else
@@ -558,6 +656,11 @@ TftpHandler(uchar *pkt, unsigned dest, IPaddr_t sip, unsigned src,
 		len -= 2;
 		TftpBlock = ntohs(*(__be16 *)pkt);
 
+		if (TftpWindowSize > 1) {
+			tftp_window_block(src, pkt + 2, len);
+			break;
+		}
+
 		update_block_number();
 
 		if (TftpState == STATE_SEND_RRQ)
@@ -697,6 +800,26 @@ void TftpStart(enum proto_t protocol)
 	if (ep != NULL)
 		TftpBlkSizeOption = simple_strtol(ep, NULL, 10);
 
+#ifndef CONFIG_IP_DEFRAG
+	/* Without reassembly every block has to fit into one frame */
+	if (TftpBlkSizeOption > TFTP_MTU_MAX_BLOCKSIZE) {
+		printf("TFTP blocksize %d needs CONFIG_IP_DEFRAG, using %d\n",
+		       TftpBlkSizeOption, TFTP_MTU_MAX_BLOCKSIZE);
+		TftpBlkSizeOption = TFTP_MTU_MAX_BLOCKSIZE;
+	}
+#endif
+
+	/* re-read each time, so unsetting it restores the default */
+	ep = getenv("tftpwindowsize");
+	if (ep != NULL)
+		TftpWindowSizeOption = simple_strtol(ep, NULL, 10);
+	else
+		TftpWindowSizeOption = TFTP_WINDOWSIZE;
+	if (TftpWindowSizeOption < 1)
+		TftpWindowSizeOption = 1;
+	if (TftpWindowSizeOption > TFTP_WINDOWSIZE_MAX)
+		TftpWindowSizeOption = TFTP_WINDOWSIZE_MAX;
+
 	ep = getenv("tftptimeout");
 	if (ep != NULL)
 		TftpTimeoutMSecs = simple_strtol(ep, NULL, 10);
@@ -708,8 +831,8 @@ void TftpStart(enum proto_t protocol)
 		TftpTimeoutMSecs = 1000;
 	}
 
-	debug("TFTP blocksize = %i, timeout = %ld ms\n",
-		TftpBlkSizeOption, TftpTimeoutMSecs);
+	debug("TFTP blocksize = %i, windowsize = %i, timeout = %ld ms\n",
+		TftpBlkSizeOption, TftpWindowSizeOption, TftpTimeoutMSecs);
 
 	TftpRemoteIP = NetServerIP;
 	if (BootFile[0] == '\0') {
@@ -807,8 +930,9 @@ void TftpStart(enum proto_t protocol)
 
 	/* zero out server ether in case the server ip has changed */
 	memset(NetServerEther, 0, 6);
-	/* Revert TftpBlkSize to dflt */
+	/* Revert TftpBlkSize and TftpWindowSize to dflt */
 	TftpBlkSize = TFTP_BLOCK_SIZE;
+	TftpWindowSize = 1;
 #ifdef CONFIG_MCAST_TFTP
 	mcast_cleanup();
 #endif
@@ -837,8 +961,9 @@ TftpStartServer(void)
 	TftpTimeoutMSecs = TIMEOUT;
 	NetSetTimeout(TftpTimeoutMSecs, TftpTimeout);
 
-	/* Revert TftpBlkSize to dflt */
+	/* Revert TftpBlkSize and TftpWindowSize to dflt */
 	TftpBlkSize = TFTP_BLOCK_SIZE;
+	TftpWindowSize = 1;
 	TftpBlock = 0;
 	TftpOurPort = WELL_KNOWN_PORT;
 
@@ -0,0 +1,35 @@
+/*
+ * Slice-by-8 build of lib/crc32.c for crc32_test
+ *
+ * See file CREDITS for list of people who contributed to this
+ * project.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ */
+
+/*
+ * The tools link lib/crc32.o as the plain word loop. Build the same
+ * source a second time with CONFIG_CRC32_SLICE8 under other names so
+ * crc32_test can run both in one program.
+ */
+
+#define CONFIG_CRC32_SLICE8
+#define crc32		crc32_slice8
+#define crc32_no_comp	crc32_no_comp_slice8
+#define crc32_wd	crc32_wd_slice8
+#define crc32_combine	crc32_combine_slice8
+
+#include "../lib/crc32.c"
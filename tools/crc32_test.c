@@ -0,0 +1,166 @@
+/*
+ * Check and benchmark of the slice-by-8 crc32
+ *
+ * See file CREDITS for list of people who contributed to this
+ * project.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ */
+
+/*
+ * Runs lib/crc32.c built with CONFIG_CRC32_SLICE8 (crc32_slice8.c)
+ * against the same file built without it (lib/crc32.o):
+ *
+ *  - the zlib check values,
+ *  - every start offset 0-7 and length 0-299 of a random buffer, for
+ *    crc32() and crc32_no_comp(), so each alignment and tail of the
+ *    8 byte loop is covered,
+ *  - crc32_combine() at every split of those buffers,
+ *
+ * and then times both over a large buffer and prints the speedup.
+ * Exits nonzero on the first mismatch.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <compiler.h>
+#include <u-boot/crc.h>
+
+#define MAX_OFFSET	8
+#define MAX_LEN		300
+#define BENCH_SIZE	(4 << 20)
+#define BENCH_LOOPS	64
+
+uint32_t crc32_slice8(uint32_t, const unsigned char *, uint);
+uint32_t crc32_no_comp_slice8(uint32_t, const unsigned char *, uint);
+uint32_t crc32_combine_slice8(uint32_t, uint32_t, uint);
+
+static const struct {
+	const char *s;
+	uint32_t crc;
+} vectors[] = {
+	{ "",						0x00000000 },
+	{ "a",						0xe8b7be43 },
+	{ "abc",					0x352441c2 },
+	{ "message digest",				0x20159d7f },
+	{ "123456789",					0xcbf43926 },
+	{ "abcdefghijklmnopqrstuvwxyz",			0x4c2750bd },
+	{ "The quick brown fox jumps over the lazy dog",	0x414fa339 },
+};
+
+static double now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static double bench(uint32_t (*fn)(uint32_t, const unsigned char *, uint),
+		    const unsigned char *buf, uint32_t *crc)
+{
+	double t;
+	int i;
+
+	*crc = 0;
+	t = now();
+	for (i = 0; i < BENCH_LOOPS; i++)
+		*crc = fn(*crc, buf, BENCH_SIZE);
+	t = now() - t;
+
+	return (double)BENCH_SIZE * BENCH_LOOPS / (1 << 20) / t;
+}
+
+int main(void)
+{
+	unsigned char *buf;
+	unsigned int i, off, len, split;
+	uint32_t ref, crc, a, b;
+	double mb_ref, mb_s8;
+
+	buf = malloc(BENCH_SIZE);
+	if (!buf) {
+		perror("malloc");
+		return 1;
+	}
+	srand(1);
+	for (i = 0; i < BENCH_SIZE; i++)
+		buf[i] = rand();
+
+	for (i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++) {
+		const unsigned char *s = (const unsigned char *)vectors[i].s;
+
+		len = strlen(vectors[i].s);
+		if (crc32(0, s, len) != vectors[i].crc ||
+		    crc32_slice8(0, s, len) != vectors[i].crc) {
+			fprintf(stderr, "check value of \"%s\" is wrong\n",
+				vectors[i].s);
+			return 1;
+		}
+	}
+
+	for (off = 0; off < MAX_OFFSET; off++) {
+		for (len = 0; len < MAX_LEN; len++) {
+			ref = crc32(0, buf + off, len);
+			crc = crc32_slice8(0, buf + off, len);
+			if (crc != ref) {
+				fprintf(stderr, "crc32 offset %u length %u: "
+					"%08x, expected %08x\n",
+					off, len, crc, ref);
+				return 1;
+			}
+			ref = crc32_no_comp(0x12345678, buf + off, len);
+			crc = crc32_no_comp_slice8(0x12345678, buf + off, len);
+			if (crc != ref) {
+				fprintf(stderr, "crc32_no_comp offset %u "
+					"length %u: %08x, expected %08x\n",
+					off, len, crc, ref);
+				return 1;
+			}
+			ref = crc32(0, buf + off, len);
+			for (split = 0; split <= len; split++) {
+				a = crc32_slice8(0, buf + off, split);
+				b = crc32_slice8(0, buf + off + split,
+						 len - split);
+				crc = crc32_combine_slice8(a, b, len - split);
+				if (crc != ref) {
+					fprintf(stderr, "crc32_combine offset "
+						"%u length %u split %u: %08x, "
+						"expected %08x\n",
+						off, len, split, crc, ref);
+					return 1;
+				}
+			}
+		}
+	}
+	printf("offsets 0-%d, lengths 0-%d, all splits: ok\n",
+	       MAX_OFFSET - 1, MAX_LEN - 1);
+
+	mb_ref = bench(crc32, buf, &ref);
+	mb_s8 = bench(crc32_slice8, buf, &crc);
+	if (crc != ref) {
+		fprintf(stderr, "benchmark results differ\n");
+		return 1;
+	}
+	printf("word loop:    %8.1f MB/s\n", mb_ref);
+	printf("slice-by-8:   %8.1f MB/s\n", mb_s8);
+	printf("speedup:      %8.2fx\n", mb_s8 / mb_ref);
+
+	free(buf);
+	return 0;
+}
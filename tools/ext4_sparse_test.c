@@ -0,0 +1,248 @@
+/*
+ * Round-trip test of the streaming sparse image writer
+ *
+ * See file CREDITS for list of people who contributed to this
+ * project.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ */
+
+/*
+ * Writes an Android sparse image through common/decompress_ext4.c to a
+ * file-backed block device and compares the result with the raw image
+ * it was made from:
+ *
+ *	img2simg system.img system.simg
+ *	ext4_sparse_test system.simg system.img
+ *
+ * The image goes through write_compressed_ext4() once and then through
+ * ext4_sparse_write() in pieces of several sizes, once with synchronous
+ * writes and once with queued ones. A queued write only lands when it
+ * is reaped, so data reused before that shows up as a mismatch. The
+ * device starts out zeroed, like the partition fastboot erases first.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "ext4_sparse_test.h"
+
+#define SECTOR_SIZE	512
+
+static int dev_fd;
+static block_dev_desc_t dev;
+
+static struct {
+	int busy;
+	lbaint_t start;
+	lbaint_t blkcnt;
+	const void *buffer;
+} queued;
+
+void *memalign(size_t align, size_t size)
+{
+	void *p;
+
+	return posix_memalign(&p, align, size) ? NULL : p;
+}
+
+block_dev_desc_t *mmc_get_dev(int devnum)
+{
+	return &dev;
+}
+
+static unsigned long dev_write(int devnum, lbaint_t start, lbaint_t blkcnt,
+			       const void *buffer)
+{
+	size_t len = blkcnt * SECTOR_SIZE;
+
+	if (pwrite(dev_fd, buffer, len, start * SECTOR_SIZE) != len)
+		return 0;
+
+	return blkcnt;
+}
+
+static int dev_write_start(int devnum, lbaint_t start, lbaint_t blkcnt,
+			   const void *buffer)
+{
+	if (queued.busy) {
+		fprintf(stderr, "write queued while another one is pending\n");
+		return -1;
+	}
+
+	queued.busy = 1;
+	queued.start = start;
+	queued.blkcnt = blkcnt;
+	queued.buffer = buffer;
+
+	return 0;
+}
+
+static int dev_xfer_done(int devnum, int wait)
+{
+	if (!queued.busy)
+		return 0;
+
+	queued.busy = 0;
+	if (dev_write(devnum, queued.start, queued.blkcnt,
+		      queued.buffer) != queued.blkcnt)
+		return -1;
+
+	return 0;
+}
+
+static void *read_file(const char *name, size_t *size)
+{
+	struct stat st;
+	void *buf;
+	int fd;
+
+	fd = open(name, O_RDONLY);
+	if (fd < 0 || fstat(fd, &st)) {
+		fprintf(stderr, "%s: %s\n", name, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	buf = malloc(st.st_size + 1);
+	if (!buf || read(fd, buf, st.st_size) != st.st_size) {
+		fprintf(stderr, "%s: cannot read\n", name);
+		exit(EXIT_FAILURE);
+	}
+	close(fd);
+
+	*size = st.st_size;
+	return buf;
+}
+
+/* Zero the device, as erasing the partition does */
+static void dev_clear(size_t size)
+{
+	if (ftruncate(dev_fd, 0) || ftruncate(dev_fd, size)) {
+		perror("ftruncate");
+		exit(EXIT_FAILURE);
+	}
+}
+
+static int dev_check(const char *what, const unsigned char *raw,
+		     size_t size)
+{
+	unsigned char buf[4096];
+	size_t off, n;
+
+	for (off = 0; off < size; off += n) {
+		n = size - off < sizeof(buf) ? size - off : sizeof(buf);
+		if (pread(dev_fd, buf, n, off) != n || memcmp(buf, raw + off, n)) {
+			printf("%-40s FAILED near byte %lu\n", what,
+			       (unsigned long)off);
+			return 1;
+		}
+	}
+
+	printf("%-40s ok\n", what);
+	return 0;
+}
+
+/* Feed the image in pieces of 'step' bytes, out of a reused buffer */
+static int stream(const unsigned char *img, size_t size, size_t step,
+		  lbaint_t sectors)
+{
+	struct ext4_sparse_ctx ctx;
+	unsigned char *piece;
+	size_t off, n;
+	int ret = 0;
+
+	piece = malloc(step);
+	if (!piece || ext4_sparse_init(&ctx, &dev, 0, sectors))
+		return -1;
+
+	for (off = 0; off < size && !ret; off += n) {
+		n = size - off < step ? size - off : step;
+		memcpy(piece, img + off, n);
+		ret = ext4_sparse_write(&ctx, piece, n);
+		/* the writer must be done with the piece by now */
+		memset(piece, 0x5a, n);
+	}
+
+	if (ext4_sparse_finish(&ctx))
+		ret = -1;
+	free(piece);
+
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	static const size_t steps[] = {
+		1, 511, 4096 + 12, 64 << 10, 1 << 20, 0,
+	};
+	unsigned char *img, *raw, *copy;
+	size_t img_size, raw_size, step;
+	char what[64];
+	lbaint_t sectors;
+	FILE *f;
+	int i, queue, fails = 0;
+
+	if (argc != 3) {
+		fprintf(stderr, "usage: %s <sparse image> <raw image>\n",
+			argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	img = read_file(argv[1], &img_size);
+	raw = read_file(argv[2], &raw_size);
+	sectors = (raw_size + SECTOR_SIZE - 1) / SECTOR_SIZE;
+
+	f = tmpfile();
+	if (!f) {
+		perror("tmpfile");
+		return EXIT_FAILURE;
+	}
+	dev_fd = fileno(f);
+	dev.block_write = dev_write;
+
+	/* the whole image in memory, as 'fastboot flash' has it */
+	dev_clear(raw_size);
+	copy = malloc(img_size);
+	memcpy(copy, img, img_size);
+	if (write_compressed_ext4((char *)copy, 0))
+		printf("%-40s FAILED\n", "write_compressed_ext4"), fails++;
+	else
+		fails += dev_check("write_compressed_ext4", raw, raw_size);
+	free(copy);
+
+	for (queue = 0; queue < 2; queue++) {
+		dev.block_write_start = queue ? dev_write_start : NULL;
+		dev.block_xfer_done = queue ? dev_xfer_done : NULL;
+
+		for (i = 0; i < sizeof(steps) / sizeof(steps[0]); i++) {
+			step = steps[i] ? steps[i] : img_size;
+			snprintf(what, sizeof(what), "stream %lu byte pieces%s",
+				 (unsigned long)step, queue ? ", queued" : "");
+
+			dev_clear(raw_size);
+			if (stream(img, img_size, step, sectors)) {
+				printf("%-40s FAILED\n", what);
+				fails++;
+				continue;
+			}
+			fails += dev_check(what, raw, raw_size);
+		}
+	}
+
+	fclose(f);
+	return fails ? EXIT_FAILURE : EXIT_SUCCESS;
+}
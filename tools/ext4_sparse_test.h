@@ -0,0 +1,55 @@
+/*
+ * Host build of the streaming sparse image writer
+ *
+ * See file CREDITS for list of people who contributed to this
+ * project.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ */
+
+/*
+ * Host side of common/decompress_ext4.c for ext4_sparse_test: the bits
+ * of the block device interface the sparse image writer uses.
+ */
+#ifndef _EXT4_SPARSE_TEST_H_
+#define _EXT4_SPARSE_TEST_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+typedef unsigned long ulong;
+typedef uint32_t u32;
+typedef ulong lbaint_t;
+
+typedef struct block_dev_desc {
+	int dev;
+	unsigned long (*block_write)(int dev, lbaint_t start, lbaint_t blkcnt,
+				     const void *buffer);
+	int (*block_write_start)(int dev, lbaint_t start, lbaint_t blkcnt,
+				 const void *buffer);
+	int (*block_xfer_done)(int dev, int wait);
+} block_dev_desc_t;
+
+#define ARCH_DMA_MINALIGN	64
+
+void *memalign(size_t align, size_t size);
+block_dev_desc_t *mmc_get_dev(int dev);
+
+#include <decompress_ext4.h>
+
+#endif /* _EXT4_SPARSE_TEST_H_ */
@@ -0,0 +1,225 @@
+/*
+ * Test of the secondary core job dispatcher on host threads
+ *
+ * See file CREDITS for list of people who contributed to this
+ * project.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ */
+
+/*
+ * Runs common/smp.c with one thread per secondary core. The threads
+ * start in smp_secondary_loop() like the cores do and the event and
+ * barrier hooks map onto sched_yield() and full memory barriers, so the
+ * mailbox handshake and the queue run exactly as on the board:
+ *
+ *  - rounds of jobs are started and waited for in varying order, and
+ *    every result is checked against the same sum done directly,
+ *  - every third job of a round is cancelled, whether it is still
+ *    queued or already running,
+ *  - after smp_shutdown() the threads have parked and jobs run on the
+ *    boot core from smp_job_wait().
+ *
+ * Exits nonzero on the first failure.
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include "smp_test.h"
+#include <smp.h>
+
+#define NR_JOBS		24
+#define NR_ROUNDS	500
+#define DATA_WORDS	(64 << 10)
+
+struct sum_arg {
+	const u32 *data;
+	int words;
+	u32 sum;
+};
+
+static u32 data[DATA_WORDS];
+
+ulong get_timer(ulong base)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000 + ts.tv_nsec / 1000000 - base;
+}
+
+static void *secondary(void *arg)
+{
+	smp_secondary_loop((int)(long)arg);
+	return NULL;
+}
+
+/* the thread brings its own stack, the one passed in is not used */
+int smp_arch_start(int cpu, ulong sp)
+{
+	pthread_t thread;
+
+	if (pthread_create(&thread, NULL, secondary, (void *)(long)cpu))
+		return -1;
+	pthread_detach(thread);
+	return 0;
+}
+
+void smp_arch_park(int cpu)
+{
+	pthread_exit(NULL);
+}
+
+void smp_arch_barrier(void)
+{
+	__sync_synchronize();
+}
+
+void smp_arch_wait_event(void)
+{
+	sched_yield();
+}
+
+void smp_arch_send_event(void)
+{
+}
+
+static int sum_job(void *p)
+{
+	struct sum_arg *arg = p;
+	u32 sum = 0;
+	int i;
+
+	for (i = 0; i < arg->words; i++)
+		sum = (sum << 1 | sum >> 31) ^ arg->data[i];
+	arg->sum = sum;
+	return arg->words;
+}
+
+static void setup(struct smp_job *job, struct sum_arg *arg, int n)
+{
+	arg->data = data + n * 97;
+	arg->words = (n * 2731) % (DATA_WORDS - n * 97);
+	arg->sum = 0;
+	memset(job, 0, sizeof(*job));
+	job->func = sum_job;
+	job->arg = arg;
+}
+
+static int check(struct smp_job *job, struct sum_arg *arg, int ret)
+{
+	struct sum_arg ref = *arg;
+
+	sum_job(&ref);
+	return ret == arg->words && job->state == SMP_JOB_DONE &&
+	       arg->sum == ref.sum;
+}
+
+/* Start NR_JOBS jobs, cancel every third and wait for the rest */
+static int run_round(int round, int *ran)
+{
+	struct smp_job jobs[NR_JOBS];
+	struct sum_arg args[NR_JOBS];
+	int i, n, ret;
+
+	for (i = 0; i < NR_JOBS; i++) {
+		setup(&jobs[i], &args[i], (round + i) % 200);
+		smp_job_start(&jobs[i]);
+	}
+
+	for (i = 0; i < NR_JOBS; i++) {
+		/* odd rounds wait back to front */
+		n = round & 1 ? NR_JOBS - 1 - i : i;
+
+		if (n % 3 == 0) {
+			smp_job_cancel(&jobs[n]);
+			if (jobs[n].state != SMP_JOB_IDLE &&
+			    jobs[n].state != SMP_JOB_DONE) {
+				fprintf(stderr, "round %d job %d: state %d "
+					"after cancel\n", round, n,
+					jobs[n].state);
+				return -1;
+			}
+			if (jobs[n].state == SMP_JOB_IDLE &&
+			    smp_job_wait(&jobs[n]) != -1) {
+				fprintf(stderr, "round %d job %d: cancelled "
+					"job ran\n", round, n);
+				return -1;
+			}
+			if (jobs[n].state == SMP_JOB_DONE)
+				ran[jobs[n].cpu]++;
+			continue;
+		}
+
+		ret = smp_job_wait(&jobs[n]);
+		if (!check(&jobs[n], &args[n], ret)) {
+			fprintf(stderr, "round %d job %d: wrong result\n",
+				round, n);
+			return -1;
+		}
+		ran[jobs[n].cpu]++;
+	}
+	return 0;
+}
+
+int main(void)
+{
+	int ran[CONFIG_SMP_NR_CPUS];
+	int round, cpu, online;
+
+	for (round = 0; round < DATA_WORDS; round++)
+		data[round] = round * 2654435761u;
+	memset(ran, 0, sizeof(ran));
+
+	for (round = 0; round < NR_ROUNDS; round++)
+		if (run_round(round, ran))
+			return 1;
+
+	online = smp_cpus_online();
+	printf("%d cores online, jobs run per core:", online);
+	for (cpu = 0; cpu < CONFIG_SMP_NR_CPUS; cpu++)
+		printf(" %d", ran[cpu]);
+	printf("\n");
+	if (online != CONFIG_SMP_NR_CPUS) {
+		fprintf(stderr, "only %d of %d cores came up\n", online,
+			CONFIG_SMP_NR_CPUS);
+		return 1;
+	}
+
+	smp_shutdown();
+	if (smp_cpus_online() != 1) {
+		fprintf(stderr, "%d cores online after shutdown\n",
+			smp_cpus_online());
+		return 1;
+	}
+
+	memset(ran, 0, sizeof(ran));
+	for (round = 0; round < 10; round++)
+		if (run_round(round, ran))
+			return 1;
+	for (cpu = 1; cpu < CONFIG_SMP_NR_CPUS; cpu++) {
+		if (ran[cpu]) {
+			fprintf(stderr, "cpu%d ran jobs after shutdown\n",
+				cpu);
+			return 1;
+		}
+	}
+
+	printf("%d rounds of %d jobs with cancels, shutdown: ok\n",
+	       NR_ROUNDS, NR_JOBS);
+	return 0;
+}
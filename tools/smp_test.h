@@ -0,0 +1,49 @@
+/*
+ * Host stand-in for the secondary core job dispatcher
+ *
+ * See file CREDITS for list of people who contributed to this
+ * project.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ */
+
+/*
+ * Host side of common/smp.c for smp_test: the secondary cores are
+ * threads, see smp_test.c for the smp_arch_*() hooks.
+ */
+#ifndef _SMP_TEST_H_
+#define _SMP_TEST_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+typedef unsigned long ulong;
+typedef uint32_t u32;
+
+/* the dispatcher insists on this, a host has coherent caches anyway */
+#define CONFIG_SYS_NO_DCACHE
+
+#ifdef DEBUG
+#define debug(...)	printf(__VA_ARGS__)
+#else
+#define debug(...)	do { } while (0)
+#endif
+
+ulong get_timer(ulong base);
+
+#endif /* _SMP_TEST_H_ */
@@ -0,0 +1,108 @@
+/*
+ * Word oriented inflate build of lib/zlib.c for zlib_test
+ *
+ * See file CREDITS for list of people who contributed to this
+ * project.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ */
+
+/*
+ * Builds lib/zlib.c with CONFIG_ZLIB_FAST_INFLATE for the host, with
+ * every symbol under a z_ prefix so it links next to the system zlib
+ * that zlib_test checks it against. zlib_test only calls the
+ * zlib_fast_*() functions below and never sees the U-Boot z_stream.
+ *
+ * lib/zlib.c ignores the option on big endian targets; a big endian
+ * host gets the same byte-wise inflate.
+ */
+
+#define CONFIG_ZLIB_FAST_INFLATE
+#define Z_PREFIX
+#define inflate_fast	z_inflate_fast
+#define inflate_table	z_inflate_table
+#define zcalloc		z_zcalloc
+#define zcfree		z_zcfree
+#define z_errmsg	z_z_errmsg
+
+#include "../lib/zlib.c"
+
+/* The gzip wrapper checksum, lib/crc32.c is the same as the system's */
+#undef crc32
+extern unsigned long crc32(unsigned long crc, const unsigned char *buf,
+			   unsigned int len);
+
+uInt z_crc32(uInt crc, const Bytef *buf, uInt len)
+{
+	return crc32(crc, buf, len);
+}
+
+void *zlib_fast_init(void);
+int zlib_fast_step(void *strm, const unsigned char *src,
+		   unsigned long *srclen, unsigned char *dst,
+		   unsigned long *dstlen);
+unsigned long zlib_fast_end(void *strm);
+
+/* Start inflating a raw deflate stream */
+void *zlib_fast_init(void)
+{
+	z_stream *s;
+
+	s = calloc(1, sizeof(*s));
+	if (!s)
+		return NULL;
+	if (inflateInit2(s, -MAX_WBITS) != Z_OK) {
+		free(s);
+		return NULL;
+	}
+	return s;
+}
+
+/*
+ * Run inflate() once on the given input and output space. Returns 1 at
+ * the end of the stream, 0 if it needs more input or output and -1 on
+ * an error; *srclen and *dstlen are set to the space left over.
+ */
+int zlib_fast_step(void *strm, const unsigned char *src,
+		   unsigned long *srclen, unsigned char *dst,
+		   unsigned long *dstlen)
+{
+	z_stream *s = strm;
+	int r;
+
+	s->next_in = (Bytef *)src;
+	s->avail_in = *srclen;
+	s->next_out = dst;
+	s->avail_out = *dstlen;
+	r = inflate(s, Z_NO_FLUSH);
+	*srclen = s->avail_in;
+	*dstlen = s->avail_out;
+
+	if (r == Z_STREAM_END)
+		return 1;
+	return r == Z_OK ? 0 : -1;
+}
+
+/* Finish and return the size of the output */
+unsigned long zlib_fast_end(void *strm)
+{
+	z_stream *s = strm;
+	unsigned long n = s->total_out;
+
+	inflateEnd(s);
+	free(s);
+	return n;
+}
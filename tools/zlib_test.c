@@ -0,0 +1,473 @@
+/*
+ * Check of the word oriented inflate against the system zlib
+ *
+ * See file CREDITS for list of people who contributed to this
+ * project.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ */
+
+/*
+ * Compresses a corpus with the system zlib and inflates it again with
+ * lib/zlib.c built with CONFIG_ZLIB_FAST_INFLATE (zlib_fast.c):
+ *
+ *	zlib_test [file ...]
+ *
+ * The corpus is generated text, binary records, random data, zeros,
+ * short periodic patterns for the replicated word copies, every length
+ * up to 64 bytes, and any files given. Each one is compressed at levels
+ * 1, 6 and 9 with the default strategy and with the filtered, Huffman
+ * only, RLE and fixed code ones, then inflated
+ *
+ *  - with the input in one piece, in 4097 byte pieces and in 7 byte
+ *    pieces, and the output space in one piece, in 4099 byte pieces and
+ *    in 1000 byte pieces,
+ *  - with each piece of input and of output space ending right at an
+ *    inaccessible page, or 1, 2 or 3 bytes before it, so every
+ *    alignment is covered and reading or writing a byte past the
+ *    buffers inflate() was given faults,
+ *
+ * and compared with the original. The system zlib inflates every
+ * stream as well, and both are timed on the largest one. Exits nonzero
+ * on the first mismatch.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <zlib.h>
+
+#define CORPUS_MAX	32
+#define BENCH_LOOPS	20
+
+void *zlib_fast_init(void);
+int zlib_fast_step(void *strm, const unsigned char *src,
+		   unsigned long *srclen, unsigned char *dst,
+		   unsigned long *dstlen);
+unsigned long zlib_fast_end(void *strm);
+
+struct sample {
+	const char *name;
+	unsigned char *data;
+	unsigned long len;
+};
+
+static struct sample corpus[CORPUS_MAX];
+static int corpus_len;
+
+static const int levels[] = { 1, 6, 9 };
+static const struct {
+	int strategy;
+	const char *name;
+} strategies[] = {
+	{ Z_DEFAULT_STRATEGY,	"default" },
+	{ Z_FILTERED,		"filtered" },
+	{ Z_HUFFMAN_ONLY,	"huffman" },
+	{ Z_RLE,		"rle" },
+	{ Z_FIXED,		"fixed" },
+};
+static const unsigned long ipieces[] = { ~0UL, 4097, 7 };
+static const unsigned long opieces[] = { ~0UL, 4099, 1000 };
+
+#define ARRAY_SIZE(x)	(sizeof(x) / sizeof((x)[0]))
+
+static long page_size;
+
+/*
+ * A buffer of at least 'size' bytes followed by an inaccessible page.
+ * guard_end() places data so that it ends 'pad' bytes before that page.
+ */
+struct guarded {
+	unsigned char *base;
+	unsigned char *guard;
+};
+
+static void guard_alloc(struct guarded *g, unsigned long size)
+{
+	unsigned long len = (size + 2 * page_size - 1) & ~(page_size - 1);
+
+	g->base = mmap(NULL, len, PROT_READ | PROT_WRITE,
+		       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (g->base == MAP_FAILED) {
+		perror("mmap");
+		exit(1);
+	}
+	g->guard = g->base + len - page_size;
+	if (mprotect(g->guard, page_size, PROT_NONE)) {
+		perror("mprotect");
+		exit(1);
+	}
+}
+
+static unsigned char *guard_end(struct guarded *g, unsigned long len,
+				unsigned pad)
+{
+	return g->guard - pad - len;
+}
+
+static unsigned char *xmalloc(unsigned long len)
+{
+	unsigned char *p = malloc(len ? len : 1);
+
+	if (!p) {
+		perror("malloc");
+		exit(1);
+	}
+	return p;
+}
+
+static struct sample *add_sample(const char *name, unsigned long len)
+{
+	struct sample *s;
+
+	if (corpus_len == CORPUS_MAX) {
+		fprintf(stderr, "too many samples\n");
+		exit(1);
+	}
+	s = &corpus[corpus_len++];
+	s->name = name;
+	s->len = len;
+	s->data = xmalloc(len);
+	return s;
+}
+
+static void gen_corpus(void)
+{
+	static const char *words[] = {
+		"the", "of", "and", "to", "in", "is", "block", "device",
+		"partition", "kernel", "image", "U-Boot", "loadaddr",
+		"bootm", "0x40008000", "mmc", "ext4", "\n", "\t", "=",
+	};
+	static const unsigned periods[] = { 1, 2, 3, 4, 5, 7, 8, 13 };
+	static char names[8][16];
+	struct sample *s;
+	unsigned long i, n;
+	unsigned k;
+
+	srand(1);
+
+	s = add_sample("text", 1 << 20);
+	for (i = 0; i < s->len; i += n) {
+		const char *w = words[rand() % ARRAY_SIZE(words)];
+
+		n = strlen(w);
+		if (n > s->len - i - 1)
+			n = s->len - i - 1;
+		memcpy(s->data + i, w, n);
+		s->data[i + n++] = rand() % 8 ? ' ' : '.';
+	}
+
+	s = add_sample("records", 512 << 10);
+	for (i = 0; i + 16 <= s->len; i += 16) {
+		unsigned int rec[4] = { i / 16, rand() % 256, 0x43e00000 + i,
+					rand() % 3 ? 0 : rand() };
+
+		memcpy(s->data + i, rec, 16);
+	}
+
+	s = add_sample("random", 256 << 10);
+	for (i = 0; i < s->len; i++)
+		s->data[i] = rand();
+
+	s = add_sample("zeros", 256 << 10);
+	memset(s->data, 0, s->len);
+
+	for (k = 0; k < ARRAY_SIZE(periods); k++) {
+		sprintf(names[k], "period %u", periods[k]);
+		s = add_sample(names[k], 64 << 10);
+		for (i = 0; i < periods[k]; i++)
+			s->data[i] = rand();
+		for (; i < s->len; i++)
+			s->data[i] = rand() % 500 ? s->data[i - periods[k]] :
+				     rand();
+	}
+}
+
+static void read_file(const char *name)
+{
+	struct sample *s;
+	struct stat st;
+	FILE *f;
+
+	f = fopen(name, "rb");
+	if (!f || fstat(fileno(f), &st)) {
+		perror(name);
+		exit(1);
+	}
+	s = add_sample(name, st.st_size);
+	if (fread(s->data, 1, s->len, f) != s->len) {
+		perror(name);
+		exit(1);
+	}
+	fclose(f);
+}
+
+static unsigned long deflate_raw(const unsigned char *src, unsigned long len,
+				 unsigned char *dst, unsigned long size,
+				 int level, int strategy)
+{
+	z_stream s;
+	unsigned long n;
+
+	memset(&s, 0, sizeof(s));
+	if (deflateInit2(&s, level, Z_DEFLATED, -MAX_WBITS, 9,
+			 strategy) != Z_OK)
+		return 0;
+	s.next_in = (Bytef *)src;
+	s.avail_in = len;
+	s.next_out = dst;
+	s.avail_out = size;
+	n = deflate(&s, Z_FINISH) == Z_STREAM_END ? s.total_out : 0;
+	deflateEnd(&s);
+	return n;
+}
+
+static int inflate_ref(const unsigned char *src, unsigned long srclen,
+		       unsigned char *dst, unsigned long *dstlen)
+{
+	z_stream s;
+	int r;
+
+	memset(&s, 0, sizeof(s));
+	if (inflateInit2(&s, -MAX_WBITS) != Z_OK)
+		return -1;
+	s.next_in = (Bytef *)src;
+	s.avail_in = srclen;
+	s.next_out = dst;
+	s.avail_out = *dstlen;
+	r = inflate(&s, Z_FINISH);
+	*dstlen = s.total_out;
+	inflateEnd(&s);
+	return r == Z_STREAM_END ? 0 : -1;
+}
+
+static double now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+/*
+ * Inflate z with lib/zlib.c into out. Each piece of input is copied to
+ * the end of gin less ipad bytes before it is handed over, and each
+ * piece of output is written to the end of gout less opad bytes.
+ */
+static int inflate_fast(const unsigned char *z, unsigned long zlen,
+			unsigned char *out, unsigned long *outlen,
+			struct guarded *gin, unsigned ipad,
+			unsigned long ipiece, struct guarded *gout,
+			unsigned opad, unsigned long opiece)
+{
+	unsigned char *in = NULL, *dst;
+	unsigned long pos = 0, done = 0, left = 0, n, m, room;
+	void *strm;
+	int r;
+
+	strm = zlib_fast_init();
+	if (!strm)
+		return -1;
+	do {
+		if (!left) {
+			if (pos == zlen) {
+				r = -1;		/* truncated */
+				break;
+			}
+			n = zlen - pos < ipiece ? zlen - pos : ipiece;
+			in = guard_end(gin, n, ipad);
+			memcpy(in, z + pos, n);
+			pos += n;
+			left = n;
+		}
+		m = *outlen - done < opiece ? *outlen - done : opiece;
+		dst = guard_end(gout, m, opad);
+		room = m;
+		n = left;
+		r = zlib_fast_step(strm, in, &left, dst, &room);
+		in += n - left;
+		memcpy(out + done, dst, m - room);
+		done += m - room;
+	} while (!r);
+	zlib_fast_end(strm);
+	*outlen = done;
+
+	return r == 1 ? 0 : -1;
+}
+
+static const char *piece_name(unsigned long piece, char *buf)
+{
+	if (piece == ~0UL)
+		return "whole";
+	sprintf(buf, "%lu byte", piece);
+	return buf;
+}
+
+/* Inflate one stream in every alignment and piece size */
+static int check_stream(const struct sample *s, const unsigned char *z,
+			unsigned long zlen, unsigned char *out,
+			struct guarded *gin, struct guarded *gout)
+{
+	unsigned long outlen;
+	unsigned ipad, opad, ip, op;
+	char ibuf[32], obuf[32];
+
+	for (ipad = 0; ipad < 4; ipad++) {
+		for (opad = 0; opad < 4; opad++) {
+			for (ip = 0; ip < ARRAY_SIZE(ipieces); ip++) {
+				for (op = 0; op < ARRAY_SIZE(opieces); op++) {
+					/* pieces in one alignment only */
+					if ((ip || op) && (ipad || opad) &&
+					    s->len > 4096)
+						continue;
+					memset(out, 0x55, s->len);
+					outlen = s->len;
+					if (inflate_fast(z, zlen, out, &outlen,
+							 gin, ipad,
+							 ipieces[ip], gout,
+							 opad, opieces[op]) ||
+					    outlen != s->len ||
+					    memcmp(out, s->data, s->len)) {
+						fprintf(stderr, "%s: %s input "
+							"ending %u before the "
+							"guard, %s output "
+							"ending %u before it: "
+							"wrong result\n",
+							s->name,
+							piece_name(ipieces[ip],
+								   ibuf),
+							ipad,
+							piece_name(opieces[op],
+								   obuf),
+							opad);
+						return -1;
+					}
+				}
+			}
+		}
+	}
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	struct guarded gin, gout;
+	unsigned char *z, *ref;
+	unsigned long zmax = 0, zlen, outlen, bench_len = 0;
+	unsigned char *bench_z = NULL;
+	const struct sample *bench = NULL;
+	int i, l, st, streams = 0, loop;
+	double t_fast, t_ref;
+	unsigned k;
+
+	page_size = sysconf(_SC_PAGESIZE);
+
+	gen_corpus();
+	for (i = 1; i < argc; i++)
+		read_file(argv[i]);
+
+	for (i = 0; i < corpus_len; i++)
+		if (corpus[i].len > zmax)
+			zmax = corpus[i].len;
+	zmax = compressBound(zmax) + 64;
+	z = xmalloc(zmax);
+	bench_z = xmalloc(zmax);
+	ref = xmalloc(zmax);
+	guard_alloc(&gin, zmax + 4);
+	guard_alloc(&gout, zmax + 4);
+
+	/* every length up to 64 bytes, one alignment each way */
+	for (k = 0; k <= 64; k++) {
+		struct sample s = { "short", corpus[0].data, k };
+
+		zlen = deflate_raw(s.data, k, z, zmax, 6, Z_DEFAULT_STRATEGY);
+		if (!zlen || check_stream(&s, z, zlen, ref, &gin, &gout))
+			return 1;
+		streams++;
+	}
+
+	for (i = 0; i < corpus_len; i++) {
+		const struct sample *s = &corpus[i];
+
+		for (l = 0; l < ARRAY_SIZE(levels); l++) {
+			for (st = 0; st < ARRAY_SIZE(strategies); st++) {
+				zlen = deflate_raw(s->data, s->len, z, zmax,
+						   levels[l],
+						   strategies[st].strategy);
+				if (!zlen) {
+					fprintf(stderr, "%s: deflate failed\n",
+						s->name);
+					return 1;
+				}
+
+				outlen = s->len;
+				if (inflate_ref(z, zlen, ref, &outlen) ||
+				    outlen != s->len ||
+				    memcmp(ref, s->data, s->len)) {
+					fprintf(stderr, "%s: system zlib "
+						"disagrees\n", s->name);
+					return 1;
+				}
+
+				if (check_stream(s, z, zlen, ref, &gin, &gout)) {
+					fprintf(stderr, "  level %d, %s "
+						"strategy\n", levels[l],
+						strategies[st].name);
+					return 1;
+				}
+				streams++;
+
+				if (levels[l] == 6 && !st &&
+				    (!bench || s->len > bench->len)) {
+					bench = s;
+					memcpy(bench_z, z, zlen);
+					bench_len = zlen;
+				}
+			}
+		}
+		printf("%-24s %8lu bytes  ok\n", s->name, s->len);
+	}
+	printf("%d streams: ok\n", streams);
+
+	t_fast = now();
+	for (loop = 0; loop < BENCH_LOOPS; loop++) {
+		void *strm = zlib_fast_init();
+
+		zlen = bench_len;
+		outlen = bench->len;
+		zlib_fast_step(strm, bench_z, &zlen, ref, &outlen);
+		zlib_fast_end(strm);
+	}
+	t_fast = now() - t_fast;
+
+	t_ref = now();
+	for (loop = 0; loop < BENCH_LOOPS; loop++) {
+		outlen = bench->len;
+		inflate_ref(bench_z, bench_len, ref, &outlen);
+	}
+	t_ref = now() - t_ref;
+
+	printf("%s, level 6: U-Boot %.1f MB/s, system zlib %.1f MB/s\n",
+	       bench->name,
+	       (double)bench->len * BENCH_LOOPS / (1 << 20) / t_fast,
+	       (double)bench->len * BENCH_LOOPS / (1 << 20) / t_ref);
+
+	return 0;
+}
@@ -0,0 +1,48 @@
+/*
+ * Host definitions for building lib/zlib.c into zlib_test
+ *
+ * See file CREDITS for list of people who contributed to this
+ * project.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ */
+
+/*
+ * Host side of lib/zlib.c for zlib_test, see zlib_fast.c.
+ */
+#ifndef _ZLIB_TEST_H_
+#define _ZLIB_TEST_H_
+
+#include <compiler.h>
+#include <malloc.h>
+
+/* glibc defines both, lib/zlib.c expects only the one that applies */
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+#undef __BIG_ENDIAN
+#else
+#undef __LITTLE_ENDIAN
+#endif
+
+#define get_unaligned(p) ({			\
+	__typeof__(*(p)) __v;			\
+	memcpy(&__v, (p), sizeof(__v));		\
+	__v;					\
+})
+
+#define WATCHDOG_RESET()	do { } while (0)
+#define hang()			abort()
+
+#endif /* _ZLIB_TEST_H_ */